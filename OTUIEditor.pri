@@ -0,0 +1,111 @@
+# Sources of the editor without main(), for OTUIEditor.pro and bench/bench.pro.
+
+QT       += core gui widgets opengl openglwidgets concurrent
+
+CONFIG += c++17
+
+SOURCES += \
+        $$PWD/corewindow.cpp \
+        $$PWD/edithistory.cpp \
+        $$PWD/editjournal.cpp \
+        $$PWD/editordocument.cpp \
+        $$PWD/elidedlabel.cpp \
+        $$PWD/events/setidevent.cpp \
+        $$PWD/events/settingssavedevent.cpp \
+        $$PWD/fuzzyindex.cpp \
+        $$PWD/imagegridmodel.cpp \
+        $$PWD/imagesourcebrowser.cpp \
+        $$PWD/moduleindex.cpp \
+        $$PWD/modulescanner.cpp \
+        $$PWD/mipmapcache.cpp \
+        $$PWD/offscreenrenderer.cpp \
+        $$PWD/openglwidget.cpp \
+        $$PWD/renderstats.cpp \
+        $$PWD/scenerenderer.cpp \
+        $$PWD/spatialindex.cpp \
+        $$PWD/thirdparty/otui/otui_parser.c \
+        $$PWD/otui/bitmapfont.cpp \
+        $$PWD/otui/button.cpp \
+        $$PWD/otui/creature.cpp \
+        $$PWD/otui/image.cpp \
+        $$PWD/otui/imagecache.cpp \
+        $$PWD/otui/item.cpp \
+        $$PWD/otui/label.cpp \
+        $$PWD/otui/mainwindow.cpp \
+        $$PWD/otui/parser.cpp \
+        $$PWD/otui/project.cpp \
+        $$PWD/otui/sourcedocument.cpp \
+        $$PWD/otui/textlayoutcache.cpp \
+        $$PWD/otui/texturemanager.cpp \
+        $$PWD/otui/widget.cpp \
+        $$PWD/stylelistcache.cpp \
+        $$PWD/stylesourcebrowser.cpp \
+        $$PWD/thumbnailcache.cpp \
+        $$PWD/widgetcommands.cpp \
+        $$PWD/widgettreemodel.cpp \
+        $$PWD/xrefindex.cpp \
+        $$PWD/projectsettings.cpp \
+        $$PWD/recentproject.cpp \
+        $$PWD/startupwindow.cpp
+
+HEADERS += \
+        $$PWD/const.h \
+        $$PWD/corewindow.h \
+        $$PWD/edithistory.h \
+        $$PWD/editjournal.h \
+        $$PWD/editordocument.h \
+        $$PWD/elidedlabel.h \
+        $$PWD/events/setidevent.h \
+        $$PWD/events/settingssavedevent.h \
+        $$PWD/fuzzyindex.h \
+        $$PWD/imagegridmodel.h \
+        $$PWD/imagesourcebrowser.h \
+        $$PWD/mipmapcache.h \
+        $$PWD/moduleindex.h \
+        $$PWD/modulescanner.h \
+        $$PWD/offscreenrenderer.h \
+        $$PWD/openglwidget.h \
+        $$PWD/renderstats.h \
+        $$PWD/scenerenderer.h \
+        $$PWD/spatialindex.h \
+        $$PWD/thirdparty/otui/otui_parser.h \
+        $$PWD/otui/bitmapfont.h \
+        $$PWD/otui/button.h \
+        $$PWD/otui/creature.h \
+        $$PWD/otui/guithread.h \
+        $$PWD/otui/image.h \
+        $$PWD/otui/imagecache.h \
+        $$PWD/otui/item.h \
+        $$PWD/otui/label.h \
+        $$PWD/otui/mainwindow.h \
+        $$PWD/otui/parser.h \
+        $$PWD/otui/otui.h \
+        $$PWD/otui/project.h \
+        $$PWD/otui/sourcedocument.h \
+        $$PWD/otui/textlayoutcache.h \
+        $$PWD/otui/texturemanager.h \
+        $$PWD/otui/widget.h \
+        $$PWD/stylelistcache.h \
+        $$PWD/stylesourcebrowser.h \
+        $$PWD/thumbnailcache.h \
+        $$PWD/widgetcommands.h \
+        $$PWD/widgettreemodel.h \
+        $$PWD/xrefindex.h \
+        $$PWD/projectsettings.h \
+        $$PWD/recentproject.h \
+        $$PWD/startupwindow.h
+
+FORMS += \
+        $$PWD/mainwindow.ui \
+        $$PWD/startupwindow.ui
+
+RESOURCES += \
+    $$PWD/resources.qrc
+
+win32:CONFIG(release, debug|release): LIBS += -lOpengl32
+else:win32:CONFIG(debug, debug|release): LIBS += -lOpengl32
+else:unix: LIBS += -lOpengl32
+
+INCLUDEPATH += $$PWD/.
+INCLUDEPATH += $$PWD/thirdparty/otui
+DEPENDPATH += $$PWD/.
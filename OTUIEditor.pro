@@ -1,4 +1,4 @@
-QT       += core gui widgets opengl openglwidgets
+QT       += core gui widgets opengl openglwidgets concurrent
 
 TARGET = OTUIEditor
 TEMPLATE = app
@@ -17,73 +17,15 @@ DEFINES += QT_DEPRECATED_WARNINGS
 CONFIG += c++17
 
 SOURCES += \
-        corewindow.cpp \
-        elidedlabel.cpp \
-        events/setidevent.cpp \
-        events/settingssavedevent.cpp \
-        imagesourcebrowser.cpp \
-        modulescanner.cpp \
-        main.cpp \
-        openglwidget.cpp \
-        thirdparty/otui/otui_parser.c \
-        otui/button.cpp \
-        otui/creature.cpp \
-        otui/image.cpp \
-        otui/item.cpp \
-        otui/label.cpp \
-        otui/mainwindow.cpp \
-        otui/parser.cpp \
-        otui/project.cpp \
-        otui/widget.cpp \
-        stylesourcebrowser.cpp \
-        projectsettings.cpp \
-        recentproject.cpp \
-        startupwindow.cpp
+        main.cpp
 
-HEADERS += \
-        const.h \
-        corewindow.h \
-        elidedlabel.h \
-        events/setidevent.h \
-        events/settingssavedevent.h \
-        imagesourcebrowser.h \
-        modulescanner.h \
-        openglwidget.h \
-        thirdparty/otui/otui_parser.h \
-        otui/button.h \
-        otui/creature.h \
-        otui/image.h \
-        otui/item.h \
-        otui/label.h \
-        otui/mainwindow.h \
-        otui/parser.h \
-        otui/otui.h \
-        otui/project.h \
-        otui/widget.h \
-        stylesourcebrowser.h \
-        projectsettings.h \
-        recentproject.h \
-        startupwindow.h
-
-FORMS += \
-        mainwindow.ui \
-        startupwindow.ui
+# Everything but main(); shared with the benchmarks under bench/.
+include(OTUIEditor.pri)
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
-RESOURCES += \
-    resources.qrc
-
 DISTFILES += \
     stylesheet.css
-
-win32:CONFIG(release, debug|release): LIBS += -lOpengl32
-else:win32:CONFIG(debug, debug|release): LIBS += -lOpengl32
-else:unix: LIBS += -lOpengl32
-
-INCLUDEPATH += $$PWD/.
-INCLUDEPATH += $$PWD/thirdparty/otui
-DEPENDPATH += $$PWD/.
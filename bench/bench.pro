@@ -0,0 +1,14 @@
+# Command line timings for the editor: ./OTUIEditorBench --save 50000 --search 100000
+
+TARGET = OTUIEditorBench
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp
+
+include(../OTUIEditor.pri)
@@ -0,0 +1,126 @@
+#include "fuzzyindex.h"
+#include "otui/otui.h"
+#include "otui/parser.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Saves a generated document of widgetCount widgets and reports the writer's throughput.
+int runSaveBenchmark(int widgetCount)
+{
+    OTUI::Parser::WidgetList widgets;
+    widgets.reserve(static_cast<std::size_t>(widgetCount));
+    OTUI::Widget *window = nullptr;
+    for(int i = 0; i < widgetCount; ++i)
+    {
+        // One window per 100 widgets, the rest are labels inside it.
+        std::unique_ptr<OTUI::Widget> widget;
+        if(i % 100 == 0)
+            widget = std::make_unique<OTUI::MainWindow>(QStringLiteral("window%1").arg(i), QString(), QString());
+        else
+            widget = std::make_unique<OTUI::Label>(QStringLiteral("label%1").arg(i), QString(), QString());
+        widget->setRect(QRect((i % 10) * 20, (i % 7) * 16, 120, 16));
+        widget->setOpacity(0.5f);
+        if(widget->supportsTextProperty())
+            widget->setTextProperty(QStringLiteral("Label number %1").arg(i));
+        if(i % 100 == 0)
+            window = widget.get();
+        else
+            widget->setParent(window);
+        widgets.emplace_back(std::move(widget));
+    }
+
+    QTemporaryDir dir;
+    if(!dir.isValid())
+    {
+        qWarning() << "Save benchmark: no temporary directory:" << dir.errorString();
+        return 1;
+    }
+
+    QString error;
+    OTUI::Parser::SaveStats stats;
+    if(!OTUI::Parser().saveToFile(dir.filePath(QStringLiteral("benchmark.otui")), widgets, &error, &stats))
+    {
+        qWarning() << "Save benchmark:" << error;
+        return 1;
+    }
+
+    const double seconds = std::max<qint64>(1, stats.elapsedMs) / 1000.0;
+    qInfo().noquote() << QStringLiteral("Saved %1 widgets, %2 bytes in %3 ms (%4 MiB/s, %5 widgets/s)")
+                             .arg(stats.widgets)
+                             .arg(stats.bytes)
+                             .arg(stats.elapsedMs)
+                             .arg(stats.bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1)
+                             .arg(stats.widgets / seconds, 0, 'f', 0);
+    return 0;
+}
+
+// Times image search queries over entryCount generated paths; the browser aims for 10 ms.
+int runSearchBenchmark(int entryCount)
+{
+    const QStringList folders = {"ui", "game_battle", "icons", "inventory", "skills", "topmenu", "options"};
+    const QStringList names = {"button", "button_hover", "button_down", "checkbox", "window", "scrollbar", "tab_rounded"};
+    FuzzyIndex index;
+    index.reserve(entryCount);
+    for(int i = 0; i < entryCount; ++i)
+        index.add(QStringLiteral("images/%1/set%2/%3_%4.png").arg(folders.at(i % folders.size())).arg(i / 1000)
+                      .arg(names.at((i / folders.size()) % names.size())).arg(i));
+
+    const QStringList queries = {"btn hov", "buttonhover", "ui check", "set42 window", "tabrnd", "zzzz"};
+    int slow = 0;
+    for(const QString &query : queries)
+    {
+        // Best of a few runs, so a cold cache does not count.
+        qint64 best = std::numeric_limits<qint64>::max();
+        int matches = 0;
+        for(int run = 0; run < 5; ++run)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            matches = index.search(query, 1000).size();
+            best = std::min(best, timer.nsecsElapsed());
+        }
+        if(best > 10 * 1000000)
+            ++slow;
+        qInfo().noquote() << QStringLiteral("\"%1\": %2 matches of %3 in %4 ms")
+                                 .arg(query).arg(matches).arg(index.size()).arg(best / 1000000.0, 0, 'f', 2);
+    }
+    return slow == 0 ? 0 : 1;
+}
+
+}
+
+// Headless timings of the document writer and the image search, kept out of the editor binary.
+int main(int argc, char *argv[])
+{
+    // Widgets and pixmaps need a GUI application even when nothing is shown.
+    QApplication a(argc, argv);
+
+    QCommandLineParser options;
+    options.addHelpOption();
+    const QCommandLineOption saveBenchmark(QStringLiteral("save"),
+                                           QStringLiteral("Time saving a generated document of <widgets> widgets."),
+                                           QStringLiteral("widgets"));
+    options.addOption(saveBenchmark);
+    const QCommandLineOption searchBenchmark(QStringLiteral("search"),
+                                             QStringLiteral("Time image search over <entries> generated paths."),
+                                             QStringLiteral("entries"));
+    options.addOption(searchBenchmark);
+    options.process(a);
+
+    if(!options.isSet(saveBenchmark) && !options.isSet(searchBenchmark))
+        options.showHelp(1);
+
+    int result = 0;
+    if(options.isSet(saveBenchmark))
+        result |= runSaveBenchmark(std::max(1, options.value(saveBenchmark).toInt()));
+    if(options.isSet(searchBenchmark))
+        result |= runSearchBenchmark(std::max(1, options.value(searchBenchmark).toInt()));
+    return result;
+}
@@ -2,6 +2,16 @@
 #include "ui_mainwindow.h"
 #include "startupwindow.h"
 #include "modulescanner.h"
+#include "moduleindex.h"
+#include "xrefindex.h"
+#include "edithistory.h"
+#include "editjournal.h"
+#include "editordocument.h"
+#include "widgetcommands.h"
+#include "offscreenrenderer.h"
+#include "otui/sourcedocument.h"
+#include "otui/imagecache.h"
+#include "otui/texturemanager.h"
 
 #include <QSettings>
 #include <QDebug>
@@ -24,6 +34,16 @@
 #include <QSignalBlocker>
 #include <QInputDialog>
 #include <QDir>
+#include <QProgressDialog>
+#include <QElapsedTimer>
+#include <QStatusBar>
+#include <QTabBar>
+#include <QDesktopServices>
+#include <QUrl>
+#include <QCryptographicHash>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
 #include <utility>
 
 namespace {
@@ -79,6 +99,35 @@ QString anchorEdgeToken(OTUI::AnchorEdge edge)
     }
 }
 
+WidgetProperty anchorProperty(OTUI::AnchorEdge edge)
+{
+    switch(edge)
+    {
+    case OTUI::AnchorEdge::Left:
+        return WidgetProperty::AnchorLeft;
+    case OTUI::AnchorEdge::Right:
+        return WidgetProperty::AnchorRight;
+    case OTUI::AnchorEdge::Top:
+        return WidgetProperty::AnchorTop;
+    case OTUI::AnchorEdge::Bottom:
+        return WidgetProperty::AnchorBottom;
+    case OTUI::AnchorEdge::HorizontalCenter:
+        return WidgetProperty::AnchorHorizontalCenter;
+    case OTUI::AnchorEdge::VerticalCenter:
+    default:
+        return WidgetProperty::AnchorVerticalCenter;
+    }
+}
+
+QString formatBytes(qsizetype bytes)
+{
+    if(bytes < 1024)
+        return QStringLiteral("%1 B").arg(bytes);
+    if(bytes < 1024 * 1024)
+        return QStringLiteral("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    return QStringLiteral("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
 class ModuleResourceScope
 {
 public:
@@ -156,18 +205,46 @@ void CoreWindow::initializeWindow()
     initAnchorCombo(ui->anchorHCenterTargetCombo);
     initAnchorCombo(ui->anchorVCenterTargetCombo);
 
-    model = new QStandardItemModel;
-    model->setHeaderData(0, Qt::Horizontal, "Widgets List");
+    model = new WidgetTreeModel(this);
     ui->treeView->setModel(model);
+    m_xrefIndex = new XRefIndex(this);
+    connect(ui->openGLWidget, &OpenGLWidget::widgetsAboutToBeReset, model, &WidgetTreeModel::beginReset);
+    connect(ui->openGLWidget, &OpenGLWidget::widgetsReset, this, [this]() {
+        model->endReset(ui->openGLWidget->getOTUIWidgets());
+    });
+    connect(ui->openGLWidget, &OpenGLWidget::widgetsInserted, model, [this](const QVector<OTUI::Widget*> &widgets) {
+        model->insertWidgets(widgets, ui->openGLWidget->getOTUIWidgets());
+    });
+    connect(ui->openGLWidget, &OpenGLWidget::widgetAboutToBeRemoved, model, &WidgetTreeModel::removeWidget);
+
+    m_documentTabs = new QTabBar(ui->middle);
+    m_documentTabs->setDocumentMode(true);
+    m_documentTabs->setTabsClosable(true);
+    m_documentTabs->setMovable(false);
+    m_documentTabs->setExpanding(false);
+    ui->verticalLayout_2->insertWidget(0, m_documentTabs);
+    connect(m_documentTabs, &QTabBar::currentChanged, this, [this](int index) {
+        activateDocument(index);
+    });
+    connect(m_documentTabs, &QTabBar::tabCloseRequested, this, [this](int index) {
+        closeDocument(index);
+    });
+    resetDocuments();
+    connect(ui->openGLWidget, &OpenGLWidget::geometryEdited, this, [this](OTUI::Widget *widget, const QRect &before, const QRect &after) {
+        QVector<PropertyEditCommand::Change> changes = {{WidgetProperty::Geometry, before, after}};
+        m_history->push(std::make_unique<PropertyEditCommand>(ui->openGLWidget, widget, std::move(changes)));
+        m_journal->recordChanged(widget);
+    });
+    updateHistoryActions();
+
+    m_journal = new EditJournal(ui->openGLWidget, this);
     connect(ui->treeView->selectionModel(), &QItemSelectionModel::selectionChanged, this, [=](const QItemSelection &selected, const QItemSelection&) {
         if(selected.indexes().isEmpty()) {
             m_selected = nullptr;
             updatePropertyPanel(nullptr);
             return;
         }
-        QStandardItem *newitem = model->itemFromIndex(selected.indexes().first());
-        m_selected = nullptr;
-        selectWidgetById(newitem->text());
+        m_selected = WidgetTreeModel::widgetAt(selected.indexes().first());
 
         if(m_selected != nullptr) {
             ui->openGLWidget->m_selected = m_selected;
@@ -178,6 +255,7 @@ void CoreWindow::initializeWindow()
     connect(ui->openGLWidget, &OpenGLWidget::selectionChanged, this, [this](OTUI::Widget *widget) {
         if(m_selected == widget)
             return;
+        m_history->breakMerge();
         m_selected = widget;
         if(widget)
             syncTreeSelection(widget);
@@ -226,13 +304,21 @@ void CoreWindow::startNewProject(QString fileName, QString name, QString path, Q
         return;
 
     initializeWindow();
+    startJournal(false);
+    refreshProjectIndexes();
     setWindowTitle(name + " - OTUI Editor");
     m_projectSettings->setProjectName(name);
     m_projectSettings->setDataPath(dataPath);
+    m_projectSettings->setTextureBudget(m_Project->getTextureBudget());
+    m_projectSettings->setHistoryLimit(m_Project->getHistoryLimit());
+    m_projectSettings->setMergeInterval(m_Project->getMergeInterval());
+    applyTextureBudget();
+    applyHistorySettings();
     imagesBrowser->m_DataPath = m_Project->getDataPath();
     imagesBrowser->initialize();
     if(stylesBrowser)
     {
+        stylesBrowser->setCachePath(m_Project->getProjectFile()->fileName() + ".styles");
         stylesBrowser->setDataPath(m_Project->getDataPath());
         stylesBrowser->initialize();
     }
@@ -246,18 +332,62 @@ void CoreWindow::loadProjectData(QDataStream &data, QString fileName, QString pa
         return;
 
     initializeWindow();
+    refreshProjectIndexes();
     // TODO: Initialize widgets
 
     setWindowTitle(m_Project->getProjectName() + " - OTUI Editor");
     m_projectSettings->setProjectName(m_Project->getProjectName());
     m_projectSettings->setDataPath(m_Project->getDataPath());
+    m_projectSettings->setTextureBudget(m_Project->getTextureBudget());
+    m_projectSettings->setHistoryLimit(m_Project->getHistoryLimit());
+    m_projectSettings->setMergeInterval(m_Project->getMergeInterval());
+    applyTextureBudget();
+    applyHistorySettings();
     imagesBrowser->m_DataPath = m_Project->getDataPath();
     imagesBrowser->initialize();
     if(stylesBrowser)
     {
+        stylesBrowser->setCachePath(m_Project->getProjectFile()->fileName() + ".styles");
         stylesBrowser->setDataPath(m_Project->getDataPath());
         stylesBrowser->initialize();
     }
+
+    // Journals that are still around mean the last session did not close cleanly.
+    const QFileInfo projectFile(m_Project->getProjectFile()->fileName());
+    const QFileInfoList journals = projectFile.dir().entryInfoList({projectFile.fileName() + ".*.journal"}, QDir::Files);
+    bool recoverBlank = false;
+    QStringList recoverDocuments;
+    QStringList stale;
+    for(const QFileInfo &file : journals)
+    {
+        const EditJournal::Info journal = EditJournal::inspect(file.filePath());
+        if(!journal.valid)
+            stale << file.filePath();
+        else if(journal.documentPath.isEmpty())
+            recoverBlank = true;
+        else
+            recoverDocuments << journal.documentPath;
+    }
+    if((recoverBlank || !recoverDocuments.isEmpty()) &&
+       QMessageBox::question(this, "Recover Edits",
+                             "OTUI Editor did not close cleanly last time.\nRecover the unsaved canvas edits?",
+                             QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) != QMessageBox::Yes)
+    {
+        for(const QFileInfo &file : journals)
+            stale << file.filePath();
+        recoverBlank = false;
+        recoverDocuments.clear();
+    }
+    for(const QString &path : std::as_const(stale))
+        QFile::remove(path);
+
+    startJournal(recoverBlank);
+    if(!recoverDocuments.isEmpty())
+    {
+        m_recoverJournal = true;
+        if(!importOtuiFiles(recoverDocuments, {}))
+            m_recoverJournal = false;
+    }
 }
 
 bool CoreWindow::event(QEvent *event)
@@ -265,10 +395,10 @@ bool CoreWindow::event(QEvent *event)
     if(event->type() == SetIdEvent::eventType)
     {
         SetIdEvent *setIdEvent = reinterpret_cast<SetIdEvent*>(event);
-        QModelIndexList items = model->match(model->index(0, 0), Qt::DisplayRole, QVariant::fromValue(setIdEvent->oldId), 1, Qt::MatchRecursive);
-        if(!items.isEmpty())
+        // The widget may have been deleted while the event was queued; the model only knows live ones.
+        if(model->indexOf(setIdEvent->widget).isValid())
         {
-            model->itemFromIndex(items.at(0))->setText(setIdEvent->newId);
+            model->widgetChanged(setIdEvent->widget);
             setProjectChanged(true);
         }
     }
@@ -276,6 +406,11 @@ bool CoreWindow::event(QEvent *event)
     {
         m_Project->setProjectName(m_projectSettings->getProjectName());
         m_Project->setDataPath(m_projectSettings->getDataPath());
+        m_Project->setTextureBudget(m_projectSettings->getTextureBudget());
+        m_Project->setHistoryLimit(m_projectSettings->getHistoryLimit());
+        m_Project->setMergeInterval(m_projectSettings->getMergeInterval());
+        applyTextureBudget();
+        applyHistorySettings();
         imagesBrowser->m_DataPath = m_Project->getDataPath();
         imagesBrowser->refresh();
         if(stylesBrowser)
@@ -314,25 +449,7 @@ void CoreWindow::keyReleaseEvent(QKeyEvent *event)
 
     case Qt::Key_Delete:
     {
-        auto idx = ui->treeView->currentIndex();
-        if(idx.parent().isValid())
-        {
-            QStandardItem *item = model->itemFromIndex(idx);
-            ui->openGLWidget->deleteWidget(item->text());
-            model->removeRow(idx.row(), idx.parent());
-            QStandardItem *root = model->invisibleRootItem();
-            QModelIndex index = root->child(0)->index();
-            ui->treeView->selectionModel()->select(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-            ui->treeView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-            selectWidgetById(root->child(0)->text());
-        }
-        else
-        {
-            model->clear();
-            ui->openGLWidget->clearWidgets();
-            m_selected = nullptr;
-        }
-        setProjectChanged(true);
+        on_actionDeleteWidget_triggered();
         break;
     }
 
@@ -343,6 +460,7 @@ void CoreWindow::closeEvent(QCloseEvent *event)
 {
     if(!m_Project->isChanged())
     {
+        m_journal->stop(true);
         event->accept();
         return;
     }
@@ -353,36 +471,16 @@ void CoreWindow::closeEvent(QCloseEvent *event)
                  QMessageBox::Cancel | QMessageBox::No | QMessageBox::Yes,
                  QMessageBox::Yes);
 
-    if(response == QMessageBox::Yes)
+    if(response == QMessageBox::Yes && !saveProject())
+        response = QMessageBox::Cancel;
+
+    if(response == QMessageBox::Cancel)
     {
-        if(m_Project->save())
-            event->accept();
-        else
-            event->ignore();
-    }
-    else if(response == QMessageBox::No)
-        event->accept();
-    else
         event->ignore();
-}
-
-void CoreWindow::addChildToTree(QString label)
-{
-    QModelIndex index = ui->treeView->currentIndex();
-    QStandardItem *item = model->itemFromIndex(index);
-    QStandardItem *newItem = new QStandardItem(label);
-    newItem->setEditable(false);
-    item->appendRow(newItem);
-    ui->treeView->expand(index);
-    ui->treeView->selectionModel()->select(newItem->index(), QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-    ui->treeView->selectionModel()->setCurrentIndex(newItem->index(), QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-    selectWidgetById(newItem->text());
-    setProjectChanged(true);
-}
-
-void CoreWindow::selectWidgetById(QString widgetId)
-{
-    m_selected = findWidgetById(widgetId);
+        return;
+    }
+    m_journal->stop(true);
+    event->accept();
 }
 
 void CoreWindow::on_treeView_customContextMenuRequested(const QPoint &pos)
@@ -392,6 +490,33 @@ void CoreWindow::on_treeView_customContextMenuRequested(const QPoint &pos)
 
     menu.addAction(ui->actionDeleteWidget);
 
+    OTUI::Widget *clicked = WidgetTreeModel::widgetAt(ui->treeView->indexAt(pos));
+    if(clicked && m_xrefIndex)
+    {
+        const QString styleName = clicked->styleName().isEmpty() ? OTUI::widgetClassName(clicked) : clicked->styleName();
+        menu.addSeparator();
+        QAction *definition = menu.addAction(QStringLiteral("Go to Definition of %1").arg(styleName));
+        connect(definition, &QAction::triggered, this, [this, styleName]() {
+            const QVector<XRefIndex::Location> locations = m_xrefIndex->definitions(styleName);
+            if(locations.size() == 1)
+                importOtuiFile(locations.first().filePath);
+            else
+                showXRefLocations(QStringLiteral("Definitions of %1").arg(styleName), locations);
+        });
+        QAction *usages = menu.addAction(QStringLiteral("Find Usages of %1").arg(styleName));
+        connect(usages, &QAction::triggered, this, [this, styleName]() {
+            showXRefLocations(QStringLiteral("Usages of %1").arg(styleName), m_xrefIndex->styleUsages(styleName));
+        });
+        const QString imageSource = clicked->imageSource();
+        if(!imageSource.isEmpty())
+        {
+            QAction *imageUsages = menu.addAction(QStringLiteral("Find Usages of %1").arg(imageSource));
+            connect(imageUsages, &QAction::triggered, this, [this, imageSource]() {
+                showXRefLocations(QStringLiteral("Usages of %1").arg(imageSource), m_xrefIndex->imageUsages(imageSource));
+            });
+        }
+    }
+
     menu.addSeparator();
 
     QMenu *newMenu = menu.addMenu("New...");
@@ -436,6 +561,8 @@ void CoreWindow::on_treeView_customContextMenuRequested(const QPoint &pos)
         }
     }
 
+    if(stylesBrowser && stylesBrowser->isIndexing())
+        customMenu->addAction("Indexing styles...")->setEnabled(false);
     QAction *browseStyles = customMenu->addAction("Browse Styles...");
     connect(browseStyles, &QAction::triggered, this, &CoreWindow::showStylesBrowser);
 
@@ -446,24 +573,18 @@ void CoreWindow::on_treeView_customContextMenuRequested(const QPoint &pos)
 
 void CoreWindow::on_actionDeleteWidget_triggered()
 {
-    auto idx = ui->treeView->currentIndex();
-    if(idx.parent().isValid())
-    {
-        QStandardItem *item = model->itemFromIndex(idx);
-        ui->openGLWidget->deleteWidget(item->text());
-        model->removeRow(idx.row(), idx.parent());
-        QStandardItem *root = model->invisibleRootItem();
-        QModelIndex index = root->child(0)->index();
-        ui->treeView->selectionModel()->select(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-        ui->treeView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-        selectWidgetById(root->child(0)->text());
-    }
-    else
-    {
-        model->clear();
-        ui->openGLWidget->clearWidgets();
-        m_selected = nullptr;
-    }
+    OTUI::Widget *widget = WidgetTreeModel::widgetAt(ui->treeView->currentIndex());
+    if(!widget)
+        return;
+
+    // Detached widgets move into the history so the deletion can be undone;
+    // their nodes stay bound so an undo brings back the original source.
+    OpenGLWidget::DetachedWidgets detached = ui->openGLWidget->detachWidget(widget);
+    m_selected = nullptr;
+    EditorDocument *document = activeDocument();
+    m_history->push(std::make_unique<StructureEditCommand>(ui->openGLWidget, StructureEditCommand::Kind::Remove, widget, std::move(detached),
+                                                           document ? document->source : nullptr));
+    syncTreeSelection(WidgetTreeModel::widgetAt(model->index(0, 0)));
     setProjectChanged(true);
 }
 
@@ -479,7 +600,7 @@ void CoreWindow::on_actionNewProject_triggered()
 
         if(response == QMessageBox::Yes)
         {
-            if(!m_Project->save())
+            if(!saveProject())
                 return;
         }
         else if(response == QMessageBox::Cancel)
@@ -491,14 +612,11 @@ void CoreWindow::on_actionNewProject_triggered()
         m_Project->getProjectFile()->close();
     }
 
-    // Clear tree
-    model->clear();
-
     // Clear selected
     m_selected = nullptr;
 
     // Clear widgets
-    ui->openGLWidget->clearWidgets();
+    resetDocuments();
 }
 
 void CoreWindow::on_actionOpenProject_triggered()
@@ -545,11 +663,14 @@ void CoreWindow::on_actionOpenModule_triggered()
     if(otmodPath.isEmpty())
         return;
 
-    ModuleScanner scanner;
+    // The project index already holds the module unless one of its files changed.
     ModuleScanner::Result result;
     QString error;
     const QString dataPathHint = m_Project ? m_Project->getDataPath() : QString();
-    if(!scanner.scan(otmodPath, dataPathHint, result, &error))
+    const ModuleIndex::Module *indexed = m_moduleIndex ? m_moduleIndex->find(otmodPath) : nullptr;
+    if(indexed && indexed->found && ModuleIndex::isCurrent(*indexed))
+        result = indexed->result;
+    else if(!ModuleScanner().scan(otmodPath, dataPathHint, result, &error))
     {
         ShowError("Module Import", error.isEmpty() ? QStringLiteral("Failed to scan the selected module.") : error);
         return;
@@ -569,13 +690,26 @@ void CoreWindow::on_actionOpenModule_triggered()
                                      .arg(result.missingUiFiles.join(QLatin1Char('\n'))));
     }
 
+    QStringList interfacePaths;
+    QStringList stylePaths;
+    for(const auto &entry : std::as_const(result.entries))
+    {
+        if(entry.kind == ModuleScanner::Entry::Kind::Style)
+            stylePaths << entry.absolutePath;
+        else
+            interfacePaths << entry.absolutePath;
+    }
+
     int selectedIndex = 0;
     if(result.entries.size() > 1)
     {
         QStringList labels;
-        labels.reserve(result.entries.size());
+        labels.reserve(result.entries.size() + 1);
         for(const auto &entry : result.entries)
             labels << entry.label;
+        const QString wholeModule = QStringLiteral("All interfaces (%1 files)").arg(interfacePaths.size());
+        if(interfacePaths.size() > 1)
+            labels << wholeModule;
 
         const int defaultIndex = qBound(0, result.primaryIndex, labels.size() - 1);
         bool ok = false;
@@ -589,6 +723,12 @@ void CoreWindow::on_actionOpenModule_triggered()
         if(!ok)
             return;
 
+        if(interfacePaths.size() > 1 && choice == wholeModule)
+        {
+            importOtuiFiles(interfacePaths, stylePaths);
+            return;
+        }
+
         selectedIndex = labels.indexOf(choice);
         if(selectedIndex < 0)
             selectedIndex = defaultIndex;
@@ -600,7 +740,7 @@ void CoreWindow::on_actionOpenModule_triggered()
 
 void CoreWindow::on_actionSaveProject_triggered()
 {
-    if(m_Project->save())
+    if(saveProject())
         setWindowTitle(m_Project->getProjectName() + " - OTUI Editor");
 }
 
@@ -616,13 +756,14 @@ void CoreWindow::on_actionCloseProject_triggered()
 
         if(response == QMessageBox::Yes)
         {
-            if(!m_Project->save())
+            if(!saveProject())
                 return;
         }
         else if(response == QMessageBox::Cancel)
             return;
     }
 
+    m_journal->stop(true);
     if(m_Project)
     {
         m_Project->getProjectFile()->close();
@@ -631,7 +772,10 @@ void CoreWindow::on_actionCloseProject_triggered()
     StartupWindow *w = new StartupWindow();
     w->show();
     hide();
-
+    // The new startup window opens the next project in a CoreWindow of its own; this
+    // one would otherwise stay alive hidden, with the cross reference index and the
+    // image browser still watching the closed project's folders.
+    deleteLater();
 }
 
 void CoreWindow::on_horizontalSlider_valueChanged(int value)
@@ -642,28 +786,12 @@ void CoreWindow::on_horizontalSlider_valueChanged(int value)
 
 void CoreWindow::on_newMainWindow_triggered()
 {
-    QModelIndex index = ui->treeView->currentIndex();
     QString widgetId("mainWindow");
-    if(index.isValid())
-    {
-        addChildToTree(widgetId);
-    }
-    else
-    {
-        QStandardItem *root = model->invisibleRootItem();
-        QStandardItem *item = new QStandardItem(widgetId);
-        item->setEditable(false);
-        root->appendRow(item);
-        model->setHeaderData(0, Qt::Horizontal, "Widgets List");
-        ui->treeView->selectionModel()->select(item->index(), QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-        ui->treeView->selectionModel()->setCurrentIndex(item->index(), QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-        selectWidgetById(item->text());
-    }
-
     m_selected = ui->openGLWidget->addWidget<OTUI::MainWindow>(widgetId,
                                                                m_Project->getDataPath(),
                                                                "/images/ui/window.png",
                                                                QRect(6, 27, 6, 6));
+    recordInsertion(m_selected);
     setProjectChanged(true);
 }
 
@@ -679,7 +807,7 @@ void CoreWindow::on_newButton_triggered()
                                          "/images/ui/button_rounded.png",
                                          QRect(0, 0, 22, 23),
                                          QRect(5, 5, 5, 5));
-        addChildToTree(m_selected->getId());
+        recordInsertion(m_selected);
         setProjectChanged(true);
     }
 }
@@ -696,7 +824,7 @@ void CoreWindow::on_newLabel_triggered()
                                         "",
                                         QRect(0, 0, 0, 0),
                                         QRect(0, 0, 0, 0));
-        addChildToTree(m_selected->getId());
+        recordInsertion(m_selected);
         setProjectChanged(true);
     }
 }
@@ -713,7 +841,7 @@ void CoreWindow::on_newUIItem_triggered()
                                        "",
                                        QRect(0, 0, 0, 0),
                                        QRect(0, 0, 0, 0));
-        addChildToTree(m_selected->getId());
+        recordInsertion(m_selected);
         setProjectChanged(true);
     }
 }
@@ -730,7 +858,7 @@ void CoreWindow::on_newUICreature_triggered()
                                            "",
                                            QRect(0, 0, 0, 0),
                                            QRect(0, 0, 0, 0));
-        addChildToTree(m_selected->getId());
+        recordInsertion(m_selected);
         setProjectChanged(true);
     }
 }
@@ -748,16 +876,93 @@ void CoreWindow::on_newImage_triggered()
                                        "",
                                        QRect(0, 0, 0, 0),
                                        QRect(0, 0, 0, 0));
-    addChildToTree(m_selected->getId());
+    recordInsertion(m_selected);
     setProjectChanged(true);
 }
 
+void CoreWindow::on_actionUndo_triggered()
+{
+    m_history->undo();
+}
+
+void CoreWindow::on_actionRedo_triggered()
+{
+    m_history->redo();
+}
+
 void CoreWindow::on_actionProject_Settings_triggered()
 {
     m_projectSettings->move(this->rect().center() - m_projectSettings->rect().center());
     m_projectSettings->show();
 }
 
+void CoreWindow::on_actionRenderStats_toggled(bool checked)
+{
+    ui->openGLWidget->setStatsOverlayVisible(checked);
+}
+
+void CoreWindow::on_actionExportRenderStats_triggered()
+{
+    if(ui->openGLWidget->renderStats().sessionFrames() == 0)
+    {
+        ShowError("Render Stats", "No frames recorded yet. Enable View > Render Stats (F3) while editing first.");
+        return;
+    }
+
+    QString selectedFilter;
+    const QString filePath = QFileDialog::getSaveFileName(this,
+                                                          "Export Render Stats",
+                                                          m_Project ? m_Project->getProjectPath() : QDir::homePath(),
+                                                          "CSV Files (*.csv);;JSON Files (*.json)",
+                                                          &selectedFilter);
+    if(filePath.isEmpty())
+        return;
+
+    QString error;
+    const bool json = filePath.endsWith(".json", Qt::CaseInsensitive) ||
+                      (!filePath.endsWith(".csv", Qt::CaseInsensitive) && selectedFilter.contains("json", Qt::CaseInsensitive));
+    const bool saved = json ? ui->openGLWidget->renderStats().exportJson(filePath, &error)
+                            : ui->openGLWidget->renderStats().exportCsv(filePath, &error);
+    if(!saved)
+        ShowError("Render Stats", error.isEmpty() ? QStringLiteral("Failed to write the stats file.") : error);
+}
+
+void CoreWindow::on_actionExportImage_triggered()
+{
+    const std::vector<std::unique_ptr<OTUI::Widget>> &widgets = ui->openGLWidget->getOTUIWidgets();
+    QRect bounds;
+    for(auto const &widget : widgets)
+        bounds |= SceneRenderer::canvasRect(*widget);
+    if(bounds.isEmpty())
+    {
+        ShowError("Export Image", "The current document has no widgets to export.");
+        return;
+    }
+
+    const QString filePath = QFileDialog::getSaveFileName(this,
+                                                          "Export Image",
+                                                          m_Project ? m_Project->getProjectPath() : QDir::homePath(),
+                                                          "PNG Images (*.png)");
+    if(filePath.isEmpty())
+        return;
+
+    OffscreenRenderer renderer;
+    OffscreenRenderer::Options options;
+    options.size = bounds.size();
+    options.origin = bounds.topLeft();
+    const QImage image = renderer.render(widgets, options);
+#ifdef QT_DEBUG
+    // Golden check: a deterministic render must match the canvas renderer pixel for pixel.
+    options.deterministic = true;
+    const int different = OffscreenRenderer::countDifferentPixels(renderer.render(widgets, options), ui->openGLWidget->renderScene(bounds));
+    if(different != 0)
+        qWarning() << "Offscreen render differs from the canvas in" << different << "pixels";
+#endif
+
+    if(!image.save(filePath, "PNG"))
+        ShowError("Export Image", QString("Couldn't write %1.").arg(filePath));
+}
+
 void CoreWindow::setProjectChanged(bool v) {
     if(!m_Project)
         return;
@@ -769,105 +974,152 @@ void CoreWindow::setProjectChanged(bool v) {
     m_Project->setChanged(v);
 }
 
-bool CoreWindow::importOtuiFile(const QString &filePath, const QString &dataPathOverride)
+struct CoreWindow::ImportResult
 {
-    ModuleResourceScope moduleScope(filePath);
-    OTUI::Parser::WidgetList widgets;
+    QString filePath;
+    bool loaded = false;
     QString error;
-    QString dataPath = dataPathOverride;
-    if(dataPath.isEmpty() && m_Project)
-        dataPath = m_Project->getDataPath();
-    if(!m_parser.loadFromFile(filePath, widgets, &error, dataPath))
+    OTUI::Parser::WidgetList widgets;
+    std::shared_ptr<OTUI::SourceDocument> source;
+};
+
+bool CoreWindow::importOtuiFile(const QString &filePath, const QString &dataPathOverride)
+{
+    // An open document is shown again as it is instead of being parsed anew.
+    const int openIndex = documentIndex(filePath);
+    if(openIndex >= 0 && !m_recoverJournal && !m_importWatcher)
     {
-        ShowError("Parser Error", error.isEmpty() ? QStringLiteral("Unknown parser error.") : error);
-        return false;
+        m_documentTabs->setCurrentIndex(openIndex);
+        return true;
     }
-
-    ui->openGLWidget->setWidgets(std::move(widgets));
-    rebuildWidgetTree();
-    if(m_Project)
-        setProjectChanged(true);
-    m_currentOtuiPath = filePath;
-    return true;
+    return importOtuiFiles({filePath}, {}, dataPathOverride);
 }
 
-void CoreWindow::rebuildWidgetTree()
+bool CoreWindow::importOtuiFiles(const QStringList &filePaths, const QStringList &stylePaths, const QString &dataPathOverride)
 {
-    if(!model)
-        return;
-
-    model->clear();
-    model->setHeaderData(0, Qt::Horizontal, "Widgets List");
-
-    const auto &widgets = ui->openGLWidget->getOTUIWidgets();
-
-    if(widgets.empty())
-        return;
-
-    QHash<QString, QStandardItem*> itemsById;
-    itemsById.reserve(static_cast<int>(widgets.size()));
+    if(m_importWatcher || filePaths.isEmpty())
+        return false;
 
-    for(const auto &widget : widgets)
-    {
-        if(!widget)
-            continue;
-        auto *item = new QStandardItem(widget->getId());
-        item->setEditable(false);
-        itemsById.insert(widget->getId(), item);
-    }
+    QString dataPath = dataPathOverride;
+    if(dataPath.isEmpty() && m_Project)
+        dataPath = m_Project->getDataPath();
 
-    QStandardItem *root = model->invisibleRootItem();
-    for(const auto &widget : widgets)
-    {
-        if(!widget)
-            continue;
-        QStandardItem *item = itemsById.value(widget->getId(), nullptr);
-        if(!item)
-            continue;
+    // Parsing, style warmup, image decoding and anchors run on workers; the
+    // canvas only sees the finished trees.
+    const QString label = filePaths.size() == 1 ? QFileInfo(filePaths.first()).fileName()
+                                                : QStringLiteral("%1 files").arg(filePaths.size());
+    auto *progress = new QProgressDialog(QStringLiteral("Importing %1...").arg(label), "Cancel", 0, 0, this);
+    progress->setWindowTitle("Import");
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(300);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    m_importWatcher = new QFutureWatcher<std::shared_ptr<ImportResult>>(this);
+    connect(m_importWatcher, &QFutureWatcherBase::progressRangeChanged, progress, &QProgressDialog::setRange);
+    connect(m_importWatcher, &QFutureWatcherBase::progressValueChanged, progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, m_importWatcher, &QFutureWatcherBase::cancel);
+    connect(m_importWatcher, &QFutureWatcherBase::finished, this, [this, progress, timer]() {
+        auto *watcher = std::exchange(m_importWatcher, nullptr);
+        watcher->deleteLater();
+        progress->hide();
+        progress->deleteLater();
+
+        // A failed recovery import leaves the crashed session's journal untouched.
+        const bool recover = std::exchange(m_recoverJournal, false);
+        if(watcher->isCanceled() || watcher->future().resultCount() == 0)
+            return;
 
-        OTUI::Widget *parentWidget = widget->getParent();
-        if(parentWidget)
-        {
-            QStandardItem *parentItem = itemsById.value(parentWidget->getId(), nullptr);
-            if(parentItem)
-                parentItem->appendRow(item);
-            else
-                root->appendRow(item);
-        }
-        else
+        QStringList errors;
+        int opened = 0;
+        for(const std::shared_ptr<ImportResult> &result : watcher->future().results())
         {
-            root->appendRow(item);
+            if(!result->loaded)
+            {
+                const QString error = result->error.isEmpty() ? QStringLiteral("Unknown parser error.") : result->error;
+                errors << (watcher->future().resultCount() == 1 ? error
+                                                                : QStringLiteral("%1: %2").arg(QFileInfo(result->filePath).fileName(), error));
+                continue;
+            }
+            for(const auto &widget : result->widgets)
+            {
+                if(widget)
+                    widget->finalizeImage();
+            }
+            addDocument(result->filePath, std::move(result->source), std::move(result->widgets));
+            startJournal(recover);
+            ++opened;
         }
-    }
-
-    if(model->rowCount() == 0)
-        return;
+        if(!errors.isEmpty())
+            ShowError("Parser Error", errors.join('\n'));
+        if(opened == 0)
+            return;
 
-    QString desiredId;
-    if(m_selected)
-        desiredId = m_selected->getId();
+        if(watcher->future().resultCount() > 1)
+            statusBar()->showMessage(QStringLiteral("Imported %1 of %2 files in %3 ms")
+                                         .arg(opened).arg(watcher->future().resultCount()).arg(timer.elapsed()), 10000);
+        if(m_Project)
+            setProjectChanged(true);
+    });
 
-    QStandardItem *fallbackItem = root->child(0);
-    QModelIndex targetIndex;
-    if(!desiredId.isEmpty())
-    {
-        const QModelIndexList matches = model->match(model->index(0, 0), Qt::DisplayRole, desiredId, 1, Qt::MatchRecursive);
-        if(!matches.isEmpty())
-            targetIndex = matches.first();
-    }
+    m_importWatcher->setFuture(QtConcurrent::run([filePaths, stylePaths, dataPath](QPromise<std::shared_ptr<ImportResult>> &promise) {
+        // Styles imported by the module are parsed once for all of its files.
+        OTUI::Parser::StyleSetPtr styles;
+        if(!stylePaths.isEmpty())
+        {
+            ModuleResourceScope moduleScope(stylePaths.first());
+            styles = OTUI::Parser().loadStyleSet(stylePaths, dataPath);
+        }
 
-    if(!targetIndex.isValid() && fallbackItem)
-        targetIndex = fallbackItem->index();
+        // Owned by this import only; files of a module share most of their images.
+        const auto images = std::make_shared<OTUI::ImageCache>();
+
+        const bool single = filePaths.size() == 1;
+        std::atomic<int> filesDone{0};
+        if(!single)
+            promise.setProgressRange(0, filePaths.size());
+
+        const std::function<std::shared_ptr<ImportResult>(const QString&)> load = [&](const QString &filePath) {
+            ModuleResourceScope moduleScope(filePath);
+            OTUI::Parser parser;
+            parser.setStyleSet(styles);
+            parser.setImageCache(images);
+            parser.setProgressHandler([&promise, single](int done, int total) {
+                if(single)
+                {
+                    if(done == 0)
+                        promise.setProgressRange(0, total);
+                    promise.setProgressValue(done);
+                }
+                return !promise.isCanceled();
+            });
 
-    if(!targetIndex.isValid())
-        return;
+            auto result = std::make_shared<ImportResult>();
+            result->filePath = filePath;
+            result->source = std::make_shared<OTUI::SourceDocument>();
+            result->loaded = parser.loadFromFile(filePath, result->widgets, &result->error, dataPath, result->source.get());
+            if(!single)
+                promise.setProgressValue(++filesDone);
+            return result;
+        };
 
-    ui->treeView->selectionModel()->select(targetIndex, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-    ui->treeView->selectionModel()->setCurrentIndex(targetIndex, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
-    QStandardItem *item = model->itemFromIndex(targetIndex);
-    if(item)
-        selectWidgetById(item->text());
-    ui->openGLWidget->m_selected = m_selected;
+        if(single)
+        {
+            promise.addResult(load(filePaths.first()));
+            return;
+        }
+        // Files are independent once the shared styles are loaded.
+        const QVector<std::shared_ptr<ImportResult>> results =
+                QtConcurrent::blockingMapped<QVector<std::shared_ptr<ImportResult>>>(filePaths, load);
+        if(promise.isCanceled())
+            return;
+        for(int i = 0; i < results.size(); ++i)
+            promise.addResult(results.at(i), i);
+    }));
+    return true;
 }
 
 void CoreWindow::initializePropertyPanel()
@@ -924,8 +1176,8 @@ void CoreWindow::connectPropertyEditors()
         const QString newId = ui->widgetIdLineEdit->text().trimmed();
         if(newId.isEmpty() || newId == m_selected->getId())
             return;
-        m_selected->setIdProperty(newId);
-        syncTreeSelection(m_selected);
+        recordEdit({WidgetProperty::Id}, [this, newId]() { m_selected->setIdProperty(newId); });
+        model->widgetChanged(m_selected);
         setProjectChanged(true);
     });
 
@@ -935,40 +1187,40 @@ void CoreWindow::connectPropertyEditors()
         const QString newText = ui->widgetTextLineEdit->text();
         if(newText == m_selected->textProperty())
             return;
-        m_selected->setTextProperty(newText);
+        recordEdit({WidgetProperty::Text}, [this, newText]() { m_selected->setTextProperty(newText); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     });
 
-    auto connectSpin = [this](QSpinBox *spin, auto updater) {
-        connect(spin, qOverload<int>(&QSpinBox::valueChanged), this, [this, updater](int value) {
+    auto connectSpin = [this](QSpinBox *spin, const QVector<WidgetProperty> &properties, auto updater) {
+        connect(spin, qOverload<int>(&QSpinBox::valueChanged), this, [this, properties, updater](int value) {
             if(m_updatingProperties || !m_selected)
                 return;
-            updater(value);
-            ui->openGLWidget->update();
+            recordEdit(properties, [updater, value]() { updater(value); });
+            ui->openGLWidget->notifyWidgetGeometryChanged(m_selected);
             setProjectChanged(true);
         });
     };
 
-    connectSpin(ui->posXSpin, [this](int value) {
+    connectSpin(ui->posXSpin, {WidgetProperty::Geometry}, [this](int value) {
         QPoint pos = m_selected->getPos();
         pos.setX(value);
         m_selected->setPos(pos);
     });
 
-    connectSpin(ui->posYSpin, [this](int value) {
+    connectSpin(ui->posYSpin, {WidgetProperty::Geometry}, [this](int value) {
         QPoint pos = m_selected->getPos();
         pos.setY(value);
         m_selected->setPos(pos);
     });
 
-    connectSpin(ui->widthSpin, [this](int value) {
+    connectSpin(ui->widthSpin, {WidgetProperty::Geometry}, [this](int value) {
         QRect rect = *m_selected->getRect();
         rect.setWidth(value);
         m_selected->setRect(rect);
     });
 
-    connectSpin(ui->heightSpin, [this](int value) {
+    connectSpin(ui->heightSpin, {WidgetProperty::Geometry}, [this](int value) {
         QRect rect = *m_selected->getRect();
         rect.setHeight(value);
         m_selected->setRect(rect);
@@ -977,7 +1229,7 @@ void CoreWindow::connectPropertyEditors()
     connect(ui->opacitySpin, qOverload<double>(&QDoubleSpinBox::valueChanged), this, [this](double value) {
         if(m_updatingProperties || !m_selected)
             return;
-        m_selected->setOpacity(static_cast<float>(value));
+        recordEdit({WidgetProperty::Opacity}, [this, value]() { m_selected->setOpacity(static_cast<float>(value)); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     });
@@ -985,7 +1237,7 @@ void CoreWindow::connectPropertyEditors()
     connect(ui->visibleCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
         if(m_updatingProperties || !m_selected)
             return;
-        m_selected->setVisibleProperty(checked);
+        recordEdit({WidgetProperty::Visible}, [this, checked]() { m_selected->setVisibleProperty(checked); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     });
@@ -998,7 +1250,7 @@ void CoreWindow::connectPropertyEditors()
         border.setY(ui->borderTopSpin->value());
         border.setWidth(ui->borderRightSpin->value());
         border.setHeight(ui->borderBottomSpin->value());
-        m_selected->setImageBorder(border);
+        recordEdit({WidgetProperty::ImageBorder}, [this, border]() { m_selected->setImageBorder(border); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     };
@@ -1011,7 +1263,7 @@ void CoreWindow::connectPropertyEditors()
     connect(ui->phantomCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
         if(m_updatingProperties || !m_selected)
             return;
-        m_selected->setPhantom(checked);
+        recordEdit({WidgetProperty::Phantom}, [this, checked]() { m_selected->setPhantom(checked); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     });
@@ -1024,7 +1276,7 @@ void CoreWindow::connectPropertyEditors()
         {
             if(m_selected->colorString().isEmpty())
                 return;
-            m_selected->setColor(QColor());
+            recordEdit({WidgetProperty::Color}, [this]() { m_selected->setColor(QColor()); });
             ui->openGLWidget->update();
             setProjectChanged(true);
             return;
@@ -1038,38 +1290,38 @@ void CoreWindow::connectPropertyEditors()
         }
         if(color == m_selected->getColor())
             return;
-        m_selected->setColor(color);
+        recordEdit({WidgetProperty::Color}, [this, color]() { m_selected->setColor(color); });
         ui->openGLWidget->update();
         setProjectChanged(true);
     });
 
-    connectSpin(ui->marginTopSpin, [this](int value) {
+    connectSpin(ui->marginTopSpin, {WidgetProperty::Margin, WidgetProperty::Geometry}, [this](int value) {
         m_selected->setMarginTop(value);
         applyAnchorsForWidget(m_selected);
     });
-    connectSpin(ui->marginRightSpin, [this](int value) {
+    connectSpin(ui->marginRightSpin, {WidgetProperty::Margin, WidgetProperty::Geometry}, [this](int value) {
         m_selected->setMarginRight(value);
         applyAnchorsForWidget(m_selected);
     });
-    connectSpin(ui->marginBottomSpin, [this](int value) {
+    connectSpin(ui->marginBottomSpin, {WidgetProperty::Margin, WidgetProperty::Geometry}, [this](int value) {
         m_selected->setMarginBottom(value);
         applyAnchorsForWidget(m_selected);
     });
-    connectSpin(ui->marginLeftSpin, [this](int value) {
+    connectSpin(ui->marginLeftSpin, {WidgetProperty::Margin, WidgetProperty::Geometry}, [this](int value) {
         m_selected->setMarginLeft(value);
         applyAnchorsForWidget(m_selected);
     });
 
-    connectSpin(ui->paddingTopSpin, [this](int value) {
+    connectSpin(ui->paddingTopSpin, {WidgetProperty::Padding}, [this](int value) {
         m_selected->setPaddingTop(value);
     });
-    connectSpin(ui->paddingRightSpin, [this](int value) {
+    connectSpin(ui->paddingRightSpin, {WidgetProperty::Padding}, [this](int value) {
         m_selected->setPaddingRight(value);
     });
-    connectSpin(ui->paddingBottomSpin, [this](int value) {
+    connectSpin(ui->paddingBottomSpin, {WidgetProperty::Padding}, [this](int value) {
         m_selected->setPaddingBottom(value);
     });
-    connectSpin(ui->paddingLeftSpin, [this](int value) {
+    connectSpin(ui->paddingLeftSpin, {WidgetProperty::Padding}, [this](int value) {
         m_selected->setPaddingLeft(value);
     });
 
@@ -1093,31 +1345,32 @@ void CoreWindow::connectPropertyEditors()
         if(m_updatingProperties || !m_selected)
             return;
 
-        if(!ctrl.check->isChecked())
-        {
-            m_selected->clearAnchorBinding(ctrl.edge);
-        }
-        else
-        {
-            QString targetId;
-            if(ctrl.target->currentIndex() == ctrl.target->count() - 1)
-                targetId = ctrl.custom->text().trimmed();
-            else
-                targetId = ctrl.target->currentData().toString();
-
-            if(targetId.isEmpty())
+        recordEdit({anchorProperty(ctrl.edge), WidgetProperty::Geometry}, [this, ctrl]() {
+            if(!ctrl.check->isChecked())
             {
                 m_selected->clearAnchorBinding(ctrl.edge);
             }
             else
             {
-                const QString token = anchorEdgeToken(ctrl.edge);
-                if(!token.isEmpty())
-                    m_selected->setAnchorFromDescriptor(ctrl.edge, QStringLiteral("%1.%2").arg(targetId, token));
-            }
-        }
+                QString targetId;
+                if(ctrl.target->currentIndex() == ctrl.target->count() - 1)
+                    targetId = ctrl.custom->text().trimmed();
+                else
+                    targetId = ctrl.target->currentData().toString();
 
-        applyAnchorsForWidget(m_selected);
+                if(targetId.isEmpty())
+                {
+                    m_selected->clearAnchorBinding(ctrl.edge);
+                }
+                else
+                {
+                    const QString token = anchorEdgeToken(ctrl.edge);
+                    if(!token.isEmpty())
+                        m_selected->setAnchorFromDescriptor(ctrl.edge, QStringLiteral("%1.%2").arg(targetId, token));
+                }
+            }
+            applyAnchorsForWidget(m_selected);
+        });
         ui->openGLWidget->update();
         setProjectChanged(true);
     };
@@ -1166,24 +1419,29 @@ void CoreWindow::connectPropertyEditors()
     for(const AnchorControl &ctrl : anchorControls)
         connectAnchorControl(ctrl);
 
-    auto connectAnchorTarget = [this](QLineEdit *lineEdit, auto updater) {
+    auto connectAnchorTarget = [this](QLineEdit *lineEdit, WidgetProperty property, auto updater) {
         if(!lineEdit)
             return;
-        connect(lineEdit, &QLineEdit::editingFinished, this, [this, lineEdit, updater]() {
+        connect(lineEdit, &QLineEdit::editingFinished, this, [this, lineEdit, property, updater]() {
             if(m_updatingProperties || !m_selected)
                 return;
-            if(!updater(lineEdit->text()))
+            bool updated = false;
+            recordEdit({property, WidgetProperty::Geometry}, [&]() {
+                updated = updater(lineEdit->text());
+                if(updated)
+                    applyAnchorsForWidget(m_selected);
+            });
+            if(!updated)
             {
                 updatePropertyPanel(m_selected);
                 return;
             }
-            applyAnchorsForWidget(m_selected);
             ui->openGLWidget->update();
             setProjectChanged(true);
         });
     };
 
-    connectAnchorTarget(ui->anchorCenterInLineEdit, [this](const QString &value) {
+    connectAnchorTarget(ui->anchorCenterInLineEdit, WidgetProperty::AnchorCenterIn, [this](const QString &value) {
         const QString trimmed = value.trimmed();
         if(m_selected->centerInTarget() == trimmed)
             return false;
@@ -1191,7 +1449,7 @@ void CoreWindow::connectPropertyEditors()
         return true;
     });
 
-    connectAnchorTarget(ui->anchorFillLineEdit, [this](const QString &value) {
+    connectAnchorTarget(ui->anchorFillLineEdit, WidgetProperty::AnchorFill, [this](const QString &value) {
         const QString trimmed = value.trimmed();
         if(m_selected->fillTarget() == trimmed)
             return false;
@@ -1450,7 +1708,7 @@ void CoreWindow::handleImageSelection(const QString &sourcePath)
         normalized.prepend('/');
 
     const QString dataPath = m_Project ? m_Project->getDataPath() : QString();
-    m_selected->setImageSource(normalized, dataPath);
+    recordEdit({WidgetProperty::ImageSource}, [this, normalized, dataPath]() { m_selected->setImageSource(normalized, dataPath); });
     if(m_imageSourceLabel)
         m_imageSourceLabel->setText(normalized);
     ui->openGLWidget->update();
@@ -1464,20 +1722,6 @@ void CoreWindow::handleStyleTemplateActivated(const QString &filePath, const QSt
     instantiateStyleIntoSelection(filePath, styleName);
 }
 
-OTUI::Widget *CoreWindow::findWidgetById(const QString &widgetId) const
-{
-    if(!ui || widgetId.isEmpty())
-        return nullptr;
-
-    const auto &widgets = ui->openGLWidget->getOTUIWidgets();
-    for(const auto &widget : widgets)
-    {
-        if(widget && widget->getId() == widgetId)
-            return widget.get();
-    }
-    return nullptr;
-}
-
 bool CoreWindow::instantiateStyleIntoSelection(const QString &filePath, const QString &styleName)
 {
     if(!m_Project)
@@ -1489,11 +1733,7 @@ bool CoreWindow::instantiateStyleIntoSelection(const QString &filePath, const QS
     OTUI::Widget *parentWidget = nullptr;
     if(ui->treeView && ui->treeView->currentIndex().isValid())
     {
-        QStandardItem *item = model ? model->itemFromIndex(ui->treeView->currentIndex()) : nullptr;
-        if(!item)
-            return false;
-
-        parentWidget = findWidgetById(item->text());
+        parentWidget = WidgetTreeModel::widgetAt(ui->treeView->currentIndex());
         if(!parentWidget)
         {
             ShowError("Selection Error", "Unable to locate the selected widget instance.");
@@ -1530,8 +1770,8 @@ bool CoreWindow::instantiateStyleIntoSelection(const QString &filePath, const QS
     }
 
     m_selected = createdRoot;
-    rebuildWidgetTree();
     syncTreeSelection(createdRoot);
+    recordInsertion(createdRoot);
     setProjectChanged(true);
     return true;
 }
@@ -1583,6 +1823,463 @@ void CoreWindow::applyAnchorsForWidget(OTUI::Widget *widget)
         }
         return lookup.value(id, nullptr);
     });
+    ui->openGLWidget->notifyWidgetGeometryChanged(widget);
+}
+
+void CoreWindow::recordEdit(const QVector<WidgetProperty> &properties, const std::function<void()> &edit)
+{
+    if(!m_selected)
+        return;
+
+    OTUI::Widget *widget = m_selected;
+    QVector<PropertyEditCommand::Change> changes;
+    changes.reserve(properties.size());
+    for(WidgetProperty property : properties)
+        changes.append({property, PropertyEditCommand::read(*widget, property), QVariant()});
+
+    edit();
+
+    // Only the properties that actually changed are kept in the history.
+    for(auto it = changes.begin(); it != changes.end();)
+    {
+        it->after = PropertyEditCommand::read(*widget, it->property);
+        if(it->after == it->before)
+            it = changes.erase(it);
+        else
+            ++it;
+    }
+    if(changes.isEmpty())
+        return;
+
+    const QString dataPath = m_Project ? m_Project->getDataPath() : QString();
+    m_history->push(std::make_unique<PropertyEditCommand>(ui->openGLWidget, widget, std::move(changes), dataPath));
+    m_journal->recordChanged(widget);
+}
+
+void CoreWindow::recordInsertion(OTUI::Widget *root)
+{
+    if(!root)
+        return;
+    m_history->breakMerge();
+    EditorDocument *document = activeDocument();
+    m_history->push(std::make_unique<StructureEditCommand>(ui->openGLWidget, StructureEditCommand::Kind::Insert, root,
+                                                           OpenGLWidget::DetachedWidgets(), document ? document->source : nullptr));
+}
+
+void CoreWindow::updateHistoryActions()
+{
+    const QString undoText = m_history->undoText();
+    const QString redoText = m_history->redoText();
+    ui->actionUndo->setEnabled(m_history->canUndo());
+    ui->actionRedo->setEnabled(m_history->canRedo());
+    ui->actionUndo->setText(undoText.isEmpty() ? QStringLiteral("Undo") : QStringLiteral("Undo %1").arg(undoText));
+    ui->actionRedo->setText(redoText.isEmpty() ? QStringLiteral("Redo") : QStringLiteral("Redo %1").arg(redoText));
+
+    const EditHistory::Stats stats = m_history->stats();
+    const QString usage = QStringLiteral("History: %1 entries, %2 per entry, %3 of %4")
+            .arg(stats.entries)
+            .arg(formatBytes(static_cast<qsizetype>(stats.bytesPerEntry())),
+                 formatBytes(stats.bytes),
+                 formatBytes(m_history->memoryLimit()));
+    ui->actionUndo->setStatusTip(usage);
+    ui->actionRedo->setStatusTip(usage);
+    ui->actionUndo->setToolTip(usage);
+}
+
+QString CoreWindow::journalPath(const QString &documentPath) const
+{
+    // Named after the document, so each one keeps its journal across tab switches.
+    const QByteArray key = QCryptographicHash::hash(documentPath.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return m_Project->getProjectFile()->fileName() + '.' + QString::fromLatin1(key) + ".journal";
+}
+
+void CoreWindow::startJournal(bool recover)
+{
+    if(!m_Project || !m_Project->getProjectFile())
+        return;
+
+    EditorDocument *document = activeDocument();
+    const QString documentPath = document ? document->path : QString();
+    const QVector<const OTUI::Widget*> documentOrder = document && document->source && document->source->isLoaded()
+            ? document->source->widgetOrder() : QVector<const OTUI::Widget*>();
+    QString error;
+    if(!m_journal->start(journalPath(documentPath), documentPath, m_Project->getDataPath(), recover, &error, documentOrder))
+        ShowError("Recover Edits", error);
+    if(!recover)
+        return;
+
+    if(document)
+    {
+        document->modified = true;
+        updateDocumentTab(m_activeDocument);
+    }
+
+    // Replayed widgets bypass the history, so the tree is rebuilt once.
+    model->beginReset();
+    model->endReset(ui->openGLWidget->getOTUIWidgets());
+    syncTreeSelection(WidgetTreeModel::widgetAt(model->index(0, 0)));
+    ui->openGLWidget->update();
+    setProjectChanged(true);
+}
+
+bool CoreWindow::saveProject()
+{
+    for(int i = 0; i < static_cast<int>(m_documents.size()); ++i)
+    {
+        EditorDocument *document = m_documents[i].get();
+        // Rewriting an untouched file would only invalidate the caches keyed by its mtime.
+        if(!document->source || document->path.isEmpty() || !document->modified)
+            continue;
+        const OTUI::Parser::WidgetList &widgets = i == m_activeDocument ? ui->openGLWidget->getOTUIWidgets() : document->widgets;
+        QString error;
+        const bool saved = document->source->save(document->path, widgets, &error);
+        if(!error.isEmpty())
+            ShowError("Save Error", error);
+        if(!saved)
+            return false;
+        document->modified = false;
+        updateDocumentTab(i);
+
+        // The saved file is the new starting point for its crash recovery.
+        if(i == m_activeDocument)
+            startJournal(false);
+        else
+            m_journal->reset(journalPath(document->path), document->path, document->source->widgetOrder());
+    }
+    return m_Project->save();
+}
+
+void CoreWindow::applyTextureBudget()
+{
+    if(m_Project)
+        OTUI::TextureManager::instance().setBudget(static_cast<qint64>(m_Project->getTextureBudget()) * 1024 * 1024);
+    trimInactiveDocuments();
+}
+
+void CoreWindow::applyHistorySettings(EditHistory *history)
+{
+    if(!m_Project)
+        return;
+    if(history)
+    {
+        history->setMemoryLimit(static_cast<qsizetype>(m_Project->getHistoryLimit()) * 1024 * 1024);
+        history->setMergeInterval(m_Project->getMergeInterval());
+        return;
+    }
+    for(const auto &document : m_documents)
+    {
+        // Dropping old undo steps leaves the document itself as it was.
+        const bool modified = document->modified;
+        applyHistorySettings(document->history.get());
+        document->modified = modified;
+    }
+}
+
+QString CoreWindow::modulesRootPath() const
+{
+    if(!m_Project)
+        return QString();
+    const QDir projectDir(m_Project->getProjectPath());
+    if(projectDir.exists(QStringLiteral("modules")))
+        return projectDir.filePath(QStringLiteral("modules"));
+    QDir dataDir(m_Project->getDataPath());
+    if(dataDir.cdUp() && dataDir.exists(QStringLiteral("modules")))
+        return dataDir.filePath(QStringLiteral("modules"));
+    return QString();
+}
+
+void CoreWindow::refreshProjectIndexes()
+{
+    if(!m_Project)
+        return;
+    const QString modulesRoot = modulesRootPath();
+    const QString dataPath = m_Project->getDataPath();
+    m_xrefIndex->setRoots(QStringList() << dataPath << modulesRoot);
+    if(m_moduleIndexWatcher || modulesRoot.isEmpty())
+        return;
+
+    const QString cachePath = m_Project->getProjectFile()->fileName() + ".modules";
+    m_moduleIndexWatcher = new QFutureWatcher<std::shared_ptr<const ModuleIndex>>(this);
+    connect(m_moduleIndexWatcher, &QFutureWatcherBase::finished, this, [this]() {
+        auto *watcher = std::exchange(m_moduleIndexWatcher, nullptr);
+        watcher->deleteLater();
+        if(watcher->future().resultCount() == 0)
+            return;
+        m_moduleIndex = watcher->result();
+        m_xrefIndex->setModules(m_moduleIndex);
+    });
+    // Built off to the side and swapped in whole, so lookups never see a half done index.
+    m_moduleIndexWatcher->setFuture(QtConcurrent::run([cachePath, modulesRoot, dataPath]() {
+        auto index = std::make_shared<ModuleIndex>();
+        index->load(cachePath);
+        if(index->refresh(modulesRoot, dataPath).rescanned > 0)
+            index->save(cachePath);
+        return std::shared_ptr<const ModuleIndex>(std::move(index));
+    }));
+}
+
+void CoreWindow::showXRefLocations(const QString &title, const QVector<XRefIndex::Location> &locations)
+{
+    if(locations.isEmpty())
+    {
+        statusBar()->showMessage(m_xrefIndex->isBuilding() ? QStringLiteral("%1: still indexing the project").arg(title)
+                                                          : QStringLiteral("%1: nothing found").arg(title), 5000);
+        return;
+    }
+
+    const QDir root(m_Project ? m_Project->getProjectPath() : QString());
+    QStringList labels;
+    for(const XRefIndex::Location &location : locations)
+    {
+        QString label = root.relativeFilePath(location.filePath);
+        if(location.line > 0)
+            label += QStringLiteral(":%1").arg(location.line);
+        if(!location.context.isEmpty())
+            label += QStringLiteral("  ") + location.context;
+
+        // Which modules reach the location, through the file they load.
+        QStringList modules;
+        for(const XRefIndex::Location &module : m_xrefIndex->fileUsages(location.filePath))
+        {
+            const QString name = module.context.section(QLatin1Char(':'), 0, 0);
+            if(!modules.contains(name))
+                modules << name;
+        }
+        if(!modules.isEmpty())
+            label += QStringLiteral("  [%1]").arg(modules.join(QStringLiteral(", ")));
+        labels << label;
+    }
+
+    bool ok = false;
+    const QString choice = QInputDialog::getItem(this,
+                                                 title,
+                                                 QStringLiteral("%1 found:").arg(locations.size()),
+                                                 labels,
+                                                 0,
+                                                 false,
+                                                 &ok);
+    const int index = labels.indexOf(choice);
+    if(!ok || index < 0)
+        return;
+
+    const XRefIndex::Location &location = locations.at(index);
+    if(location.filePath.endsWith(QStringLiteral(".otui"), Qt::CaseInsensitive))
+        importOtuiFile(location.filePath);
+    else
+        QDesktopServices::openUrl(QUrl::fromLocalFile(location.filePath));
+}
+
+EditorDocument *CoreWindow::activeDocument() const
+{
+    if(m_activeDocument < 0 || m_activeDocument >= static_cast<int>(m_documents.size()))
+        return nullptr;
+    return m_documents[m_activeDocument].get();
+}
+
+int CoreWindow::documentIndex(const QString &path) const
+{
+    if(path.isEmpty())
+        return -1;
+    const QString canonical = QFileInfo(path).canonicalFilePath();
+    if(canonical.isEmpty())
+        return -1;
+    for(int i = 0; i < static_cast<int>(m_documents.size()); ++i)
+    {
+        if(!m_documents[i]->path.isEmpty() && QFileInfo(m_documents[i]->path).canonicalFilePath() == canonical)
+            return i;
+    }
+    return -1;
+}
+
+void CoreWindow::addDocument(const QString &path, std::shared_ptr<OTUI::SourceDocument> source, OTUI::Parser::WidgetList widgets)
+{
+    auto document = std::make_unique<EditorDocument>();
+    document->path = path;
+    document->source = std::move(source);
+    document->widgets = std::move(widgets);
+    document->history = std::make_unique<EditHistory>();
+    applyHistorySettings(document->history.get());
+
+    // Only the active history is undone or redone, so only it reports back here.
+    EditHistory *history = document->history.get();
+    EditorDocument *added = document.get();
+    connect(history, &EditHistory::changed, this, [this, history, added]() {
+        added->modified = true;
+        if(history != m_history)
+            return;
+        updateHistoryActions();
+        updateDocumentTab(m_activeDocument);
+    });
+    connect(history, &EditHistory::applied, this, [this](OTUI::Widget *widget) {
+        if(widget && model->indexOf(widget).isValid())
+        {
+            model->widgetChanged(widget);
+            syncTreeSelection(widget);
+            updatePropertyPanel(widget);
+            m_journal->recordChanged(widget);
+        }
+        ui->openGLWidget->update();
+        setProjectChanged(true);
+    });
+
+    const EditorDocument *current = activeDocument();
+    const int replaced = current && current->path.isEmpty() && !current->modified &&
+            ui->openGLWidget->getOTUIWidgets().empty() ? m_activeDocument : -1;
+
+    const QSignalBlocker blocker(m_documentTabs);
+    m_documents.push_back(std::move(document));
+    const int index = m_documentTabs->addTab(QString());
+    updateDocumentTab(index);
+    activateDocument(index);
+    if(replaced >= 0)
+    {
+        if(m_Project)
+            m_journal->discard(journalPath(m_documents[replaced]->path));
+        m_documents.erase(m_documents.begin() + replaced);
+        m_documentTabs->removeTab(replaced);
+        m_activeDocument = index - 1;
+    }
+}
+
+void CoreWindow::activateDocument(int index)
+{
+    if(index < 0 || index >= static_cast<int>(m_documents.size()) || index == m_activeDocument)
+        return;
+
+    EditorDocument *previous = activeDocument();
+    if(previous)
+    {
+        previous->viewOrigin = ui->openGLWidget->viewOrigin();
+        previous->selected = m_selected;
+        previous->history->breakMerge();
+    }
+
+    EditorDocument *next = m_documents[index].get();
+    next->restoreImages();
+    OTUI::Parser::WidgetList parked = ui->openGLWidget->setWidgets(std::move(next->widgets));
+    next->widgets.clear();
+    if(previous)
+        previous->widgets = std::move(parked);
+
+    m_activeDocument = index;
+    m_history = next->history.get();
+    // A document that was shown before continues its own journal; a new one
+    // is started by whoever added it.
+    if(m_journal && m_Project)
+        m_journal->resume(journalPath(next->path));
+    next->lastShown = ++m_documentClock;
+    if(m_documentTabs->currentIndex() != index)
+    {
+        const QSignalBlocker blocker(m_documentTabs);
+        m_documentTabs->setCurrentIndex(index);
+    }
+
+    ui->openGLWidget->setViewOrigin(next->viewOrigin);
+    syncTreeSelection(next->selected ? next->selected : WidgetTreeModel::widgetAt(model->index(0, 0)));
+    updateHistoryActions();
+    trimInactiveDocuments();
+}
+
+bool CoreWindow::closeDocument(int index)
+{
+    if(index < 0 || index >= static_cast<int>(m_documents.size()))
+        return false;
+
+    EditorDocument *document = m_documents[index].get();
+    if(document->modified && document->source && !document->path.isEmpty())
+    {
+        const QMessageBox::StandardButton response = QMessageBox::question(this, "Save Changes",
+                     QStringLiteral("Do you want to save %1 before closing it?").arg(document->title()),
+                     QMessageBox::Cancel | QMessageBox::No | QMessageBox::Yes,
+                     QMessageBox::Yes);
+        if(response == QMessageBox::Cancel)
+            return false;
+        if(response == QMessageBox::Yes)
+        {
+            const OTUI::Parser::WidgetList &widgets = index == m_activeDocument ? ui->openGLWidget->getOTUIWidgets() : document->widgets;
+            QString error;
+            const bool saved = document->source->save(document->path, widgets, &error);
+            if(!error.isEmpty())
+                ShowError("Save Error", error);
+            if(!saved)
+                return false;
+        }
+    }
+
+    // Whatever was not saved was declined.
+    if(m_Project)
+        m_journal->discard(journalPath(document->path));
+
+    if(m_documents.size() == 1)
+    {
+        resetDocuments();
+        startJournal(false);
+        return true;
+    }
+
+    const QSignalBlocker blocker(m_documentTabs);
+    if(index == m_activeDocument)
+        activateDocument(index > 0 ? index - 1 : index + 1);
+    m_documents.erase(m_documents.begin() + index);
+    m_documentTabs->removeTab(index);
+    if(m_activeDocument > index)
+        --m_activeDocument;
+    m_documentTabs->setCurrentIndex(m_activeDocument);
+    return true;
+}
+
+void CoreWindow::resetDocuments()
+{
+    m_selected = nullptr;
+    ui->openGLWidget->clearWidgets();
+    m_history = nullptr;
+    m_activeDocument = -1;
+    {
+        const QSignalBlocker blocker(m_documentTabs);
+        while(m_documentTabs->count() > 0)
+            m_documentTabs->removeTab(0);
+    }
+    m_documents.clear();
+    addDocument(QString(), nullptr, {});
+}
+
+void CoreWindow::updateDocumentTab(int index)
+{
+    if(index < 0 || index >= static_cast<int>(m_documents.size()))
+        return;
+    const EditorDocument *document = m_documents[index].get();
+    m_documentTabs->setTabText(index, document->modified ? document->title() + " *" : document->title());
+    m_documentTabs->setTabToolTip(index, QDir::toNativeSeparators(document->path));
+}
+
+void CoreWindow::trimInactiveDocuments()
+{
+    // Pixmaps of documents in the background that the shared cache has already
+    // evicted, so releasing them frees memory. Half the texture budget, 128 MiB
+    // with the default.
+    const qint64 inactiveImageBudget = (m_Project ? m_Project->getTextureBudget() : 256) * qint64(1024 * 1024) / 2;
+
+    std::vector<EditorDocument*> parked;
+    qint64 bytes = 0;
+    for(int i = 0; i < static_cast<int>(m_documents.size()); ++i)
+    {
+        EditorDocument *document = m_documents[i].get();
+        if(i == m_activeDocument || document->imagesReleased)
+            continue;
+        parked.push_back(document);
+        bytes += document->imageBytes();
+    }
+
+    std::sort(parked.begin(), parked.end(), [](const EditorDocument *a, const EditorDocument *b) {
+        return a->lastShown < b->lastShown;
+    });
+    for(EditorDocument *document : parked)
+    {
+        if(bytes <= inactiveImageBudget)
+            break;
+        bytes -= document->imageBytes();
+        document->releaseImages();
+    }
 }
 
 void CoreWindow::syncTreeSelection(OTUI::Widget *widget)
@@ -1593,11 +2290,11 @@ void CoreWindow::syncTreeSelection(OTUI::Widget *widget)
     if(!ui->treeView->selectionModel())
         return;
 
-    const QModelIndexList matches = model->match(model->index(0, 0), Qt::DisplayRole, widget->getId(), 1, Qt::MatchRecursive);
-    if(matches.isEmpty())
+    const QModelIndex index = model->indexOf(widget);
+    if(!index.isValid())
         return;
 
-    const QModelIndex &index = matches.first();
     ui->treeView->selectionModel()->select(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
     ui->treeView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    ui->treeView->scrollTo(index);
 }
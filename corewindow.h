@@ -1,9 +1,9 @@
 #ifndef COREWINDOW_H
 #define COREWINDOW_H
 
+#include <QFutureWatcher>
 #include <QMainWindow>
 #include <QMessageBox>
-#include <QStandardItem>
 #include <QItemSelectionModel>
 #include <QKeyEvent>
 
@@ -17,8 +17,23 @@
 #include "stylesourcebrowser.h"
 #include "elidedlabel.h"
 #include "projectsettings.h"
+#include "widgettreemodel.h"
+#include "xrefindex.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
 
 class QPushButton;
+class QTabBar;
+class EditHistory;
+class EditJournal;
+class ModuleIndex;
+enum class WidgetProperty : quint8;
+struct EditorDocument;
+namespace OTUI {
+class SourceDocument;
+}
 
 namespace Ui {
 class MainWindow;
@@ -65,8 +80,18 @@ private slots:
 
     void on_actionProject_Settings_triggered();
 
+    void on_actionRenderStats_toggled(bool checked);
+
+    void on_actionExportRenderStats_triggered();
+
+    void on_actionExportImage_triggered();
+
     void on_newImage_triggered();
 
+    void on_actionUndo_triggered();
+
+    void on_actionRedo_triggered();
+
     void handleStyleTemplateActivated(const QString &filePath, const QString &styleName);
 
 protected:
@@ -83,14 +108,52 @@ private:
     void setPropertyEditorsEnabled(bool enabled);
     void updatePropertyPanel(OTUI::Widget *widget);
     void setProjectChanged(bool v);
+    // Starts a background import; false while another one is still running.
     bool importOtuiFile(const QString &filePath, const QString &dataPathOverride = QString());
-    void rebuildWidgetTree();
+    // Parses filePaths in parallel and opens each in a tab; stylePaths are
+    // parsed once first and shared by all of them.
+    bool importOtuiFiles(const QStringList &filePaths, const QStringList &stylePaths, const QString &dataPathOverride = QString());
     void handleImageSelection(const QString &sourcePath);
     void syncTreeSelection(OTUI::Widget *widget);
-    OTUI::Widget *findWidgetById(const QString &widgetId) const;
     bool instantiateStyleIntoSelection(const QString &filePath, const QString &styleName);
     void showStylesBrowser();
     void applyAnchorsForWidget(OTUI::Widget *widget);
+    // Runs an edit on the selected widget and records the properties it changed.
+    void recordEdit(const QVector<WidgetProperty> &properties, const std::function<void()> &edit);
+    void recordInsertion(OTUI::Widget *root);
+    void updateHistoryActions();
+    // Edit journal of the document at documentPath, next to the project file.
+    QString journalPath(const QString &documentPath) const;
+    // Restarts the active document's edit journal for the canvas as it is
+    // now, or replays the one a crashed session left behind first.
+    void startJournal(bool recover);
+    // Writes the open documents back in place, then the project file.
+    bool saveProject();
+    // Hands the project's texture budget to the shared TextureManager and trims
+    // background documents to their half of it.
+    void applyTextureBudget();
+    // Applies the project's undo memory limit and merge window to history,
+    // or to the history of every open document.
+    void applyHistorySettings(EditHistory *history = nullptr);
+
+    EditorDocument *activeDocument() const;
+    int documentIndex(const QString &path) const;
+    // Shows widgets in a new tab; an untouched empty Untitled tab is replaced.
+    void addDocument(const QString &path, std::shared_ptr<OTUI::SourceDocument> source, OTUI::Parser::WidgetList widgets);
+    // Parks the canvas in the active document and shows the one at index.
+    void activateDocument(int index);
+    bool closeDocument(int index);
+    // Drops every document and leaves one empty Untitled tab.
+    void resetDocuments();
+    void updateDocumentTab(int index);
+    // Releases pixmaps of the least recently shown documents over half the texture budget.
+    void trimInactiveDocuments();
+    QString modulesRootPath() const;
+    // Brings the project's module and cross-reference indexes up to date on
+    // worker threads.
+    void refreshProjectIndexes();
+    // Lists locations and opens the file of the one picked.
+    void showXRefLocations(const QString &title, const QVector<XRefIndex::Location> &locations);
 
 private:
     Ui::MainWindow *ui;
@@ -98,17 +161,28 @@ private:
     OTUI::Project *m_Project = nullptr;
     OTUI::Parser m_parser;
 
-    QStandardItemModel *model = nullptr;
+    WidgetTreeModel *model = nullptr;
+
+    struct ImportResult;
+    QFutureWatcher<std::shared_ptr<ImportResult>> *m_importWatcher = nullptr;
+    std::shared_ptr<const ModuleIndex> m_moduleIndex;
+    QFutureWatcher<std::shared_ptr<const ModuleIndex>> *m_moduleIndexWatcher = nullptr;
+    XRefIndex *m_xrefIndex = nullptr;
 
-    void addChildToTree(QString label);
-    void selectWidgetById(QString widgetId);
+    EditHistory *m_history = nullptr;
+    EditJournal *m_journal = nullptr;
+    bool m_recoverJournal = false;
 
     OTUI::Widget *m_selected = nullptr;
     ImageSourceBrowser *imagesBrowser = nullptr;
     StyleSourceBrowser *stylesBrowser = nullptr;
     ProjectSettings *m_projectSettings = nullptr;
 
-    QString m_currentOtuiPath;
+    // Open .otui files; m_history belongs to the active one.
+    std::vector<std::unique_ptr<EditorDocument>> m_documents;
+    int m_activeDocument = -1;
+    quint64 m_documentClock = 0;
+    QTabBar *m_documentTabs = nullptr;
     bool m_updatingProperties = false;
     ElidedLabel *m_imageSourceLabel = nullptr;
     QPushButton *m_imageBrowseButton = nullptr;
@@ -0,0 +1,122 @@
+#include "edithistory.h"
+
+#include <algorithm>
+
+EditHistory::EditHistory(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void EditHistory::push(std::unique_ptr<EditCommand> command)
+{
+    if(!command)
+        return;
+
+    while(canRedo())
+    {
+        m_bytes -= m_commands.back()->byteSize();
+        m_commands.pop_back();
+    }
+
+    const bool withinInterval = m_lastPush.isValid() && m_lastPush.elapsed() <= m_mergeInterval;
+    m_lastPush.start();
+    if(m_mergeable && withinInterval && m_index > 0)
+    {
+        EditCommand &top = *m_commands.back();
+        const qsizetype before = top.byteSize();
+        if(top.mergeWith(*command))
+        {
+            m_bytes += top.byteSize() - before;
+            ++m_merged;
+            trimToLimit();
+            emit changed();
+            return;
+        }
+    }
+
+    m_bytes += command->byteSize();
+    m_commands.push_back(std::move(command));
+    m_index = static_cast<int>(m_commands.size());
+    m_mergeable = true;
+    trimToLimit();
+    emit changed();
+}
+
+void EditHistory::undo()
+{
+    if(!canUndo())
+        return;
+    EditCommand &command = *m_commands.at(--m_index);
+    m_mergeable = false;
+    // Structural commands own their widgets only while they are detached.
+    const qsizetype before = command.byteSize();
+    command.undo();
+    m_bytes += command.byteSize() - before;
+    emit applied(command.widget());
+    emit changed();
+}
+
+void EditHistory::redo()
+{
+    if(!canRedo())
+        return;
+    EditCommand &command = *m_commands.at(m_index++);
+    m_mergeable = false;
+    const qsizetype before = command.byteSize();
+    command.redo();
+    m_bytes += command.byteSize() - before;
+    emit applied(command.widget());
+    emit changed();
+}
+
+void EditHistory::clear()
+{
+    m_commands.clear();
+    m_index = 0;
+    m_bytes = 0;
+    m_mergeable = false;
+    emit changed();
+}
+
+QString EditHistory::undoText() const
+{
+    return canUndo() ? m_commands.at(m_index - 1)->text() : QString();
+}
+
+QString EditHistory::redoText() const
+{
+    return canRedo() ? m_commands.at(m_index)->text() : QString();
+}
+
+void EditHistory::setMemoryLimit(qsizetype bytes)
+{
+    m_memoryLimit = std::max<qsizetype>(0, bytes);
+    const std::size_t before = m_commands.size();
+    trimToLimit();
+    if(m_commands.size() != before)
+        emit changed();
+}
+
+EditHistory::Stats EditHistory::stats() const
+{
+    Stats result;
+    result.entries = static_cast<int>(m_commands.size());
+    result.bytes = m_bytes;
+    for(const auto &command : m_commands)
+        result.largestEntry = std::max(result.largestEntry, command->byteSize());
+    result.merged = m_merged;
+    result.evicted = m_evicted;
+    return result;
+}
+
+void EditHistory::trimToLimit()
+{
+    // Oldest undo entries go first; the newest entry always stays.
+    while(m_bytes > m_memoryLimit && m_index > 1)
+    {
+        m_bytes -= m_commands.front()->byteSize();
+        m_commands.pop_front();
+        --m_index;
+        ++m_evicted;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <deque>
+#include <memory>
+#include "otui/otui.h"
+
+// One undoable edit. Commands record what changed, never a copy of the document.
+class EditCommand
+{
+public:
+    virtual ~EditCommand() = default;
+
+    virtual void undo() = 0;
+    virtual void redo() = 0;
+    // Folds a newer edit into this one; only asked for the entry on top of the stack.
+    virtual bool mergeWith(const EditCommand &) { return false; }
+    // Approximate heap footprint, counted against the history memory limit.
+    virtual qsizetype byteSize() const = 0;
+    virtual QString text() const = 0;
+    // Widget to select after undo or redo; it may no longer be in the store.
+    virtual OTUI::Widget *widget() const { return nullptr; }
+};
+
+class EditHistory : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        int entries = 0;
+        qsizetype bytes = 0;
+        qsizetype largestEntry = 0;
+        quint64 merged = 0;
+        quint64 evicted = 0;
+
+        double bytesPerEntry() const { return entries > 0 ? static_cast<double>(bytes) / entries : 0.0; }
+    };
+
+    explicit EditHistory(QObject *parent = nullptr);
+
+    // Records an edit that has already been applied. Drops the redo branch and,
+    // once over the memory limit, the oldest entries.
+    void push(std::unique_ptr<EditCommand> command);
+    void undo();
+    void redo();
+    void clear();
+
+    bool canUndo() const { return m_index > 0; }
+    bool canRedo() const { return m_index < static_cast<int>(m_commands.size()); }
+    QString undoText() const;
+    QString redoText() const;
+
+    // Consecutive edits within this window may merge into one entry.
+    void setMergeInterval(int msecs) { m_mergeInterval = msecs; }
+    // Ends the current merge run, e.g. when the selection changes.
+    void breakMerge() { m_mergeable = false; }
+
+    void setMemoryLimit(qsizetype bytes);
+    qsizetype memoryLimit() const { return m_memoryLimit; }
+    Stats stats() const;
+
+signals:
+    void changed();
+    void applied(OTUI::Widget *widget);
+
+private:
+    void trimToLimit();
+
+    std::deque<std::unique_ptr<EditCommand>> m_commands;
+    // Number of applied commands; the rest form the redo branch.
+    int m_index = 0;
+    qsizetype m_bytes = 0;
+    qsizetype m_memoryLimit = 16 * 1024 * 1024;
+    int m_mergeInterval = 1000;
+    bool m_mergeable = false;
+    QElapsedTimer m_lastPush;
+    quint64 m_merged = 0;
+    quint64 m_evicted = 0;
+};
+
+#endif // EDITHISTORY_H
@@ -0,0 +1,647 @@
+#include "editjournal.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <utility>
+#include "openglwidget.h"
+#include "widgetcommands.h"
+
+namespace {
+constexpr quint32 kJournalMagic = 0x4F544A4C; // "OTJL"
+constexpr quint16 kJournalVersion = 1;
+constexpr quint32 kNoKey = 0xFFFFFFFF;
+// Appended records before the log is rewritten with one record per widget.
+constexpr int kCompactThreshold = 1024;
+
+enum class RecordKind : quint8 {
+    Widget,
+    Removed
+};
+
+struct Header {
+    QString documentPath;
+    qint64 documentSize = 0;
+    qint64 documentModified = 0;
+    quint32 baseCount = 0;
+};
+
+const WidgetProperty kJournalProperties[] = {
+    WidgetProperty::Id,
+    WidgetProperty::Text,
+    WidgetProperty::Geometry,
+    WidgetProperty::Opacity,
+    WidgetProperty::Visible,
+    WidgetProperty::Phantom,
+    WidgetProperty::Color,
+    WidgetProperty::ImageSource,
+    WidgetProperty::ImageBorder,
+    WidgetProperty::Margin,
+    WidgetProperty::Padding,
+    WidgetProperty::AnchorLeft,
+    WidgetProperty::AnchorRight,
+    WidgetProperty::AnchorTop,
+    WidgetProperty::AnchorBottom,
+    WidgetProperty::AnchorHorizontalCenter,
+    WidgetProperty::AnchorVerticalCenter,
+    WidgetProperty::AnchorCenterIn,
+    WidgetProperty::AnchorFill
+};
+
+void prepareStream(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_6_0);
+}
+
+Header documentHeader(const QString &documentPath, quint32 baseCount)
+{
+    Header header;
+    header.documentPath = documentPath;
+    header.baseCount = baseCount;
+    if(!documentPath.isEmpty())
+    {
+        const QFileInfo info(documentPath);
+        header.documentSize = info.size();
+        header.documentModified = info.lastModified().toMSecsSinceEpoch();
+    }
+    return header;
+}
+
+void writeHeader(QDataStream &stream, const Header &header)
+{
+    stream << kJournalMagic << kJournalVersion
+           << header.documentPath << header.documentSize << header.documentModified << header.baseCount;
+}
+
+QByteArray headerBytes(const Header &header)
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    prepareStream(stream);
+    writeHeader(stream, header);
+    return bytes;
+}
+
+bool readHeader(QDataStream &stream, Header &header)
+{
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if(magic != kJournalMagic || version != kJournalVersion)
+        return false;
+    stream >> header.documentPath >> header.documentSize >> header.documentModified >> header.baseCount;
+    return stream.status() == QDataStream::Ok;
+}
+
+std::unique_ptr<OTUI::Widget> createWidget(const QString &className, const QString &dataPath)
+{
+    if(className == QLatin1String("MainWindow"))
+        return std::make_unique<OTUI::MainWindow>(QString(), dataPath, QString());
+    if(className == QLatin1String("Button"))
+        return std::make_unique<OTUI::Button>(QString(), dataPath, QString());
+    if(className == QLatin1String("Label"))
+        return std::make_unique<OTUI::Label>(QString(), dataPath, QString());
+    if(className == QLatin1String("Image"))
+        return std::make_unique<OTUI::Image>(QString(), dataPath, QString());
+    if(className == QLatin1String("Item"))
+        return std::make_unique<OTUI::Item>(QString(), dataPath, QString());
+    if(className == QLatin1String("Creature"))
+        return std::make_unique<OTUI::Creature>(QString(), dataPath, QString());
+    return std::make_unique<OTUI::Widget>(QString(), dataPath, QString());
+}
+
+int depthOf(const OTUI::Widget *widget)
+{
+    int depth = 0;
+    for(const OTUI::Widget *parent = widget->getParent(); parent; parent = parent->getParent())
+        ++depth;
+    return depth;
+}
+}
+
+// Owns the journal file; lives on EditJournal's thread.
+class JournalWriter : public QObject
+{
+public:
+    void start(const QString &path, const QByteArray &header, quint32 baseCount, bool keepRecords);
+    void append(RecordKind kind, quint32 key, const QByteArray &payload);
+    void stop(bool discard);
+    // Leaves a journal other than the open one with just its header.
+    void reset(const QString &path, const QByteArray &header);
+    void remove(const QString &path);
+
+private:
+    void keep(RecordKind kind, quint32 key, const QByteArray &payload);
+    bool compact();
+
+    QString m_path;
+    QByteArray m_header;
+    quint32 m_baseCount = 0;
+    QFile m_file;
+    // Latest record per widget. Removals only matter for widgets of the
+    // document itself; widgets added in the session just disappear.
+    std::map<quint32, QByteArray> m_widgets;
+    std::map<quint32, QByteArray> m_removed;
+    int m_appended = 0;
+};
+
+void JournalWriter::start(const QString &path, const QByteArray &header, quint32 baseCount, bool keepRecords)
+{
+    m_file.close();
+    m_path = path;
+    m_header = header;
+    m_baseCount = baseCount;
+    m_widgets.clear();
+    m_removed.clear();
+
+    if(keepRecords)
+    {
+        QFile file(path);
+        if(file.open(QIODevice::ReadOnly))
+        {
+            QDataStream stream(&file);
+            prepareStream(stream);
+            Header existing;
+            if(readHeader(stream, existing))
+            {
+                while(!stream.atEnd())
+                {
+                    QByteArray payload;
+                    stream >> payload;
+                    if(stream.status() != QDataStream::Ok)
+                        break;
+                    QDataStream record(payload);
+                    prepareStream(record);
+                    quint8 kind = 0;
+                    quint32 key = kNoKey;
+                    record >> kind >> key;
+                    keep(static_cast<RecordKind>(kind), key, payload);
+                }
+            }
+        }
+    }
+
+    if(!compact())
+        qWarning("Unable to write edit journal %s", qPrintable(path));
+}
+
+void JournalWriter::append(RecordKind kind, quint32 key, const QByteArray &payload)
+{
+    if(!m_file.isOpen())
+        return;
+
+    keep(kind, key, payload);
+    QDataStream stream(&m_file);
+    prepareStream(stream);
+    stream << payload;
+    m_file.flush();
+
+    if(++m_appended >= kCompactThreshold && !compact())
+        qWarning("Unable to compact edit journal %s", qPrintable(m_path));
+}
+
+void JournalWriter::stop(bool discard)
+{
+    m_file.close();
+    if(discard && !m_path.isEmpty())
+        QFile::remove(m_path);
+    m_path.clear();
+    m_widgets.clear();
+    m_removed.clear();
+}
+
+void JournalWriter::reset(const QString &path, const QByteArray &header)
+{
+    QSaveFile out(path);
+    if(!out.open(QIODevice::WriteOnly) || out.write(header) != header.size() || !out.commit())
+        qWarning("Unable to write edit journal %s", qPrintable(path));
+}
+
+void JournalWriter::remove(const QString &path)
+{
+    if(path == m_path)
+        stop(true);
+    else
+        QFile::remove(path);
+}
+
+void JournalWriter::keep(RecordKind kind, quint32 key, const QByteArray &payload)
+{
+    if(kind == RecordKind::Widget)
+    {
+        m_widgets[key] = payload;
+        return;
+    }
+    m_widgets.erase(key);
+    if(key < m_baseCount)
+        m_removed[key] = payload;
+}
+
+bool JournalWriter::compact()
+{
+    // The rewrite replaces the log atomically; a crash keeps the old one.
+    m_file.close();
+    m_appended = 0;
+
+    QSaveFile out(m_path);
+    if(!out.open(QIODevice::WriteOnly))
+        return false;
+    out.write(m_header);
+    QDataStream stream(&out);
+    prepareStream(stream);
+    // Keys grow with creation order, so parents are written before children.
+    for(const auto &entry : m_widgets)
+        stream << entry.second;
+    for(const auto &entry : m_removed)
+        stream << entry.second;
+    if(!out.commit())
+        return false;
+
+    m_file.setFileName(m_path);
+    return m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+EditJournal::EditJournal(OpenGLWidget *canvas, QObject *parent)
+    : QObject(parent),
+      m_canvas(canvas),
+      m_writer(new JournalWriter)
+{
+    m_thread.setObjectName(QStringLiteral("EditJournal"));
+    m_writer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_writer, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+
+    connect(canvas, &OpenGLWidget::widgetsInserted, this, &EditJournal::recordInserted);
+    connect(canvas, &OpenGLWidget::widgetAboutToBeRemoved, this, &EditJournal::recordRemoved);
+}
+
+EditJournal::~EditJournal()
+{
+    // Flushes pending records; the file stays unless stop(true) ran before.
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer]() { writer->stop(false); }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+EditJournal::Info EditJournal::inspect(const QString &journalPath)
+{
+    Info info;
+    QFile file(journalPath);
+    if(!file.open(QIODevice::ReadOnly))
+        return info;
+
+    QDataStream stream(&file);
+    prepareStream(stream);
+    Header header;
+    if(!readHeader(stream, header) || stream.atEnd())
+        return info;
+    info.valid = true;
+    info.documentPath = header.documentPath;
+    return info;
+}
+
+bool EditJournal::start(const QString &journalPath, const QString &documentPath, const QString &dataPath, bool replay,
+                        QString *error, const QVector<const OTUI::Widget*> &documentOrder)
+{
+    if(isActive() && m_journalPath != journalPath)
+        suspend();
+    m_suspended.remove(journalPath);
+    m_journalPath.clear();
+    m_keys.clear();
+    m_nextKey = 0;
+
+    // Widgets of the document are keyed by their position after loading it.
+    if(documentOrder.isEmpty())
+    {
+        for(const auto &widget : m_canvas->getOTUIWidgets())
+            m_keys.insert(widget.get(), m_nextKey++);
+    }
+    else
+    {
+        for(const OTUI::Widget *widget : documentOrder)
+        {
+            const quint32 key = m_nextKey++;
+            if(widget)
+                m_keys.insert(widget, key);
+        }
+    }
+    const quint32 baseCount = m_nextKey;
+
+    bool replayed = false;
+    bool ok = true;
+    if(replay && QFile::exists(journalPath))
+    {
+        replayed = this->replay(journalPath, documentPath, dataPath, baseCount, error);
+        ok = replayed;
+    }
+
+    const QByteArray header = headerBytes(documentHeader(documentPath, baseCount));
+    m_journalPath = journalPath;
+    m_baseCount = baseCount;
+    m_header = header;
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer, journalPath, header, baseCount, replayed]() {
+        writer->start(journalPath, header, baseCount, replayed);
+    }, Qt::QueuedConnection);
+    return ok;
+}
+
+void EditJournal::reset(const QString &journalPath, const QString &documentPath, const QVector<const OTUI::Widget*> &documentOrder)
+{
+    if(journalPath == m_journalPath)
+    {
+        start(journalPath, documentPath, QString(), false, nullptr, documentOrder);
+        return;
+    }
+
+    Session session;
+    for(const OTUI::Widget *widget : documentOrder)
+    {
+        const quint32 key = session.nextKey++;
+        if(widget)
+            session.keys.insert(widget, key);
+    }
+    session.baseCount = session.nextKey;
+    session.header = headerBytes(documentHeader(documentPath, session.baseCount));
+    const QByteArray header = session.header;
+    m_suspended.insert(journalPath, std::move(session));
+
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer, journalPath, header]() {
+        writer->reset(journalPath, header);
+    }, Qt::QueuedConnection);
+}
+
+void EditJournal::suspend()
+{
+    if(!isActive())
+        return;
+    Session session;
+    session.keys = std::exchange(m_keys, {});
+    session.nextKey = m_nextKey;
+    session.baseCount = m_baseCount;
+    session.header = m_header;
+    m_suspended.insert(std::exchange(m_journalPath, QString()), std::move(session));
+
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer]() { writer->stop(false); }, Qt::QueuedConnection);
+}
+
+bool EditJournal::resume(const QString &journalPath)
+{
+    if(isActive() && m_journalPath == journalPath)
+        return true;
+    suspend();
+    if(!m_suspended.contains(journalPath))
+        return false;
+
+    Session session = m_suspended.take(journalPath);
+    m_journalPath = journalPath;
+    m_keys = std::move(session.keys);
+    m_nextKey = session.nextKey;
+    m_baseCount = session.baseCount;
+    m_header = session.header;
+
+    // The writer reads the records back, so compaction still sees all of them.
+    JournalWriter *writer = m_writer;
+    const QByteArray header = m_header;
+    const quint32 baseCount = m_baseCount;
+    QMetaObject::invokeMethod(writer, [writer, journalPath, header, baseCount]() {
+        writer->start(journalPath, header, baseCount, true);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+void EditJournal::discard(const QString &journalPath)
+{
+    if(journalPath == m_journalPath)
+    {
+        m_journalPath.clear();
+        m_keys.clear();
+    }
+    m_suspended.remove(journalPath);
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer, journalPath]() { writer->remove(journalPath); }, Qt::QueuedConnection);
+}
+
+void EditJournal::stop(bool discard)
+{
+    JournalWriter *writer = m_writer;
+    const QStringList suspended = m_suspended.keys();
+    m_suspended.clear();
+    if(discard)
+    {
+        for(const QString &path : suspended)
+            QMetaObject::invokeMethod(writer, [writer, path]() { writer->remove(path); }, Qt::QueuedConnection);
+    }
+
+    if(!isActive())
+        return;
+    m_journalPath.clear();
+    m_keys.clear();
+    QMetaObject::invokeMethod(writer, [writer, discard]() { writer->stop(discard); }, Qt::QueuedConnection);
+}
+
+void EditJournal::recordChanged(const OTUI::Widget *widget)
+{
+    if(!isActive() || m_replaying || !widget || !m_keys.contains(widget))
+        return;
+    recordWidget(widget);
+}
+
+void EditJournal::recordInserted(const QVector<OTUI::Widget*> &widgets)
+{
+    if(!isActive() || m_replaying)
+        return;
+
+    // Parents first, so every record can name an already journaled parent.
+    QVector<OTUI::Widget*> ordered = widgets;
+    std::stable_sort(ordered.begin(), ordered.end(), [](const OTUI::Widget *a, const OTUI::Widget *b) {
+        return depthOf(a) < depthOf(b);
+    });
+    for(const OTUI::Widget *widget : std::as_const(ordered))
+    {
+        if(widget)
+            recordWidget(widget);
+    }
+}
+
+void EditJournal::recordRemoved(OTUI::Widget *widget)
+{
+    if(!isActive() || m_replaying || !widget)
+        return;
+
+    const auto inSubtree = [widget](const OTUI::Widget *candidate) {
+        for(const OTUI::Widget *ancestor = candidate; ancestor; ancestor = ancestor->getParent())
+        {
+            if(ancestor == widget)
+                return true;
+        }
+        return false;
+    };
+
+    // Keys are dropped with the widgets; if an undo brings them back they are
+    // journaled as new widgets.
+    JournalWriter *writer = m_writer;
+    for(const auto &candidate : m_canvas->getOTUIWidgets())
+    {
+        if(!inSubtree(candidate.get()))
+            continue;
+        const auto found = m_keys.constFind(candidate.get());
+        if(found == m_keys.cend())
+            continue;
+        const quint32 key = found.value();
+        m_keys.erase(found);
+
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        prepareStream(stream);
+        stream << static_cast<quint8>(RecordKind::Removed) << key;
+        QMetaObject::invokeMethod(writer, [writer, key, payload]() {
+            writer->append(RecordKind::Removed, key, payload);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void EditJournal::recordWidget(const OTUI::Widget *widget)
+{
+    const auto &store = m_canvas->getOTUIWidgets();
+    const auto position = std::find_if(store.begin(), store.end(), [widget](const auto &candidate) {
+        return candidate.get() == widget;
+    });
+    const quint32 slot = static_cast<quint32>(std::distance(store.begin(), position));
+    const quint32 key = keyFor(widget);
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << static_cast<quint8>(RecordKind::Widget) << key
+           << m_keys.value(widget->getParent(), kNoKey) << slot << OTUI::widgetClassName(widget)
+           << static_cast<quint8>(std::size(kJournalProperties));
+    for(WidgetProperty property : kJournalProperties)
+        stream << static_cast<quint8>(property) << PropertyEditCommand::read(*widget, property);
+
+    JournalWriter *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [writer, key, payload]() {
+        writer->append(RecordKind::Widget, key, payload);
+    }, Qt::QueuedConnection);
+}
+
+bool EditJournal::replay(const QString &journalPath, const QString &documentPath, const QString &dataPath, quint32 baseCount, QString *error)
+{
+    QFile file(journalPath);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+            *error = QStringLiteral("Unable to read the edit journal: %1").arg(file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    prepareStream(stream);
+    Header header;
+    if(!readHeader(stream, header))
+    {
+        if(error)
+            *error = QStringLiteral("The edit journal is damaged.");
+        return false;
+    }
+    // Keys of document widgets are only meaningful for the exact file they were taken from.
+    const Header expected = documentHeader(documentPath, baseCount);
+    if(header.documentPath != expected.documentPath || header.baseCount != expected.baseCount ||
+       header.documentSize != expected.documentSize || header.documentModified != expected.documentModified)
+    {
+        if(error)
+            *error = QStringLiteral("The edit journal was written for a different version of the document.");
+        return false;
+    }
+
+    QHash<quint32, OTUI::Widget*> widgets;
+    const auto &store = m_canvas->getOTUIWidgets();
+    for(std::size_t i = 0; i < store.size(); ++i)
+        widgets.insert(static_cast<quint32>(i), store[i].get());
+
+    m_replaying = true;
+    while(!stream.atEnd())
+    {
+        QByteArray payload;
+        stream >> payload;
+        // A torn last record is what a crash during an append leaves behind.
+        if(stream.status() != QDataStream::Ok)
+            break;
+
+        QDataStream record(payload);
+        prepareStream(record);
+        quint8 kind = 0;
+        quint32 key = kNoKey;
+        record >> kind >> key;
+        m_nextKey = std::max(m_nextKey, key + 1);
+
+        if(static_cast<RecordKind>(kind) == RecordKind::Removed)
+        {
+            OTUI::Widget *widget = widgets.value(key);
+            if(!widget)
+                continue;
+            const OpenGLWidget::DetachedWidgets detached = m_canvas->detachWidget(widget);
+            for(const auto &entry : detached)
+            {
+                const auto found = m_keys.constFind(entry.second.get());
+                if(found == m_keys.cend())
+                    continue;
+                widgets.remove(found.value());
+                m_keys.erase(found);
+            }
+            continue;
+        }
+
+        quint32 parentKey = kNoKey;
+        quint32 slot = 0;
+        QString className;
+        quint8 count = 0;
+        record >> parentKey >> slot >> className >> count;
+
+        OTUI::Widget *widget = widgets.value(key);
+        if(!widget)
+        {
+            OTUI::Widget *parent = parentKey == kNoKey ? nullptr : widgets.value(parentKey);
+            if(parentKey != kNoKey && !parent)
+                continue;
+            std::unique_ptr<OTUI::Widget> created = createWidget(className, dataPath);
+            created->setParent(parent);
+            widget = created.get();
+            OpenGLWidget::DetachedWidgets inserted;
+            inserted.emplace_back(slot, std::move(created));
+            m_canvas->restoreWidgets(std::move(inserted));
+            widgets.insert(key, widget);
+            m_keys.insert(widget, key);
+        }
+
+        for(quint8 i = 0; i < count; ++i)
+        {
+            quint8 property = 0;
+            QVariant value;
+            record >> property >> value;
+            PropertyEditCommand::write(*widget, static_cast<WidgetProperty>(property), value, dataPath);
+        }
+        m_canvas->notifyWidgetGeometryChanged(widget);
+    }
+    m_replaying = false;
+    return true;
+}
+
+quint32 EditJournal::keyFor(const OTUI::Widget *widget)
+{
+    const auto found = m_keys.constFind(widget);
+    if(found != m_keys.cend())
+        return found.value();
+    const quint32 key = m_nextKey++;
+    m_keys.insert(widget, key);
+    return key;
+}
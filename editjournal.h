@@ -0,0 +1,87 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include "otui/otui.h"
+
+class OpenGLWidget;
+class JournalWriter;
+
+// Append-only log of canvas edits made since a document was loaded, so a
+// crashed session can be recovered. Records carry the full state of one
+// widget and are written and compacted on a dedicated thread; the GUI
+// thread only serializes the widget that changed.
+class EditJournal : public QObject
+{
+    Q_OBJECT
+public:
+    struct Info {
+        bool valid = false;
+        QString documentPath;
+    };
+
+    explicit EditJournal(OpenGLWidget *canvas, QObject *parent = nullptr);
+    ~EditJournal() override;
+
+    // Header of a journal left behind by a session that did not stop cleanly.
+    static Info inspect(const QString &journalPath);
+
+    // Journals the canvas as loaded from documentPath, which is empty for a
+    // blank canvas. With replay, the edits of an existing journal for the same
+    // document are applied to the canvas first and kept. documentOrder lists
+    // the widgets in the order loading the document creates them, when that
+    // is no longer the canvas order; null entries stand for nodes whose
+    // widget is gone. A journal of another document that was active is
+    // suspended.
+    bool start(const QString &journalPath, const QString &documentPath, const QString &dataPath, bool replay,
+               QString *error = nullptr, const QVector<const OTUI::Widget*> &documentOrder = {});
+    // Starts over the journal of a document that is not on the canvas, e.g.
+    // after saving it; resume() continues it once the document is shown.
+    void reset(const QString &journalPath, const QString &documentPath, const QVector<const OTUI::Widget*> &documentOrder);
+    // The active journal stops recording but keeps its file and keys while
+    // its document is parked in another tab.
+    void suspend();
+    // Continues a suspended journal; false if there is none for journalPath.
+    bool resume(const QString &journalPath);
+    // Drops one journal and removes its file, e.g. when its document is closed.
+    void discard(const QString &journalPath);
+    // Stops every journal; discard removes their files, e.g. on a clean close.
+    void stop(bool discard);
+    bool isActive() const { return !m_journalPath.isEmpty(); }
+
+    void recordChanged(const OTUI::Widget *widget);
+
+private:
+    // Keys of a journal that is not recording, by its file.
+    struct Session {
+        QHash<const OTUI::Widget*, quint32> keys;
+        quint32 nextKey = 0;
+        quint32 baseCount = 0;
+        QByteArray header;
+    };
+
+    void recordInserted(const QVector<OTUI::Widget*> &widgets);
+    void recordRemoved(OTUI::Widget *widget);
+    void recordWidget(const OTUI::Widget *widget);
+    bool replay(const QString &journalPath, const QString &documentPath, const QString &dataPath, quint32 baseCount, QString *error);
+    quint32 keyFor(const OTUI::Widget *widget);
+
+    OpenGLWidget *m_canvas;
+    QThread m_thread;
+    JournalWriter *m_writer;
+
+    QString m_journalPath;
+    QHash<const OTUI::Widget*, quint32> m_keys;
+    quint32 m_nextKey = 0;
+    quint32 m_baseCount = 0;
+    QByteArray m_header;
+    QHash<QString, Session> m_suspended;
+    bool m_replaying = false;
+};
+
+#endif // EDITJOURNAL_H
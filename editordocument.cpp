@@ -0,0 +1,42 @@
+#include "editordocument.h"
+
+#include <QFileInfo>
+#include <QSet>
+#include "otui/texturemanager.h"
+
+QString EditorDocument::title() const
+{
+    return path.isEmpty() ? QStringLiteral("Untitled") : QFileInfo(path).fileName();
+}
+
+qint64 EditorDocument::imageBytes() const
+{
+    QSet<qint64> counted;
+    qint64 bytes = 0;
+    for(const auto &widget : widgets)
+    {
+        const QPixmap image = widget->image();
+        if(image.isNull() || counted.contains(image.cacheKey()) ||
+           OTUI::TextureManager::instance().holds(widget->imagePath(), image))
+            continue;
+        counted.insert(image.cacheKey());
+        bytes += static_cast<qint64>(image.width()) * image.height() * image.depth() / 8;
+    }
+    return bytes;
+}
+
+void EditorDocument::releaseImages()
+{
+    for(const auto &widget : widgets)
+        widget->releaseImage();
+    imagesReleased = true;
+}
+
+void EditorDocument::restoreImages()
+{
+    if(!imagesReleased)
+        return;
+    for(const auto &widget : widgets)
+        widget->restoreImage();
+    imagesReleased = false;
+}
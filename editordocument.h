@@ -0,0 +1,35 @@
+#ifndef EDITORDOCUMENT_H
+#define EDITORDOCUMENT_H
+
+#include <QPointF>
+#include <QString>
+#include <memory>
+#include "edithistory.h"
+#include "otui/parser.h"
+#include "otui/sourcedocument.h"
+
+// An .otui file open in its own tab. The active document's widgets live in
+// the canvas; the others park theirs here along with their history and view.
+// Style, asset and pixmap caches are process wide and shared by all of them.
+struct EditorDocument
+{
+    QString path;
+    std::shared_ptr<OTUI::SourceDocument> source;
+    std::unique_ptr<EditHistory> history;
+    // Empty while the document is shown in the canvas.
+    OTUI::Parser::WidgetList widgets;
+    QPointF viewOrigin;
+    OTUI::Widget *selected = nullptr;
+    bool modified = false;
+    bool imagesReleased = false;
+    quint64 lastShown = 0;
+
+    QString title() const;
+    // Pixmap bytes only the parked widgets keep alive, each pixmap counted
+    // once; pixmaps still in the shared TextureManager are not theirs to free.
+    qint64 imageBytes() const;
+    void releaseImages();
+    void restoreImages();
+};
+
+#endif // EDITORDOCUMENT_H
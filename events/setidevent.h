@@ -4,6 +4,8 @@
 #include <QEvent>
 #include <QString>
 
+namespace OTUI { class Widget; }
+
 class SetIdEvent : public QEvent
 {
 public:
@@ -13,6 +15,8 @@ public:
 public:
     static const QEvent::Type eventType = static_cast<QEvent::Type>(1020);
 
+    // Identifies the row even when several widgets share an id.
+    OTUI::Widget *widget = nullptr;
     QString oldId;
     QString newId;
 };
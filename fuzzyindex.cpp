@@ -0,0 +1,163 @@
+#include "fuzzyindex.h"
+
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+bool isSeparator(QChar c)
+{
+    return c == QLatin1Char('/') || c == QLatin1Char('_') || c == QLatin1Char('-')
+        || c == QLatin1Char('.') || c == QLatin1Char(' ') || c == QLatin1Char('(');
+}
+}
+
+void FuzzyIndex::clear()
+{
+    m_entries.clear();
+}
+
+void FuzzyIndex::reserve(int size)
+{
+    m_entries.reserve(size);
+}
+
+int FuzzyIndex::add(const QString &text)
+{
+    Entry entry;
+    entry.text = text;
+    entry.folded = text.toCaseFolded();
+    entry.mask = charMask(entry.folded);
+    entry.trigrams = trigramMask(entry.folded);
+    m_entries.append(std::move(entry));
+    return m_entries.size() - 1;
+}
+
+QVector<FuzzyIndex::Match> FuzzyIndex::search(const QString &query, int limit) const
+{
+    QVector<Match> matches;
+    const QStringList terms = query.toCaseFolded().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    if(terms.isEmpty() || limit <= 0)
+        return matches;
+
+    quint64 mask = 0;
+    int termLength = 0;
+    QVector<quint64> termTrigrams;
+    termTrigrams.reserve(terms.size());
+    for(const QString &term : terms)
+    {
+        mask |= charMask(term);
+        termTrigrams.append(trigramMask(term));
+        termLength += term.size();
+    }
+    for(int id = 0; id < m_entries.size(); ++id)
+    {
+        const Entry &entry = m_entries.at(id);
+        if((entry.mask & mask) != mask)
+            continue;
+        int value = 0;
+        for(int i = 0; i < terms.size(); ++i)
+        {
+            const int termValue = score(entry, terms.at(i), termTrigrams.at(i));
+            if(termValue < 0)
+            {
+                value = -1;
+                break;
+            }
+            value += termValue;
+        }
+        if(value >= 0)
+            matches.append({id, value - (entry.folded.size() - termLength) / 8});
+    }
+
+    const auto better = [this](const Match &a, const Match &b) {
+        if(a.score != b.score)
+            return a.score > b.score;
+        const int lengthA = m_entries.at(a.id).text.size();
+        const int lengthB = m_entries.at(b.id).text.size();
+        if(lengthA != lengthB)
+            return lengthA < lengthB;
+        return a.id < b.id;
+    };
+    if(matches.size() > limit)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), better);
+        matches.resize(limit);
+    }
+    else
+    {
+        std::sort(matches.begin(), matches.end(), better);
+    }
+    return matches;
+}
+
+quint64 FuzzyIndex::charMask(const QString &folded)
+{
+    quint64 mask = 0;
+    for(const QChar c : folded)
+    {
+        // Separators are not worth a bit; score() still checks those a term contains.
+        if(isSeparator(c))
+            continue;
+        const ushort u = c.unicode();
+        if(u >= 'a' && u <= 'z')
+            mask |= quint64(1) << (u - 'a');
+        else if(u >= '0' && u <= '9')
+            mask |= quint64(1) << (26 + u - '0');
+        else
+            mask |= quint64(1) << (36 + u % 28);
+    }
+    return mask;
+}
+
+quint64 FuzzyIndex::trigramMask(const QString &folded)
+{
+    quint64 mask = 0;
+    for(int i = 2; i < folded.size(); ++i)
+    {
+        const quint32 hash = folded.at(i - 2).unicode() * 0x9E3779B1u
+                           ^ folded.at(i - 1).unicode() * 0x85EBCA77u
+                           ^ folded.at(i).unicode() * 0xC2B2AE3Du;
+        mask |= quint64(1) << (hash >> 26);
+    }
+    return mask;
+}
+
+int FuzzyIndex::score(const Entry &entry, const QString &term, quint64 termTrigrams)
+{
+    const QString &text = entry.folded;
+    const int length = text.size();
+    // Case boundaries are read from the original, where folding kept the length.
+    const bool camelCase = entry.text.size() == length;
+
+    // Greedy left to right: every query character must appear in order.
+    int value = 0;
+    int previous = -2;
+    int position = 0;
+    for(const QChar c : term)
+    {
+        while(position < length && text.at(position) != c)
+            ++position;
+        if(position == length)
+            return -1;
+
+        value += 1;
+        if(position == previous + 1)
+            value += 5;
+        if(position == 0 || isSeparator(text.at(position - 1))
+           || (camelCase && entry.text.at(position).isUpper() && entry.text.at(position - 1).isLower()))
+            value += 8;
+        previous = position++;
+    }
+
+    // Whole term as one run, better still at the start of the last path part.
+    // Every trigram of such a run is in the entry's mask, so most misses end here.
+    const int substring = (entry.trigrams & termTrigrams) == termTrigrams ? text.lastIndexOf(term) : -1;
+    if(substring >= 0)
+    {
+        value += 20;
+        const int nameStart = text.lastIndexOf(QLatin1Char('/')) + 1;
+        if(substring == nameStart)
+            value += 10;
+    }
+    return value;
+}
@@ -0,0 +1,60 @@
+#ifndef FUZZYINDEX_H
+#define FUZZYINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <algorithm>
+
+// In-memory list of names matched by fuzzy subsequence, e.g. "btnhov" finds
+// "images/ui/button_hover". Space separated terms match on their own, so
+// "btn hov" finds it too. Each entry keeps a folded copy and a bit mask of
+// the characters it contains, so most entries are rejected with one AND
+// before they are scored, and a second mask of its hashed trigrams, which
+// skips the whole-term lookup for entries that cannot contain the term.
+class FuzzyIndex
+{
+public:
+    struct Match {
+        int id = -1;
+        int score = 0;
+    };
+
+    void clear();
+    void reserve(int size);
+    // Returns the entry's id, its position in insertion order.
+    int add(const QString &text);
+    // Drops the entries whose text the predicate accepts; later ids move down.
+    template<typename Predicate>
+    int removeIf(Predicate predicate)
+    {
+        const auto end = std::remove_if(m_entries.begin(), m_entries.end(), [&predicate](const Entry &entry) {
+            return predicate(entry.text);
+        });
+        const int removed = int(m_entries.end() - end);
+        m_entries.erase(end, m_entries.end());
+        return removed;
+    }
+    int size() const { return m_entries.size(); }
+    const QString &text(int id) const { return m_entries.at(id).text; }
+
+    // Best matches first; an empty query matches nothing.
+    QVector<Match> search(const QString &query, int limit) const;
+
+private:
+    struct Entry {
+        QString text;
+        QString folded;
+        quint64 mask = 0;
+        quint64 trigrams = 0;
+    };
+
+    static quint64 charMask(const QString &folded);
+    // Zero for text shorter than three characters, which then passes any entry.
+    static quint64 trigramMask(const QString &folded);
+    // Without the length penalty, which applies once per entry.
+    static int score(const Entry &entry, const QString &term, quint64 termTrigrams);
+
+    QVector<Entry> m_entries;
+};
+
+#endif // FUZZYINDEX_H
@@ -0,0 +1,118 @@
+#include "imagegridmodel.h"
+#include "thumbnailcache.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QPainter>
+
+namespace {
+constexpr int kCellMargin = 5;
+constexpr int kCellSpacing = 4;
+}
+
+ImageGridModel::ImageGridModel(ThumbnailCache *thumbnails, QObject *parent)
+    : QAbstractListModel(parent), m_thumbnails(thumbnails)
+{
+    connect(m_thumbnails, &ThumbnailCache::thumbnailReady, this, &ImageGridModel::handleThumbnailReady);
+}
+
+void ImageGridModel::setDirectory(const QString &directory)
+{
+    QStringList paths;
+    QStringList names;
+    if(!directory.isEmpty())
+    {
+        names = QDir(directory).entryList(QStringList() << "*.png", QDir::Files, QDir::Name | QDir::IgnoreCase);
+        paths.reserve(names.size());
+        for(const QString &name : std::as_const(names))
+            paths << directory + QLatin1Char('/') + name;
+    }
+    setImages(paths, names);
+}
+
+void ImageGridModel::setImages(const QStringList &paths, const QStringList &names)
+{
+    beginResetModel();
+    // Thumbnails still queued for the old images would only delay the new ones.
+    m_thumbnails->cancelPending();
+    m_paths = paths;
+    m_names = names;
+    m_rows.clear();
+    m_rows.reserve(m_paths.size());
+    for(int row = 0; row < m_paths.size(); ++row)
+        m_rows.insert(m_paths.at(row), row);
+    endResetModel();
+}
+
+int ImageGridModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_names.size();
+}
+
+QVariant ImageGridModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= m_names.size())
+        return QVariant();
+
+    switch(role)
+    {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return m_names.at(index.row());
+    case Qt::DecorationRole:
+        return m_thumbnails->thumbnail(m_paths.at(index.row()));
+    case PathRole:
+        return m_paths.at(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+void ImageGridModel::handleThumbnailReady(const QString &path, const QImage &image)
+{
+    // Nothing new to show; a repaint would only ask for the thumbnail again.
+    if(image.isNull())
+        return;
+    const auto it = m_rows.constFind(path);
+    if(it == m_rows.cend())
+        return;
+    const QModelIndex changed = index(it.value());
+    emit dataChanged(changed, changed, {Qt::DecorationRole});
+}
+
+ImageGridDelegate::ImageGridDelegate(int thumbnailSize, QObject *parent)
+    : QStyledItemDelegate(parent), m_thumbnailSize(thumbnailSize)
+{
+}
+
+void ImageGridDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // Only the selection and hover panel; initStyleOption would turn the
+    // thumbnail into an icon on every paint.
+    const QWidget *widget = option.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, widget);
+
+    const QRect cell = option.rect.adjusted(kCellMargin, kCellMargin, -kCellMargin, -kCellMargin);
+    const QRect imageRect(cell.left() + (cell.width() - m_thumbnailSize) / 2, cell.top(), m_thumbnailSize, m_thumbnailSize);
+    const QImage thumbnail = index.data(Qt::DecorationRole).value<QImage>();
+    if(!thumbnail.isNull())
+    {
+        QRect target(QPoint(0, 0), thumbnail.size());
+        target.moveCenter(imageRect.center());
+        painter->drawImage(target, thumbnail);
+    }
+
+    const QRect textRect(cell.left(), imageRect.bottom() + 1 + kCellSpacing, cell.width(), option.fontMetrics.height());
+    const QString title = option.fontMetrics.elidedText(index.data(Qt::DisplayRole).toString(), Qt::ElideMiddle, textRect.width());
+    painter->save();
+    painter->setPen(option.palette.color(option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text));
+    painter->drawText(textRect, Qt::AlignCenter, title);
+    painter->restore();
+}
+
+QSize ImageGridDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &) const
+{
+    return QSize(m_thumbnailSize + 4 * kCellMargin,
+                 m_thumbnailSize + kCellSpacing + option.fontMetrics.height() + 2 * kCellMargin);
+}
@@ -0,0 +1,54 @@
+#ifndef IMAGEGRIDMODEL_H
+#define IMAGEGRIDMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QStringList>
+#include <QStyledItemDelegate>
+
+class ThumbnailCache;
+
+// Images of one folder for the image browser grid. Only names are listed
+// up front; a thumbnail is requested when the view first asks for a row's
+// decoration, i.e. when it scrolls into view.
+class ImageGridModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Role {
+        PathRole = Qt::UserRole
+    };
+
+    explicit ImageGridModel(ThumbnailCache *thumbnails, QObject *parent = nullptr);
+
+    // Lists the images directly in directory; an empty path clears the grid.
+    void setDirectory(const QString &directory);
+    // Lists the given images, e.g. search results, under their names.
+    void setImages(const QStringList &paths, const QStringList &names);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    void handleThumbnailReady(const QString &path, const QImage &image);
+    ThumbnailCache *m_thumbnails;
+    QStringList m_paths;
+    QStringList m_names;
+    QHash<QString, int> m_rows;
+};
+
+// Paints a grid cell: the thumbnail centered above the elided file name.
+class ImageGridDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit ImageGridDelegate(int thumbnailSize, QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    int m_thumbnailSize;
+};
+
+#endif // IMAGEGRIDMODEL_H
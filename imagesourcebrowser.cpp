@@ -1,12 +1,90 @@
 #include "imagesourcebrowser.h"
+#include "thumbnailcache.h"
+#include "imagegridmodel.h"
 
-#include <QPixmapCache>
 #include <QHeaderView>
 #include <QDir>
-#include <QTableWidgetItem>
+#include <QFileInfo>
+#include <QFileSystemModel>
+#include <QSortFilterProxyModel>
+#include <QDirIterator>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// "ui/button.png" is in "ui", "button.png" in "", the data folder.
+QString parentDirectory(const QString &relative)
+{
+    const int slash = relative.lastIndexOf(QLatin1Char('/'));
+    return slash < 0 ? QString() : relative.left(slash);
+}
+
+// Keeps the data folder as the only top level row, shown as "data", above
+// the folder it lives in.
+class DataFolderFilter : public QSortFilterProxyModel
+{
+public:
+    using QSortFilterProxyModel::QSortFilterProxyModel;
+
+    void setDataPath(const QString &dataPath)
+    {
+        m_dataPath = QDir::cleanPath(QDir::fromNativeSeparators(dataPath));
+        m_parentPath = QFileInfo(m_dataPath).absolutePath();
+        invalidateFilter();
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if(role == Qt::DisplayRole && filePath(index) == m_dataPath)
+            return QStringLiteral("data");
+        return QSortFilterProxyModel::data(index, role);
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        auto *model = static_cast<QFileSystemModel*>(sourceModel());
+        if(model->filePath(sourceParent) != m_parentPath)
+            return true;
+        return model->filePath(model->index(sourceRow, 0, sourceParent)) == m_dataPath;
+    }
+
+private:
+    QString filePath(const QModelIndex &index) const
+    {
+        return static_cast<QFileSystemModel*>(sourceModel())->filePath(mapToSource(index));
+    }
+
+    QString m_dataPath;
+    QString m_parentPath;
+};
+}
 
-ImageSourceBrowser::ImageSourceBrowser(QWidget *parent) : QFrame(parent)
+ImageSourceBrowser::ImageSourceBrowser(QWidget *parent)
+    : QFrame(parent),
+      m_directoryModel(new QFileSystemModel(this)),
+      m_directoryFilter(new DataFolderFilter(this)),
+      m_thumbnails(new ThumbnailCache(128, this)),
+      m_imagesModel(new ImageGridModel(m_thumbnails, this)),
+      m_searchIndexTimer(new QTimer(this))
 {
+    // The model watches the folders it has read and only rereads those that
+    // change; the search index follows the same folders.
+    m_directoryModel->setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+    m_directoryFilter->setSourceModel(m_directoryModel);
+    connect(m_directoryModel, &QFileSystemModel::directoryLoaded, this, &ImageSourceBrowser::handleImageDirectoryChanged);
+
+    m_searchIndexTimer->setSingleShot(true);
+    m_searchIndexTimer->setInterval(500);
+    connect(m_searchIndexTimer, &QTimer::timeout, this, [this]() {
+        updateSearchIndex();
+        if(std::exchange(m_currentDirectoryChanged, false) && m_searchEdit->text().trimmed().isEmpty())
+            m_imagesModel->setDirectory(m_currentDirectory);
+    });
 }
 
 ImageSourceBrowser::~ImageSourceBrowser()
@@ -61,53 +139,48 @@ void ImageSourceBrowser::initialize()
 
     // Left
 
-    directoryList = new QTreeWidget(contentPanel);
+    directoryList = new QTreeView(contentPanel);
     directoryList->setObjectName("leftBrowserPanel");
     directoryList->setMaximumWidth(180);
     directoryList->setHeaderHidden(true);
     directoryList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    directoryList->setModel(m_directoryFilter);
+    for(int column = 1; column < m_directoryModel->columnCount(); ++column)
+        directoryList->hideColumn(column);
 
-    connect(directoryList, &QTreeWidget::itemClicked, this, &ImageSourceBrowser::onItemClicked);
-    connect(directoryList, &QTreeWidget::itemActivated, this, &ImageSourceBrowser::onItemClicked);
+    connect(directoryList, &QTreeView::clicked, this, &ImageSourceBrowser::onItemClicked);
+    connect(directoryList, &QTreeView::activated, this, &ImageSourceBrowser::onItemClicked);
 
     QGridLayout *directoryListLayout = new QGridLayout(directoryList);
     directoryListLayout->setContentsMargins(0, 0, 2, 0);
     directoryListLayout->setSpacing(0);
 
-    QTreeWidgetItem *topLevelItem = new QTreeWidgetItem(directoryList);
-    directoryList->addTopLevelItem(topLevelItem);
-    topLevelItem->setText(0, "data");
-
-    QDirIterator it(m_DataPath, QDir::NoDotAndDotDot | QDir::Dirs);
-    while (it.hasNext()) {
-        QString n = it.next();
-        QTreeWidgetItem *item = new QTreeWidgetItem(topLevelItem);
-        item->setText(0, n.right(n.length() - n.lastIndexOf("/") - 1));
-        recursivelyGetDirectory(n, item);
-    }
-
-    topLevelItem->setExpanded(true);
+    resetDirectoryTree();
 
     // Right
-    imagesGrid = new QTableWidget(contentPanel);
-    imagesGrid->setShowGrid(false);
+    m_searchEdit = new QLineEdit(contentPanel);
+    m_searchEdit->setObjectName("imagesBrowserSearch");
+    m_searchEdit->setPlaceholderText("Search images...");
+    m_searchEdit->setClearButtonEnabled(true);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &ImageSourceBrowser::updateSearchResults);
+
+    // Only the cells in view are laid out and painted, and only they ask for thumbnails.
+    imagesGrid = new QListView(contentPanel);
     imagesGrid->setObjectName("imagesBrowserGrid");
-
-    imagesGrid->horizontalHeader()->setDefaultSectionSize(148);
-    imagesGrid->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
-    imagesGrid->horizontalHeader()->hide();
-
-    imagesGrid->verticalHeader()->setDefaultSectionSize(158);
-    imagesGrid->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
-    imagesGrid->verticalHeader()->hide();
-
-    connect(imagesGrid, &QTableWidget::cellDoubleClicked, this, [this](int row, int column) {
-        if(!imagesGrid || m_DataPath.isEmpty())
-            return;
-        QTableWidgetItem *item = imagesGrid->item(row, column);
-        if(!item)
+    imagesGrid->setViewMode(QListView::IconMode);
+    imagesGrid->setMovement(QListView::Static);
+    imagesGrid->setResizeMode(QListView::Adjust);
+    imagesGrid->setUniformItemSizes(true);
+    imagesGrid->setLayoutMode(QListView::Batched);
+    imagesGrid->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    imagesGrid->setSelectionMode(QAbstractItemView::SingleSelection);
+    imagesGrid->setItemDelegate(new ImageGridDelegate(m_thumbnails->size(), imagesGrid));
+    imagesGrid->setModel(m_imagesModel);
+
+    connect(imagesGrid, &QListView::doubleClicked, this, [this](const QModelIndex &index) {
+        if(m_DataPath.isEmpty())
             return;
-        const QString absolutePath = item->data(Qt::UserRole).toString();
+        const QString absolutePath = index.data(ImageGridModel::PathRole).toString();
         if(absolutePath.isEmpty())
             return;
         QString normalizedRoot = QDir::fromNativeSeparators(m_DataPath);
@@ -124,124 +197,258 @@ void ImageSourceBrowser::initialize()
         emit imageActivated(relative);
     });
 
-    contentLayout->addWidget(directoryList, 0, 0);
-    contentLayout->addWidget(imagesGrid, 0, 1);
+    contentLayout->addWidget(directoryList, 0, 0, 2, 1);
+    contentLayout->addWidget(m_searchEdit, 0, 1);
+    contentLayout->addWidget(imagesGrid, 1, 1);
 
     layout->addWidget(contentPanel);
 }
 
 void ImageSourceBrowser::refresh()
 {
-    delete directoryList->takeTopLevelItem(0);
-
-    QTreeWidgetItem *topLevelItem = new QTreeWidgetItem(directoryList);
-    directoryList->addTopLevelItem(topLevelItem);
-    topLevelItem->setText(0, "data");
-
-    QDirIterator it(m_DataPath, QDir::NoDotAndDotDot | QDir::Dirs);
-    while (it.hasNext()) {
-        QString n = it.next();
-        QTreeWidgetItem *item = new QTreeWidgetItem(topLevelItem);
-        item->setText(0, n.right(n.length() - n.lastIndexOf("/") - 1));
-        recursivelyGetDirectory(n, item);
+    resetDirectoryTree();
+}
+
+void ImageSourceBrowser::resetDirectoryTree()
+{
+    m_currentDirectory.clear();
+    m_imagesModel->setDirectory(QString());
+    rebuildSearchIndex();
+    if(m_DataPath.isEmpty())
+        return;
+
+    const QString parentPath = QFileInfo(m_DataPath).absolutePath();
+    static_cast<DataFolderFilter*>(m_directoryFilter)->setDataPath(m_DataPath);
+    m_directoryModel->setRootPath(parentPath);
+    directoryList->setRootIndex(m_directoryFilter->mapFromSource(m_directoryModel->index(parentPath)));
+    directoryList->expand(m_directoryFilter->mapFromSource(m_directoryModel->index(m_DataPath)));
+}
+
+void ImageSourceBrowser::rebuildSearchIndex()
+{
+    m_searchIndexTimer->stop();
+    m_changedImageDirectories.clear();
+    const QString dataPath = QDir::cleanPath(QDir::fromNativeSeparators(m_DataPath));
+    if(dataPath.isEmpty())
+    {
+        m_searchIndexWatcher = nullptr;
+        m_searchIndex.reset();
+        m_searchIndexDirectories.clear();
+        return;
     }
 
-    topLevelItem->setExpanded(true);
+    watchSearchIndexBuild(QtConcurrent::run([dataPath]() {
+        SearchIndexBuild build;
+        auto index = std::make_shared<FuzzyIndex>();
+        build.directories.insert(QString());
+        QDirIterator it(dataPath, QStringList() << "*.png", QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+        while(it.hasNext())
+        {
+            const QString relative = it.next().mid(dataPath.length() + 1);
+            if(it.fileInfo().isDir())
+                build.directories.insert(relative);
+            else
+                index->add(relative);
+        }
+        build.index = std::move(index);
+        return build;
+    }));
+}
+
+void ImageSourceBrowser::updateSearchIndex()
+{
+    // A running build picks the folders up when it is done.
+    if(m_searchIndexWatcher || !m_searchIndex || m_changedImageDirectories.isEmpty())
+        return;
+
+    const QString dataPath = QDir::cleanPath(QDir::fromNativeSeparators(m_DataPath));
+    const QStringList changed = m_changedImageDirectories.values();
+    m_changedImageDirectories.clear();
+    watchSearchIndexBuild(QtConcurrent::run([dataPath, index = m_searchIndex, directories = m_searchIndexDirectories, changed]() {
+        return rescanImageDirectories(dataPath, *index, directories, changed);
+    }));
 }
 
-void ImageSourceBrowser::handleCloseButton()
+void ImageSourceBrowser::watchSearchIndexBuild(const QFuture<SearchIndexBuild> &future)
 {
-    this->hide();
+    // A build for an older data path still finishes, but is not swapped in.
+    auto *watcher = new QFutureWatcher<SearchIndexBuild>(this);
+    m_searchIndexWatcher = watcher;
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        if(m_searchIndexWatcher != watcher)
+            return;
+        m_searchIndexWatcher = nullptr;
+        SearchIndexBuild build = watcher->result();
+        if(build.index)
+        {
+            m_searchIndex = std::move(build.index);
+            m_searchIndexDirectories = std::move(build.directories);
+            if(!m_searchEdit->text().trimmed().isEmpty())
+                updateSearchResults();
+        }
+        if(!m_changedImageDirectories.isEmpty())
+            m_searchIndexTimer->start();
+    });
+    watcher->setFuture(future);
 }
 
-void ImageSourceBrowser::onItemClicked(QTreeWidgetItem *item, int)
+ImageSourceBrowser::SearchIndexBuild ImageSourceBrowser::rescanImageDirectories(const QString &dataPath, const FuzzyIndex &index,
+                                                                                 QSet<QString> directories, QStringList changed)
 {
-    //qDeleteAll(imagesGrid->findChildren<QTableWidgetItem *>(QString(), Qt::FindDirectChildrenOnly));
-    imagesGrid->clearContents();
-    m_lastCol = 0;
-    m_lastRow = 0;
+    // Parents first, so a folder inside one that is read again below is skipped.
+    std::sort(changed.begin(), changed.end());
+    const QSet<QString> changedSet(changed.cbegin(), changed.cend());
+    QHash<QString, QSet<QString>> indexedFiles;
+    for(int id = 0; id < index.size(); ++id)
+    {
+        const QString &relative = index.text(id);
+        const QString parent = parentDirectory(relative);
+        if(changedSet.contains(parent))
+            indexedFiles[parent].insert(relative);
+    }
 
-    QString path(m_DataPath + "/");
-    if (item->text(0) != "data")
+    QSet<QString> rewritten;
+    QStringList droppedTrees;
+    QStringList scannedTrees;
+    QStringList added;
+    const auto within = [](const QString &relative, const QStringList &trees) {
+        return std::any_of(trees.cbegin(), trees.cend(), [&relative](const QString &tree) {
+            return relative == tree || relative.startsWith(tree + QLatin1Char('/'));
+        });
+    };
+    for(const QString &relative : std::as_const(changed))
     {
-        QTreeWidgetItem *parent = item->parent();
-        QStringList parentList;
-        while(parent && parent->text(0) != "data")
+        if(within(relative, droppedTrees) || within(relative, scannedTrees))
+            continue;
+
+        const QString prefix = relative.isEmpty() ? QString() : relative + QLatin1Char('/');
+        const QDir dir(dataPath + QLatin1Char('/') + relative);
+        QSet<QString> files;
+        for(const QString &name : dir.entryList(QStringList() << "*.png", QDir::Files))
+            files.insert(prefix + name);
+        QSet<QString> subdirectories;
+        for(const QString &name : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+            subdirectories.insert(prefix + name);
+        QSet<QString> indexedSubdirectories;
+        for(const QString &directory : std::as_const(directories))
+        {
+            if(directory != relative && parentDirectory(directory) == relative)
+                indexedSubdirectories.insert(directory);
+        }
+        if(files == indexedFiles.value(relative) && subdirectories == indexedSubdirectories)
+            continue;
+
+        rewritten.insert(relative);
+        for(const QString &name : std::as_const(files))
+            added << name;
+        for(const QString &gone : std::as_const(indexedSubdirectories))
+        {
+            if(subdirectories.contains(gone))
+                continue;
+            droppedTrees << gone;
+            directories.removeIf([&gone](const QString &directory) {
+                return directory == gone || directory.startsWith(gone + QLatin1Char('/'));
+            });
+        }
+        for(const QString &fresh : std::as_const(subdirectories))
         {
-            parentList.push_front(parent->text(0));
-            parent = parent->parent();
+            if(indexedSubdirectories.contains(fresh))
+                continue;
+            scannedTrees << fresh;
+            directories.insert(fresh);
+            QDirIterator it(dataPath + QLatin1Char('/') + fresh, QStringList() << "*.png",
+                            QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while(it.hasNext())
+            {
+                const QString path = it.next().mid(dataPath.length() + 1);
+                if(it.fileInfo().isDir())
+                    directories.insert(path);
+                else
+                    added << path;
+            }
         }
-        path += parentList.join("/") + "/" + item->text(0);
+        if(dir.exists())
+            directories.insert(relative);
+        else if(!relative.isEmpty())
+            directories.remove(relative);
     }
+    if(rewritten.isEmpty())
+        return SearchIndexBuild();
 
-    QDirIterator it(path, QStringList() << "*.png", QDir::NoDotAndDotDot | QDir::Files);
+    auto updated = std::make_shared<FuzzyIndex>(index);
+    updated->removeIf([&](const QString &relative) {
+        return rewritten.contains(parentDirectory(relative)) || within(relative, droppedTrees);
+    });
+    for(const QString &relative : std::as_const(added))
+        updated->add(relative);
 
-    imagesGrid->setColumnCount(4);
-    imagesGrid->setRowCount(255);
-    int items = 0;
-    while (it.hasNext()) {
-        QString n = it.next();
-        addImageToGrid(n.right(n.length() - n.lastIndexOf("/") - 1), n);
-        items++;
-    }
-    const int columnCount = qMin(4, qMax(1, items));
-    imagesGrid->setColumnCount(columnCount);
-    const int rowCount = items == 0 ? 1 : ((items + columnCount - 1) / columnCount);
-    imagesGrid->setRowCount(rowCount);
+    SearchIndexBuild build;
+    build.index = std::move(updated);
+    build.directories = std::move(directories);
+    return build;
 }
 
-void ImageSourceBrowser::addImageToGrid(QString title, QString path)
+void ImageSourceBrowser::handleImageDirectoryChanged(const QString &path)
 {
-    QWidget *item = new QWidget;
-    item->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
-    QVBoxLayout *itemLayout = new QVBoxLayout(item);
-    itemLayout->setContentsMargins(5, 5, 5, 5);
-    itemLayout->setSpacing(4);
-
-    QLabel *imageWidget = new QLabel;
-    imageWidget->setMinimumSize(128, 128);
-    imageWidget->setAlignment(Qt::AlignCenter);
-    QPixmap pic;
-    if (!QPixmapCache::find(path, &pic)) {
-        pic.load(path);
-        QPixmapCache::insert(path, pic);
-    }
-    if (pic.width() >= pic.height() && pic.width() > 128)
-        imageWidget->setPixmap(pic.scaledToWidth(128));
-    else if(pic.height() >= pic.width() && pic.height() > 128)
-        imageWidget->setPixmap(pic.scaledToHeight(128));
-    else
-        imageWidget->setPixmap(pic);
-
-    QLabel *imageTitle = new QLabel(title);
-    imageTitle->setAlignment(Qt::AlignCenter);
-
-    itemLayout->addWidget(imageWidget);
-    itemLayout->addWidget(imageTitle);
+    const QString dataPath = QDir::cleanPath(QDir::fromNativeSeparators(m_DataPath));
+    const QString directory = QDir::cleanPath(QDir::fromNativeSeparators(path));
+    if(dataPath.isEmpty() || (directory != dataPath && !directory.startsWith(dataPath + QLatin1Char('/'))))
+        return;
+
+    if(directory == m_currentDirectory)
+        m_currentDirectoryChanged = true;
+    m_changedImageDirectories.insert(directory.mid(dataPath.length() + 1));
+    m_searchIndexTimer->start();
+}
 
-    const int targetRow = m_lastRow;
-    const int targetColumn = m_lastCol;
-    imagesGrid->setCellWidget(targetRow, targetColumn, item);
-    auto *tableItem = new QTableWidgetItem;
-    tableItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
-    tableItem->setData(Qt::UserRole, path);
-    imagesGrid->setItem(targetRow, targetColumn, tableItem);
+void ImageSourceBrowser::updateSearchResults()
+{
+    const QString query = m_searchEdit->text();
+    if(query.trimmed().isEmpty() || !m_searchIndex)
+    {
+        titleLabel->setText("Image Source Browser");
+        m_imagesModel->setDirectory(m_currentDirectory);
+        return;
+    }
 
-    m_lastCol++;
-    if(m_lastCol >= 4)
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<FuzzyIndex::Match> matches = m_searchIndex->search(query, 1000);
+    titleLabel->setText(QStringLiteral("Image Source Browser - %1 of %2 images in %3 ms")
+                            .arg(matches.size()).arg(m_searchIndex->size())
+                            .arg(timer.nsecsElapsed() / 1000000.0, 0, 'f', 1));
+
+    const QString dataPath = QDir::cleanPath(QDir::fromNativeSeparators(m_DataPath));
+    QStringList paths;
+    QStringList names;
+    for(const FuzzyIndex::Match &match : matches)
     {
-        m_lastRow++;
-        m_lastCol = 0;
+        const QString &relative = m_searchIndex->text(match.id);
+        paths << dataPath + QLatin1Char('/') + relative;
+        names << relative;
     }
+    m_imagesModel->setImages(paths, names);
+    imagesGrid->scrollToTop();
 }
 
-void ImageSourceBrowser::recursivelyGetDirectory(QString path, QTreeWidgetItem *parent)
+void ImageSourceBrowser::handleCloseButton()
 {
-    QDirIterator it(path, QDir::NoDotAndDotDot | QDir::Dirs);
-    while (it.hasNext()) {
-        QString n = it.next();
-        QTreeWidgetItem *item = new QTreeWidgetItem(parent);
-        item->setText(0, n.right(n.length() - n.lastIndexOf("/") - 1));
-        recursivelyGetDirectory(n, item);
-    }
+    this->hide();
+}
+
+void ImageSourceBrowser::onItemClicked(const QModelIndex &index)
+{
+    const QString path = m_directoryModel->filePath(m_directoryFilter->mapToSource(index));
+    if(path.isEmpty())
+        return;
+
+    m_currentDirectory = QDir::cleanPath(path);
+    // Picking a folder ends the search and shows the folder.
+    if(m_searchEdit->text().isEmpty())
+        m_imagesModel->setDirectory(m_currentDirectory);
+    else
+        m_searchEdit->clear();
+    imagesGrid->scrollToTop();
 }
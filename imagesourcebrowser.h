@@ -5,10 +5,22 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QGridLayout>
-#include <QTreeWidget>
-#include <QDirIterator>
+#include <QTreeView>
 #include <QPixmap>
-#include <QTableWidget>
+#include <QListView>
+#include <QLineEdit>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QSet>
+#include <memory>
+
+#include "fuzzyindex.h"
+
+class ThumbnailCache;
+class ImageGridModel;
+class QFileSystemModel;
+class QSortFilterProxyModel;
+class QTimer;
 
 class ImageSourceBrowser : public QFrame
 {
@@ -22,7 +34,7 @@ signals:
 
 private slots:
     void handleCloseButton();
-    void onItemClicked(QTreeWidgetItem *item, int column);
+    void onItemClicked(const QModelIndex &index);
 
 public:
     void initialize();
@@ -31,18 +43,47 @@ public:
     QString m_DataPath;
 
 private:
-    void recursivelyGetDirectory(QString path, QTreeWidgetItem *parent);
-    void addImageToGrid(QString title, QString path);
+    // Points the directory tree at m_DataPath; folders are read as they are expanded.
+    void resetDirectoryTree();
+    struct SearchIndexBuild {
+        std::shared_ptr<const FuzzyIndex> index;
+        // Relative to the data folder, which is "".
+        QSet<QString> directories;
+    };
+
+    // Indexes the relative path of every image under m_DataPath on a worker.
+    void rebuildSearchIndex();
+    // Rereads the folders the directory tree saw change, on a worker, and swaps
+    // their entries in a copy of the index.
+    void updateSearchIndex();
+    void watchSearchIndexBuild(const QFuture<SearchIndexBuild> &future);
+    // No index when the folders still hold what the index has for them.
+    static SearchIndexBuild rescanImageDirectories(const QString &dataPath, const FuzzyIndex &index,
+                                                   QSet<QString> directories, QStringList changed);
+    // Called for each folder the tree model reads, again whenever one it watches changes.
+    void handleImageDirectoryChanged(const QString &path);
+    // Shows the images matching the search box, or the selected folder when it is empty.
+    void updateSearchResults();
 
     QFrame *topBar;
     QLabel *titleLabel;
     QPushButton *closeButton;
     QWidget *contentPanel;
-    QTreeWidget *directoryList;
-    QTableWidget *imagesGrid;
-
-    int m_lastCol = 0;
-    int m_lastRow = 0;
+    QTreeView *directoryList;
+    QFileSystemModel *m_directoryModel;
+    QSortFilterProxyModel *m_directoryFilter;
+    QLineEdit *m_searchEdit;
+    QListView *imagesGrid;
+    ThumbnailCache *m_thumbnails;
+    ImageGridModel *m_imagesModel;
+    QString m_currentDirectory;
+    std::shared_ptr<const FuzzyIndex> m_searchIndex;
+    QSet<QString> m_searchIndexDirectories;
+    QSet<QString> m_changedImageDirectories;
+    QFutureWatcher<SearchIndexBuild> *m_searchIndexWatcher = nullptr;
+    // Collects a burst of changes, e.g. a folder being copied in, into one update.
+    QTimer *m_searchIndexTimer;
+    bool m_currentDirectoryChanged = false;
 };
 
 #endif // IMAGESOURCEBROWSER_H
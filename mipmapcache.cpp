@@ -0,0 +1,105 @@
+#include "mipmapcache.h"
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+// Budget in KiB for all chains; a full chain adds about a third of the original.
+const int kCacheBudgetKb = 64 * 1024;
+const int kMaxLevels = 8;
+
+QVector<QImage> buildLevels(const QImage &source)
+{
+    QVector<QImage> levels;
+    QImage current = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    while(levels.size() < kMaxLevels && (current.width() > 1 || current.height() > 1))
+    {
+        // Exact halving makes the bilinear filter a 2x2 box average.
+        current = current.scaled(std::max(1, current.width() / 2), std::max(1, current.height() / 2),
+                                 Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        levels.append(current);
+    }
+    return levels;
+}
+}
+
+MipmapCache::MipmapCache(QObject *parent)
+    : QObject(parent),
+      m_chains(kCacheBudgetKb)
+{
+}
+
+QPixmap MipmapCache::level(const QPixmap &pixmap, double scale, bool exactTiling)
+{
+    if(pixmap.isNull() || scale <= 0.0 || scale > 0.5)
+        return QPixmap();
+
+    const qint64 key = pixmap.cacheKey();
+    const Chain *chain = m_chains.object(key);
+    if(!chain)
+    {
+        ++m_misses;
+        requestChain(pixmap);
+        return QPixmap();
+    }
+
+    // Largest level that is still at least as detailed as the screen needs.
+    int wanted = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+    wanted = std::min(wanted, static_cast<int>(chain->levels.size()));
+    if(exactTiling)
+    {
+        while(wanted > 0 && ((chain->baseSize.width() % (1 << wanted)) != 0 || (chain->baseSize.height() % (1 << wanted)) != 0))
+            --wanted;
+    }
+    if(wanted <= 0)
+        return QPixmap();
+
+    ++m_hits;
+    return chain->levels.at(wanted - 1);
+}
+
+void MipmapCache::requestChain(const QPixmap &pixmap)
+{
+    const qint64 key = pixmap.cacheKey();
+    if(m_pending.contains(key))
+        return;
+    m_pending.insert(key);
+
+    const QSize baseSize = pixmap.size();
+    const QImage source = pixmap.toImage();
+    auto *watcher = new QFutureWatcher<QVector<QImage>>(this);
+    connect(watcher, &QFutureWatcher<QVector<QImage>>::finished, this, [this, watcher, key, baseSize]() {
+        const QVector<QImage> images = watcher->result();
+        watcher->deleteLater();
+        m_pending.remove(key);
+
+        auto *chain = new Chain;
+        chain->baseSize = baseSize;
+        qint64 bytes = 0;
+        for(const QImage &image : images)
+        {
+            chain->levels.append(QPixmap::fromImage(image));
+            bytes += image.sizeInBytes();
+        }
+        m_chains.insert(key, chain, std::max<qint64>(1, bytes / 1024));
+        emit levelsReady();
+    });
+    watcher->setFuture(QtConcurrent::run(buildLevels, source));
+}
+
+MipmapCache::Stats MipmapCache::stats() const
+{
+    Stats result;
+    result.hits = m_hits;
+    result.misses = m_misses;
+    result.chains = m_chains.size();
+    result.pending = m_pending.size();
+    return result;
+}
+
+void MipmapCache::clear()
+{
+    m_chains.clear();
+}
@@ -0,0 +1,52 @@
+#ifndef MIPMAPCACHE_H
+#define MIPMAPCACHE_H
+
+#include <QCache>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QVector>
+
+// Halved copies of canvas pixmaps for zoomed out drawing. Chains are keyed
+// by QPixmap::cacheKey(), built once on a worker thread and uploaded to
+// QPixmap on the GUI thread; until then callers keep the full resolution.
+class MipmapCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        int chains = 0;
+        int pending = 0;
+    };
+
+    explicit MipmapCache(QObject *parent = nullptr);
+
+    // Level to draw pixmap with at the given zoom, or a null pixmap when the
+    // full resolution should be used. exactTiling only accepts levels whose
+    // size divides the original evenly, so tiled patterns keep their period.
+    QPixmap level(const QPixmap &pixmap, double scale, bool exactTiling = false);
+
+    Stats stats() const;
+    void clear();
+
+signals:
+    void levelsReady();
+
+private:
+    struct Chain {
+        // levels[0] is half the original size, levels[1] a quarter, ...
+        QVector<QPixmap> levels;
+        QSize baseSize;
+    };
+
+    void requestChain(const QPixmap &pixmap);
+
+    QCache<qint64, Chain> m_chains;
+    QSet<qint64> m_pending;
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+#endif // MIPMAPCACHE_H
@@ -0,0 +1,205 @@
+#include "moduleindex.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+namespace {
+constexpr quint32 kIndexMagic = 0x4F544D49; // "OTMI"
+constexpr quint16 kIndexVersion = 1;
+
+QString normalizedPath(const QString &path)
+{
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+qint64 modifiedMs(const QString &path)
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+}
+
+// Found by argument dependent lookup from Qt's container operators, so not
+// in the anonymous namespace.
+static QDataStream &operator<<(QDataStream &stream, const ModuleScanner::Entry &entry)
+{
+    return stream << entry.label << entry.absolutePath << static_cast<quint8>(entry.kind);
+}
+
+static QDataStream &operator>>(QDataStream &stream, ModuleScanner::Entry &entry)
+{
+    quint8 kind = 0;
+    stream >> entry.label >> entry.absolutePath >> kind;
+    entry.kind = kind == static_cast<quint8>(ModuleScanner::Entry::Kind::Style) ? ModuleScanner::Entry::Kind::Style
+                                                                               : ModuleScanner::Entry::Kind::Interface;
+    return stream;
+}
+
+bool ModuleIndex::load(const QString &cachePath)
+{
+    m_modules.clear();
+    m_byPath.clear();
+
+    QFile file(cachePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if(magic != kIndexMagic || version != kIndexVersion)
+        return false;
+
+    quint32 count = 0;
+    stream >> m_modulesRoot >> m_dataPathHint >> count;
+    QVector<Module> modules;
+    modules.reserve(static_cast<int>(qMin<quint32>(count, 4096)));
+    for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        Module module;
+        ModuleScanner::Result &result = module.result;
+        stream >> module.otmodPath >> module.found >> module.dependencies
+               >> result.moduleName >> result.moduleDir >> result.entries >> result.primaryIndex
+               >> result.missingUiFiles >> result.scripts;
+        modules.append(std::move(module));
+    }
+    if(stream.status() != QDataStream::Ok)
+    {
+        m_modulesRoot.clear();
+        m_dataPathHint.clear();
+        return false;
+    }
+
+    m_modules = std::move(modules);
+    for(int i = 0; i < m_modules.size(); ++i)
+        m_byPath.insert(m_modules.at(i).otmodPath, i);
+    return true;
+}
+
+bool ModuleIndex::save(const QString &cachePath, QString *error) const
+{
+    QSaveFile file(cachePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << kIndexMagic << kIndexVersion << m_modulesRoot << m_dataPathHint << static_cast<quint32>(m_modules.size());
+    for(const Module &module : m_modules)
+    {
+        const ModuleScanner::Result &result = module.result;
+        stream << module.otmodPath << module.found << module.dependencies
+               << result.moduleName << result.moduleDir << result.entries << result.primaryIndex
+               << result.missingUiFiles << result.scripts;
+    }
+
+    if(stream.status() != QDataStream::Ok || !file.commit())
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+ModuleIndex::Stats ModuleIndex::refresh(const QString &modulesRoot, const QString &dataPathHint)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Paths in the cached results were resolved against the old roots.
+    const QString root = normalizedPath(modulesRoot);
+    if(root != m_modulesRoot || dataPathHint != m_dataPathHint)
+    {
+        m_modules.clear();
+        m_byPath.clear();
+        m_modulesRoot = root;
+        m_dataPathHint = dataPathHint;
+    }
+
+    QStringList otmodPaths;
+    QDirIterator it(root, QStringList() << QStringLiteral("*.otmod"), QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+        otmodPaths << normalizedPath(it.next());
+    otmodPaths.sort();
+
+    QVector<Module> modules;
+    modules.reserve(otmodPaths.size());
+    QStringList stale;
+    QVector<int> staleSlots;
+    for(const QString &path : std::as_const(otmodPaths))
+    {
+        const Module *cached = find(path);
+        if(cached && isCurrent(*cached))
+        {
+            modules.append(*cached);
+            continue;
+        }
+        stale << path;
+        staleSlots.append(modules.size());
+        modules.append(Module());
+    }
+
+    // Each scan only reads its own module's files, so they run side by side.
+    const QString hint = dataPathHint;
+    const QVector<Module> scanned = QtConcurrent::blockingMapped<QVector<Module>>(stale, [hint](const QString &path) {
+        return scanModule(path, hint);
+    });
+    for(int i = 0; i < scanned.size(); ++i)
+        modules[staleSlots.at(i)] = scanned.at(i);
+
+    m_modules = std::move(modules);
+    m_byPath.clear();
+    for(int i = 0; i < m_modules.size(); ++i)
+        m_byPath.insert(m_modules.at(i).otmodPath, i);
+
+    Stats stats;
+    stats.modules = m_modules.size();
+    stats.rescanned = stale.size();
+    stats.elapsedMs = timer.elapsed();
+    return stats;
+}
+
+const ModuleIndex::Module *ModuleIndex::find(const QString &otmodPath) const
+{
+    const auto it = m_byPath.constFind(normalizedPath(otmodPath));
+    return it == m_byPath.cend() ? nullptr : &m_modules.at(it.value());
+}
+
+bool ModuleIndex::isCurrent(const Module &module)
+{
+    if(module.dependencies.isEmpty())
+        return false;
+    for(auto it = module.dependencies.cbegin(); it != module.dependencies.cend(); ++it)
+    {
+        if(modifiedMs(it.key()) != it.value())
+            return false;
+    }
+    return true;
+}
+
+ModuleIndex::Module ModuleIndex::scanModule(const QString &otmodPath, const QString &dataPathHint)
+{
+    Module module;
+    module.otmodPath = otmodPath;
+    ModuleScanner scanner;
+    module.found = scanner.scan(otmodPath, dataPathHint, module.result);
+
+    module.dependencies.insert(otmodPath, modifiedMs(otmodPath));
+    for(const QString &script : std::as_const(module.result.scripts))
+        module.dependencies.insert(script, modifiedMs(script));
+    return module;
+}
@@ -0,0 +1,52 @@
+#ifndef MODULEINDEX_H
+#define MODULEINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "modulescanner.h"
+
+// UI files of every module under a modules directory. Modules are scanned
+// concurrently with ModuleScanner and remembered with the mtime of each file
+// the scan read, so a refresh of a loaded index only rescans modules whose
+// .otmod or scripts changed.
+class ModuleIndex
+{
+public:
+    struct Module {
+        QString otmodPath;
+        bool found = false;
+        ModuleScanner::Result result;
+        // The .otmod and every script read, by path, with their mtime in ms.
+        QHash<QString, qint64> dependencies;
+    };
+
+    struct Stats {
+        int modules = 0;
+        int rescanned = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    // Reads an index written by save(); false leaves the index empty.
+    bool load(const QString &cachePath);
+    bool save(const QString &cachePath, QString *error = nullptr) const;
+
+    // Finds every .otmod under modulesRoot and rescans the new or changed
+    // ones in parallel. Blocks; run it off the GUI thread.
+    Stats refresh(const QString &modulesRoot, const QString &dataPathHint);
+
+    const QVector<Module> &modules() const { return m_modules; }
+    const Module *find(const QString &otmodPath) const;
+    // Whether none of the files the module was scanned from changed since.
+    static bool isCurrent(const Module &module);
+
+private:
+    static Module scanModule(const QString &otmodPath, const QString &dataPathHint);
+
+    QString m_modulesRoot;
+    QString m_dataPathHint;
+    QVector<Module> m_modules;
+    QHash<QString, int> m_byPath;
+};
+
+#endif // MODULEINDEX_H
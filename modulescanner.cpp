@@ -77,7 +77,11 @@ bool ModuleScanner::scan(const QString& otmodPath,
                   collectedAbsolutePaths);
     }
 
+    result.scripts = QStringList(processedScripts.cbegin(), processedScripts.cend());
+    result.scripts.sort();
+
     if(result.entries.isEmpty()) {
+        outResult = result;
         if(error) {
             *error = QStringLiteral("No OTUI files were found in module %1.").arg(result.moduleName);
             if(!result.missingUiFiles.isEmpty())
@@ -139,7 +143,7 @@ void ModuleScanner::collectUiReferences(const QString& scriptContent,
                                         Result& outResult,
                                         QSet<QString>& collectedAbsolutePaths) const
 {
-    auto appendEntry = [&](const QString& rawPath, bool isPrimaryCandidate) {
+    auto appendEntry = [&](const QString& rawPath, bool isPrimaryCandidate, Entry::Kind kind) {
         const QString absolutePath = resolveUiPath(rawPath, moduleDir, dataPathHint);
         if(absolutePath.isEmpty())
             return;
@@ -162,6 +166,7 @@ void ModuleScanner::collectUiReferences(const QString& scriptContent,
         if(relative.startsWith(".."))
             relative = entry.absolutePath;
         entry.label = relative;
+        entry.kind = kind;
         outResult.entries.append(entry);
         if(isPrimaryCandidate && outResult.primaryIndex < 0) {
             outResult.primaryIndex = outResult.entries.size() - 1;
@@ -172,14 +177,15 @@ void ModuleScanner::collectUiReferences(const QString& scriptContent,
     auto setUiIt = setUiRegex.globalMatch(scriptContent);
     while(setUiIt.hasNext()) {
         const QString path = setUiIt.next().captured(1);
-        appendEntry(path, true);
+        appendEntry(path, true, Entry::Kind::Interface);
     }
 
-    QRegularExpression loadUiRegex(QStringLiteral("g_ui\\.(?:loadUI|displayUI|importStyle)\\s*\\(\\s*['\"]([^'\"]+)['\"]"));
+    QRegularExpression loadUiRegex(QStringLiteral("g_ui\\.(loadUI|displayUI|importStyle)\\s*\\(\\s*['\"]([^'\"]+)['\"]"));
     auto loadIt = loadUiRegex.globalMatch(scriptContent);
     while(loadIt.hasNext()) {
-        const QString path = loadIt.next().captured(1);
-        appendEntry(path, false);
+        const QRegularExpressionMatch match = loadIt.next();
+        const bool isStyle = match.captured(1) == QLatin1String("importStyle");
+        appendEntry(match.captured(2), false, isStyle ? Entry::Kind::Style : Entry::Kind::Interface);
     }
 }
 
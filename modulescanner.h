@@ -10,8 +10,14 @@ class ModuleScanner
 {
 public:
     struct Entry {
+        enum class Kind {
+            Interface,  // controller:setUI, g_ui.loadUI, g_ui.displayUI
+            Style       // g_ui.importStyle; defines styles the interfaces use
+        };
+
         QString label;
         QString absolutePath;
+        Kind kind = Kind::Interface;
     };
 
     struct Result {
@@ -20,8 +26,11 @@ public:
         QVector<Entry> entries;
         int primaryIndex = -1;
         QStringList missingUiFiles;
+        // Lua files the scan read, dofile chains included.
+        QStringList scripts;
     };
 
+    // Fills outResult even when no UI file is found, so callers can see what was read.
     bool scan(const QString& otmodPath,
               const QString& dataPathHint,
               Result& outResult,
@@ -0,0 +1,138 @@
+#include "offscreenrenderer.h"
+#include "spatialindex.h"
+
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+const QSize kDeterministicTileSize(256, 256);
+
+struct Tile {
+    QRect pixels;
+    QVector<OTUI::Widget*> widgets;
+};
+}
+
+QImage OffscreenRenderer::render(const std::vector<std::unique_ptr<OTUI::Widget>> &widgets, const Options &options)
+{
+    if(options.size.isEmpty())
+        return QImage();
+
+    const double scale = options.scale <= 0.0 ? 1.0 : options.scale;
+    QImage target(options.size, QImage::Format_ARGB32_Premultiplied);
+    target.fill(options.clearColor);
+
+    // Snapshot on this thread; pixmaps cannot be touched from the pool.
+    QHash<qint64, QImage> liveSnapshots;
+    m_frameImages.clear();
+    SpatialIndex index;
+    quint64 order = 0;
+    for(auto const &widget : widgets)
+    {
+        if(!widget)
+            continue;
+        const QPixmap pixmap = widget->image();
+        if(!pixmap.isNull())
+        {
+            const qint64 key = pixmap.cacheKey();
+            QImage image = m_snapshotCache.value(key);
+            if(image.isNull())
+                image = pixmap.toImage();
+            liveSnapshots.insert(key, image);
+            m_frameImages.insert(widget.get(), image);
+        }
+        index.insert(widget.get(), canvasRect(*widget), order++);
+    }
+    m_snapshotCache = liveSnapshots;
+
+    // Widget lists are resolved per tile up front, the index is not safe to query concurrently.
+    const QSize tileSize = options.deterministic ? kDeterministicTileSize : options.tileSize.expandedTo(QSize(16, 16));
+    QVector<Tile> tiles;
+    for(int y = 0; y < target.height(); y += tileSize.height())
+    {
+        for(int x = 0; x < target.width(); x += tileSize.width())
+        {
+            Tile tile;
+            tile.pixels = QRect(x, y, std::min(tileSize.width(), target.width() - x), std::min(tileSize.height(), target.height() - y));
+            const QRectF canvasArea(options.origin + QPointF(tile.pixels.topLeft()) / scale, QSizeF(tile.pixels.size()) / scale);
+            tile.widgets = index.query(canvasArea.toAlignedRect().adjusted(-1, -1, 1, 1));
+            tiles.append(tile);
+        }
+    }
+
+    uchar *bits = target.bits();
+    const qsizetype bytesPerLine = target.bytesPerLine();
+    const QImage::Format format = target.format();
+    const bool deterministic = options.deterministic;
+    auto renderTile = [&](Tile &tile) {
+        // Each tile paints into its own window of the shared buffer, tiles never overlap.
+        QImage view(bits + tile.pixels.y() * bytesPerLine + tile.pixels.x() * 4,
+                    tile.pixels.width(), tile.pixels.height(), bytesPerLine, format);
+        QPainter painter(&view);
+        // The canvas paints with QPainter's default hints. Text antialiasing
+        // depends on the platform rasterizer, so deterministic mode drops it.
+        if(deterministic)
+            painter.setRenderHint(QPainter::TextAntialiasing, false);
+        painter.translate(-tile.pixels.topLeft());
+        painter.scale(scale, scale);
+        painter.translate(-options.origin);
+
+        if(!options.background.isNull())
+        {
+            const QRectF canvasArea(options.origin + QPointF(tile.pixels.topLeft()) / scale, QSizeF(tile.pixels.size()) / scale);
+            painter.fillRect(canvasArea.toAlignedRect(), QBrush(options.background));
+        }
+
+        for(OTUI::Widget *widget : tile.widgets)
+            drawWidget(painter, *widget);
+    };
+
+    if(deterministic || tiles.size() == 1)
+    {
+        for(Tile &tile : tiles)
+            renderTile(tile);
+    }
+    else
+    {
+        QThreadPool *pool = options.pool ? options.pool : QThreadPool::globalInstance();
+        QtConcurrent::blockingMap(pool, tiles, renderTile);
+    }
+
+    m_frameImages.clear();
+    return target;
+}
+
+int OffscreenRenderer::countDifferentPixels(const QImage &a, const QImage &b)
+{
+    if(a.size() != b.size())
+        return -1;
+
+    const QImage left = a.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QImage right = b.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    int different = 0;
+    for(int y = 0; y < left.height(); ++y)
+    {
+        const QRgb *leftLine = reinterpret_cast<const QRgb*>(left.constScanLine(y));
+        const QRgb *rightLine = reinterpret_cast<const QRgb*>(right.constScanLine(y));
+        for(int x = 0; x < left.width(); ++x)
+        {
+            if(leftLine[x] != rightLine[x])
+                ++different;
+        }
+    }
+    return different;
+}
+
+bool OffscreenRenderer::hasImage(const OTUI::Widget &widget) const
+{
+    return m_frameImages.contains(&widget);
+}
+
+void OffscreenRenderer::drawImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const
+{
+    const auto it = m_frameImages.constFind(&widget);
+    if(it != m_frameImages.cend())
+        painter.drawImage(target, it.value(), source);
+}
@@ -0,0 +1,55 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QPointF>
+#include <QSize>
+#include <memory>
+#include <vector>
+#include "scenerenderer.h"
+
+class QThreadPool;
+
+// Renders a widget list into a QImage without a GL context. The target is
+// split into tiles that are rasterized in parallel; every tile paints with the
+// same SceneRenderer code as the editor canvas, clipped to its own rows.
+class OffscreenRenderer : public SceneRenderer
+{
+public:
+    struct Options {
+        QSize size;
+        // Canvas coordinate placed at the top-left pixel of the image.
+        QPointF origin;
+        double scale = 1.0;
+        QSize tileSize = QSize(256, 256);
+        QColor clearColor = Qt::transparent;
+        // Tiled from the canvas origin, like the editor background.
+        QImage background;
+        // Fixed 256px tiles painted in order on the calling thread with text
+        // antialiasing off, for golden-image comparisons.
+        bool deterministic = false;
+        QThreadPool *pool = nullptr;
+    };
+
+    // Must run on the GUI thread: widget pixmaps are snapshotted to QImage
+    // before any tile is handed to the pool.
+    QImage render(const std::vector<std::unique_ptr<OTUI::Widget>> &widgets, const Options &options);
+    void clearCache() { m_snapshotCache.clear(); }
+
+    // Pixels that differ between a and b, or -1 when their sizes differ.
+    static int countDifferentPixels(const QImage &a, const QImage &b);
+
+protected:
+    bool hasImage(const OTUI::Widget &widget) const override;
+    void drawImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const override;
+
+private:
+    // Read-only while tiles are being painted.
+    QHash<const OTUI::Widget*, QImage> m_frameImages;
+    // Conversions reused between renders, keyed by QPixmap::cacheKey().
+    QHash<qint64, QImage> m_snapshotCache;
+};
+
+#endif // OFFSCREENRENDERER_H
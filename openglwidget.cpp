@@ -2,8 +2,10 @@
 #include <QDebug>
 #include <utility>
 #include <algorithm>
+#include <cmath>
 
 #include "openglwidget.h"
+#include "otui/texturemanager.h"
 
 OpenGLWidget::OpenGLWidget(QWidget *parent)
         : QOpenGLWidget(parent),
@@ -12,6 +14,7 @@ OpenGLWidget::OpenGLWidget(QWidget *parent)
             m_mousePressedPos(0, 0),
             m_mousePressed(false),
             m_mousePressedPivot(OTUI::NoPivot),
+            m_mipmaps(new MipmapCache(this)),
             pTimer(new QTimer(this))
 {
     m_brushNormal = QBrush(QColor(0, 255, 0));
@@ -23,6 +26,10 @@ OpenGLWidget::OpenGLWidget(QWidget *parent)
     pTimer->start(frameIntervalMs);
 
     m_background.load(":/images/background.png");
+
+    m_renderer.setMipmapCache(m_mipmaps);
+    m_renderStats.setMipmapCache(m_mipmaps);
+    connect(m_mipmaps, &MipmapCache::levelsReady, this, [this]() { update(); });
 }
 
 OpenGLWidget::~OpenGLWidget()
@@ -38,32 +45,51 @@ void OpenGLWidget::paintGL()
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0);
 
+    if(m_statsOverlayVisible)
+        m_renderStats.beginFrame();
+
+    ensureSpatialIndex();
+
+    const QRect visibleRect = visibleCanvasRect();
+
     QPainter painter(this);
     painter.scale(scale, scale);
-    painter.drawTiledPixmap(QRect(0, 0, this->width() / scale, this->height() / scale), m_background);
-    for(auto const &widget : m_otuiWidgets)
+    painter.translate(-m_viewOrigin);
+    const QPixmap backgroundLevel = m_mipmaps->level(m_background, scale, true);
+    if(backgroundLevel.isNull())
+        painter.drawTiledPixmap(visibleRect, m_background, visibleRect.topLeft());
+    else
+    {
+        // Tile the reduced pattern in its own space so it stays anchored to the canvas origin.
+        const qreal factor = static_cast<qreal>(m_background.width()) / backgroundLevel.width();
+        const QRectF levelRect(QPointF(visibleRect.topLeft()) / factor, QSizeF(visibleRect.size()) / factor);
+        painter.save();
+        painter.scale(factor, factor);
+        painter.drawTiledPixmap(levelRect, backgroundLevel, levelRect.topLeft());
+        painter.restore();
+    }
+    if(m_statsOverlayVisible)
+    {
+        m_renderStats.countDrawCall();
+        m_renderStats.countTextureBind(m_background.cacheKey());
+    }
+
+    // Grow the query a bit so outlines and pivots hanging off a widget edge still show.
+    const QRect cullRect = visibleRect.adjusted(-PIVOT_WIDTH, -PIVOT_HEIGHT, PIVOT_WIDTH, PIVOT_HEIGHT);
+    const QVector<OTUI::Widget*> visibleWidgets = m_spatialIndex.query(cullRect);
+    for(OTUI::Widget *widget : visibleWidgets)
     {
         OTUI::Widget *parent = widget->getParent();
-        if(!widget->image().isNull())
+        m_renderer.drawWidget(painter, *widget);
+
+        if(widget == m_hovered && widget != m_selected)
         {
-            if(widget->getImageBorder().isNull())
-            {
-                if(parent)
-                    painter.drawPixmap(widget->getPos() + parent->getPos(), widget->image(), widget->getImageCrop());
-                else
-                    painter.drawPixmap(*widget->getRect(), widget->image(), widget->getImageCrop());
-            }
-            else
-            {
-                if(parent)
-                    drawBorderImage(painter, *widget, widget->x() + parent->x(), widget->y() + parent->y());
-                else
-                    drawBorderImage(painter, *widget);
-            }
+            painter.save();
+            painter.setPen(QPen(m_brushHover.color(), 1, Qt::DashLine));
+            painter.drawRect(SceneRenderer::canvasRect(*widget));
+            painter.restore();
         }
 
-        widget->draw(painter);
-
         if(!m_selected) continue;
 
         if(widget->getId() == m_selected->getId())
@@ -87,13 +113,53 @@ void OpenGLWidget::paintGL()
 
         }
     }
+
+    if(m_statsOverlayVisible)
+    {
+        const int drawn = static_cast<int>(visibleWidgets.size());
+        m_renderStats.endFrame(drawn, static_cast<int>(m_otuiWidgets.size()) - drawn);
+        drawStatsOverlay(painter);
+    }
+}
+
+QImage OpenGLWidget::renderScene(const QRect &canvasRect)
+{
+    QImage image(canvasRect.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    // Same setup as m_renderer, minus the stats it counts into while the overlay is on.
+    SceneRenderer renderer;
+    renderer.setMipmapCache(m_mipmaps);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::TextAntialiasing, false);
+    painter.translate(-canvasRect.topLeft());
+    for(auto const &widget : m_otuiWidgets)
+        renderer.drawWidget(painter, *widget);
+    return image;
 }
 
 void OpenGLWidget::mouseMoveEvent(QMouseEvent *event)
 {
-    const double safeScale = scale == 0.0 ? 1.0 : scale;
-    const QPointF localPos = event->position();
-    m_mousePos = QPoint(static_cast<int>(localPos.x() / safeScale), static_cast<int>(localPos.y() / safeScale));
+    if(m_panning)
+    {
+        const double safeScale = scale == 0.0 ? 1.0 : scale;
+        const QPointF delta = (event->position() - m_panAnchor) / safeScale;
+        m_panAnchor = event->position();
+        setViewOrigin(m_viewOrigin - delta);
+        return;
+    }
+
+    m_mousePos = mapToCanvas(event->position());
+    if(!m_mousePressed)
+    {
+        OTUI::Widget *hovered = widgetAt(m_mousePos);
+        if(hovered != m_hovered)
+        {
+            m_hovered = hovered;
+            update();
+        }
+    }
+
     if(m_selected)
     {
         OTUI::Widget *parent = m_selected->getParent();
@@ -202,6 +268,7 @@ void OpenGLWidget::mouseMoveEvent(QMouseEvent *event)
 
             if(geometryChanged)
             {
+                reindexWidget(m_selected);
                 emit widgetGeometryChanged(m_selected);
                 update();
             }
@@ -211,49 +278,41 @@ void OpenGLWidget::mouseMoveEvent(QMouseEvent *event)
 
 void OpenGLWidget::mousePressEvent(QMouseEvent *event)
 {
+    if(event->button() == Qt::MouseButton::MiddleButton)
+    {
+        m_panning = true;
+        m_panAnchor = event->position();
+        setCursor(Qt::ClosedHandCursor);
+        return;
+    }
+
     if(event->button() == Qt::MouseButton::LeftButton)
     {
         OTUI::Widget *previousSelection = m_selected;
-        const double safeScale = scale == 0.0 ? 1.0 : scale;
-        const QPointF localPos = event->position();
-        m_mousePressedPos = QPoint(static_cast<int>(localPos.x() / safeScale), static_cast<int>(localPos.y() / safeScale));
+        m_mousePressedPos = mapToCanvas(event->position());
         m_mousePressed = true;
         bool selected = false;
-        m_selected = nullptr;
-        for(auto &widget : reverse(m_otuiWidgets))
+
+        // Handles of the current selection win over whatever lies underneath them.
+        if(m_selected)
         {
-            OTUI::Widget *parent = widget->getParent();
-            if(parent)
-            {
-                QRect widgetRect(widget->x() + parent->x() - PIVOT_WIDTH / 2,
-                                 widget->y() + parent->y() - PIVOT_HEIGHT / 2,
-                                 widget->width() + PIVOT_WIDTH,
-                                 widget->height() + PIVOT_HEIGHT);
-                if(widgetRect.contains(m_mousePressedPos))
-                {
-                    m_selected = widget.get();
-                    selected = true;
-                    break;
-                }
-            }
-            else
-            {
-                QRect widgetRect(widget->getRect()->x() - PIVOT_WIDTH / 2,
-                                 widget->getRect()->y() - PIVOT_HEIGHT / 2,
-                                 widget->getRect()->width() + PIVOT_WIDTH,
-                                 widget->getRect()->height() + PIVOT_HEIGHT);
-                if(widgetRect.contains(m_mousePressedPos))
-                {
-                    m_selected = widget.get();
-                    selected = true;
-                    break;
-                }
-            }
+            m_mousePressedPivot = pivotAt(SceneRenderer::canvasRect(*m_selected), m_mousePressedPos);
+            selected = m_mousePressedPivot != OTUI::NoPivot;
+        }
+
+        if(!selected)
+        {
+            m_selected = widgetAt(m_mousePressedPos);
+            selected = m_selected != nullptr;
+            if(selected)
+                m_mousePressedPivot = pivotAt(SceneRenderer::canvasRect(*m_selected), m_mousePressedPos);
         }
 
         if(selected)
         {
             offset = m_mousePressedPos - (m_selected->getRect()->topLeft());
+            m_dragWidget = m_selected;
+            m_dragStartRect = *m_selected->getRect();
         }
 
         if(previousSelection != m_selected)
@@ -264,18 +323,46 @@ void OpenGLWidget::mousePressEvent(QMouseEvent *event)
 
 void OpenGLWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+    if(event->button() == Qt::MouseButton::MiddleButton && m_panning)
+    {
+        m_panning = false;
+        unsetCursor();
+        return;
+    }
+
     if(event->button() == Qt::MouseButton::LeftButton)
     {
         m_mousePressed = false;
         m_mousePressedPivot = OTUI::NoPivot;
+        OTUI::Widget *dragged = std::exchange(m_dragWidget, nullptr);
+        if(dragged && dragged == m_selected && *dragged->getRect() != m_dragStartRect)
+            emit geometryEdited(dragged, m_dragStartRect, *dragged->getRect());
     }
 }
 
+void OpenGLWidget::wheelEvent(QWheelEvent *event)
+{
+    const double safeScale = scale == 0.0 ? 1.0 : scale;
+    // One wheel notch (120 units) scrolls 30 screen pixels.
+    QPointF delta = QPointF(event->angleDelta()) / 4.0 / safeScale;
+    if(event->modifiers() & Qt::ShiftModifier)
+        delta = QPointF(delta.y(), delta.x());
+    setViewOrigin(m_viewOrigin - delta);
+    event->accept();
+}
+
 void OpenGLWidget::keyReleaseEvent(QKeyEvent *event)
 {
+    if(event->key() == Qt::Key_Home)
+    {
+        resetView();
+        return;
+    }
+
     if(!m_selected) return;
 
     QRect *rect = m_selected->getRect();
+    const QRect before = *rect;
     QPoint newPos(rect->topLeft());
 
     switch(event->key())
@@ -327,7 +414,10 @@ void OpenGLWidget::keyReleaseEvent(QKeyEvent *event)
         m_selected->setPos(newPos);
     }
 
+    reindexWidget(m_selected);
     emit widgetGeometryChanged(m_selected);
+    if(*rect != before)
+        emit geometryEdited(m_selected, before, *rect);
     update();
 }
 
@@ -339,206 +429,296 @@ void OpenGLWidget::sendEvent(QEvent *event)
     }
 }
 
-void OpenGLWidget::setWidgets(std::vector<std::unique_ptr<OTUI::Widget>> widgets)
+std::vector<std::unique_ptr<OTUI::Widget>> OpenGLWidget::setWidgets(std::vector<std::unique_ptr<OTUI::Widget>> widgets)
 {
-    m_otuiWidgets = std::move(widgets);
+    emit widgetsAboutToBeReset();
+    std::swap(m_otuiWidgets, widgets);
+    m_spatialIndexDirty = true;
+    m_viewOrigin = QPointF();
     m_selected = nullptr;
+    m_hovered = nullptr;
+    m_dragWidget = nullptr;
+    emit widgetsReset();
     emit selectionChanged(nullptr);
     update();
+    return widgets;
 }
 
-void OpenGLWidget::drawBorderImage(QPainter &painter, OTUI::Widget const &widget)
-{
-    drawBorderImage(painter, widget, widget.x(), widget.y());
-}
-
-void OpenGLWidget::drawBorderImage(QPainter &painter, OTUI::Widget const &widget, int x, int y)
-{
-    int top = widget.getImageBorder().y();
-    int bottom = widget.getImageBorder().height();
-    int left =  widget.getImageBorder().x();
-    int right  = widget.getImageBorder().width();
-
-    // calculates border coords
-    const QRect clip = widget.getImageCrop();
-    QRect leftBorder(clip.left(), clip.top() + top, left, clip.height() - top - bottom);
-    QRect rightBorder(clip.right() - right + 1, clip.top() + top, right, clip.height() - top - bottom);
-    QRect topBorder(clip.left() + left, clip.top(), clip.width() - right - left, top);
-    QRect bottomBorder(clip.left() + left, clip.bottom() - bottom + 1, clip.width() - right - left, bottom);
-    QRect topLeftCorner(clip.left(), clip.top(), left, top);
-    QRect topRightCorner(clip.right() - right + 1, clip.top(), right, top);
-    QRect bottomLeftCorner(clip.left(), clip.bottom() - bottom + 1, left, bottom);
-    QRect bottomRightCorner(clip.right() - right + 1, clip.bottom() - bottom + 1, right, bottom);
-    QRect center(clip.left() + left, clip.top() + top, clip.width() - right - left, clip.height() - top - bottom);
-    QPoint bordersSize(leftBorder.width() + rightBorder.width(), topBorder.height() + bottomBorder.height());
-    QPoint centerSize = widget.getSize() - bordersSize;
-    QRect rectCoords;
-    QRect drawRect(x, y, widget.width(), widget.height());
-
-    // first the center
-    if((centerSize.x()*centerSize.y()) > 0) {
-        rectCoords = QRect(drawRect.left() + leftBorder.width(),
-                           drawRect.top() + topBorder.height(),
-                           centerSize.x(),
-                           centerSize.y());
-        painter.drawPixmap(rectCoords, widget.image(), center);
-    }
-    // top left corner
-    rectCoords = QRect(drawRect.topLeft(), topLeftCorner.size());
-    painter.drawPixmap(rectCoords, widget.image(), topLeftCorner);
-    // top
-    rectCoords = QRect(drawRect.left() + topLeftCorner.width(), drawRect.topLeft().y(), centerSize.x(), topBorder.height());
-    painter.drawPixmap(rectCoords, widget.image(), topBorder);
-    // top right corner
-    rectCoords = QRect(QPoint(drawRect.left() + topLeftCorner.width() + centerSize.x(), drawRect.top()), topRightCorner.size());
-    painter.drawPixmap(rectCoords, widget.image(), topRightCorner);
-    // left
-    rectCoords = QRect(drawRect.left(), drawRect.top() + topLeftCorner.height(), leftBorder.width(), centerSize.y());
-    painter.drawPixmap(rectCoords, widget.image(), leftBorder);
-    // right
-    rectCoords = QRect(drawRect.left() + leftBorder.width() + centerSize.x(), drawRect.top() + topRightCorner.height(), rightBorder.width(), centerSize.y());
-    painter.drawPixmap(rectCoords, widget.image(), rightBorder);
-    // bottom left corner
-    rectCoords = QRect(QPoint(drawRect.left(), drawRect.top() + topLeftCorner.height() + centerSize.y()), bottomLeftCorner.size());
-    painter.drawPixmap(rectCoords, widget.image(), bottomLeftCorner);
-    // bottom
-    rectCoords = QRect(drawRect.left() + bottomLeftCorner.width(), drawRect.top() + topBorder.height() + centerSize.y(), centerSize.x(), bottomBorder.height());
-    painter.drawPixmap(rectCoords, widget.image(), bottomBorder);
-    // bottom right corner
-    rectCoords = QRect(QPoint(drawRect.left() + bottomLeftCorner.width() + centerSize.x(), drawRect.top() + topRightCorner.height() + centerSize.y()), bottomRightCorner.size());
-    painter.drawPixmap(rectCoords, widget.image(), bottomRightCorner);
-}
-void OpenGLWidget::drawOutlines(QPainter &painter, int left, int top, int width, int height)
+OpenGLWidget::DetachedWidgets OpenGLWidget::detachWidget(OTUI::Widget *widget)
 {
-    painter.setPen(QPen(Qt::white, LINE_WIDTH, Qt::DashLine, Qt::SquareCap));
-    painter.drawLine(left, top, left + width, top);
-    painter.drawLine(left + width, top, left + width, top + height);
-    painter.drawLine(left + width, top + height, left, top + height);
-    painter.drawLine(left, top + height, left, top);
-}
+    DetachedWidgets detached;
+    if(!widget)
+        return detached;
 
-void OpenGLWidget::drawPivots(QPainter &painter, int left, int top, int width, int height)
-{
-    QRect rect(left - PIVOT_WIDTH / 2, top - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    QBrush brush = m_brushNormal;
-    if(rect.contains(m_mousePos))
-    {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::TopLeft))
+    emit widgetAboutToBeRemoved(widget);
+
+    const auto inSubtree = [widget](OTUI::Widget *candidate) {
+        for(OTUI::Widget *ancestor = candidate; ancestor; ancestor = ancestor->getParent())
         {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::TopLeft;
+            if(ancestor == widget)
+                return true;
         }
-        else
-            brush = m_brushHover;
-    }
-
-    painter.fillRect(rect, brush);
+        return false;
+    };
 
-    brush = m_brushNormal;
-    rect.setRect(left + width / 2 - PIVOT_WIDTH / 2, top - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+    std::size_t kept = 0;
+    for(std::size_t i = 0; i < m_otuiWidgets.size(); ++i)
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::Top))
+        std::unique_ptr<OTUI::Widget> &slot = m_otuiWidgets[i];
+        if(slot && inSubtree(slot.get()))
         {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::Top;
+            unindexWidget(slot.get());
+            if(m_hovered == slot.get())
+                m_hovered = nullptr;
+            detached.emplace_back(i, std::move(slot));
         }
         else
-            brush = m_brushHover;
+        {
+            if(kept != i)
+                m_otuiWidgets[kept] = std::move(slot);
+            ++kept;
+        }
     }
+    m_otuiWidgets.resize(kept);
 
-    painter.fillRect(rect, brush);
+    m_selected = nullptr;
+    emit selectionChanged(nullptr);
+    update();
+    return detached;
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left + width - PIVOT_WIDTH / 2, top - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+void OpenGLWidget::restoreWidgets(DetachedWidgets widgets)
+{
+    if(widgets.empty())
+        return;
+
+    // Ascending slots put every widget back where it was detached from.
+    QVector<OTUI::Widget*> restored;
+    restored.reserve(static_cast<int>(widgets.size()));
+    for(auto &entry : widgets)
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::TopRight))
-        {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::TopRight;
-        }
-        else
-            brush = m_brushHover;
+        const std::size_t slot = std::min(entry.first, m_otuiWidgets.size());
+        restored.append(entry.second.get());
+        m_otuiWidgets.insert(m_otuiWidgets.begin() + static_cast<std::ptrdiff_t>(slot), std::move(entry.second));
     }
 
-    painter.fillRect(rect, brush);
+    m_spatialIndexDirty = true;
+    emit widgetsInserted(restored);
+    update();
+}
+
+void OpenGLWidget::clearWidgets()
+{
+    emit widgetsAboutToBeReset();
+    m_selected = nullptr;
+    m_hovered = nullptr;
+    m_otuiWidgets.clear();
+    m_spatialIndexDirty = true;
+    emit widgetsReset();
+    emit selectionChanged(nullptr);
+    update();
+}
+
+void OpenGLWidget::notifyWidgetGeometryChanged(OTUI::Widget *widget)
+{
+    if(!widget)
+        return;
+    reindexWidget(widget);
+    update();
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left - PIVOT_WIDTH / 2, top + height / 2 - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+void OpenGLWidget::setStatsOverlayVisible(bool visible)
+{
+    if(m_statsOverlayVisible == visible)
+        return;
+    m_statsOverlayVisible = visible;
+    m_renderer.setStats(visible ? &m_renderStats : nullptr);
+    update();
+}
+
+void OpenGLWidget::drawStatsOverlay(QPainter &painter)
+{
+    const RenderFrameStats &frame = m_renderStats.lastFrame();
+    const auto hitRate = [](double rate) {
+        return rate < 0.0 ? QStringLiteral("-") : QStringLiteral("%1%").arg(rate * 100.0, 0, 'f', 1);
+    };
+    const OTUI::TextureManager::Stats textures = OTUI::TextureManager::instance().stats();
+    const quint64 textureLookups = textures.hits + textures.misses;
+    const QStringList lines = {
+        QStringLiteral("Frame %1 ms  p50 %2  p95 %3  p99 %4")
+            .arg(frame.frameMs, 0, 'f', 2)
+            .arg(m_renderStats.frameTimePercentile(50.0), 0, 'f', 2)
+            .arg(m_renderStats.frameTimePercentile(95.0), 0, 'f', 2)
+            .arg(m_renderStats.frameTimePercentile(99.0), 0, 'f', 2),
+        QStringLiteral("Widgets %1 drawn / %2 culled").arg(frame.widgetsDrawn).arg(frame.widgetsCulled),
+        QStringLiteral("Draw calls %1  Texture binds %2").arg(frame.drawCalls).arg(frame.textureBinds),
+        QStringLiteral("Text cache hits %1  Mipmap hits %2  Texture hits %3")
+            .arg(hitRate(frame.textCacheHitRate), hitRate(frame.mipmapHitRate), hitRate(frame.textureHitRate)),
+        QStringLiteral("Textures %1  %2 / %3 MiB  hit rate %4  shared %5  evicted %6")
+            .arg(textures.textures)
+            .arg(textures.bytes / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(textures.budget / (1024.0 * 1024.0), 0, 'f', 0)
+            .arg(hitRate(textureLookups == 0 ? -1.0 : static_cast<double>(textures.hits) / textureLookups))
+            .arg(textures.shared)
+            .arg(textures.evictions),
+        QStringLiteral("Recorded frames %1").arg(m_renderStats.sessionFrames())
+    };
+
+    // Screen space, unaffected by zoom and pan.
+    painter.save();
+    painter.resetTransform();
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(9);
+    painter.setFont(font);
+    const QFontMetrics metrics(painter.font());
+    int textWidth = 0;
+    for(const QString &line : lines)
+        textWidth = std::max(textWidth, metrics.horizontalAdvance(line));
+    const int lineHeight = metrics.height();
+    const QRect panel(8, 8, textWidth + 16, lineHeight * lines.size() + 12);
+    painter.fillRect(panel, QColor(0, 0, 0, 170));
+    painter.setPen(QColor(120, 255, 120));
+    int y = panel.top() + 6 + metrics.ascent();
+    for(const QString &line : lines)
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::Left))
-        {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::Left;
-        }
-        else
-            brush = m_brushHover;
+        painter.drawText(panel.left() + 8, y, line);
+        y += lineHeight;
     }
+    painter.restore();
+}
 
-    painter.fillRect(rect, brush);
+void OpenGLWidget::setViewOrigin(const QPointF &origin)
+{
+    if(m_viewOrigin == origin)
+        return;
+    m_viewOrigin = origin;
+    update();
+}
+
+QPoint OpenGLWidget::mapToCanvas(const QPointF &localPos) const
+{
+    const double safeScale = scale == 0.0 ? 1.0 : scale;
+    const QPointF canvasPos = localPos / safeScale + m_viewOrigin;
+    return QPoint(static_cast<int>(std::floor(canvasPos.x())), static_cast<int>(std::floor(canvasPos.y())));
+}
+
+QRect OpenGLWidget::visibleCanvasRect() const
+{
+    const double safeScale = scale == 0.0 ? 1.0 : scale;
+    const QRectF area(m_viewOrigin, QSizeF(width() / safeScale, height() / safeScale));
+    return area.toAlignedRect();
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left + width - PIVOT_WIDTH / 2, top + height / 2 - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+void OpenGLWidget::rebuildSpatialIndex()
+{
+    m_spatialIndex.clear();
+    m_childWidgets.clear();
+    m_nextPaintOrder = 0;
+    m_spatialIndexDirty = false;
+    for(auto const &widget : m_otuiWidgets)
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::Right))
-        {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::Right;
-        }
-        else
-            brush = m_brushHover;
+        if(widget)
+            indexWidget(widget.get());
     }
+}
 
-    painter.fillRect(rect, brush);
+void OpenGLWidget::indexWidget(OTUI::Widget *widget)
+{
+    // A pending rebuild will pick the widget up from m_otuiWidgets.
+    if(!widget || m_spatialIndexDirty)
+        return;
+    m_spatialIndex.insert(widget, SceneRenderer::canvasRect(*widget), m_nextPaintOrder++);
+    if(OTUI::Widget *parent = widget->getParent())
+        m_childWidgets[parent].append(widget);
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left - PIVOT_WIDTH / 2, top + height - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+void OpenGLWidget::unindexWidget(OTUI::Widget *widget)
+{
+    if(!widget || m_spatialIndexDirty)
+        return;
+    m_spatialIndex.remove(widget);
+    m_childWidgets.remove(widget);
+    if(OTUI::Widget *parent = widget->getParent())
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::BottomLeft))
-        {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::BottomLeft;
-        }
-        else
-            brush = m_brushHover;
+        auto it = m_childWidgets.find(parent);
+        if(it != m_childWidgets.end())
+            it->removeOne(widget);
     }
+}
 
-    painter.fillRect(rect, brush);
+void OpenGLWidget::reindexWidget(OTUI::Widget *widget)
+{
+    if(!widget || m_spatialIndexDirty)
+        return;
+    m_spatialIndex.update(widget, SceneRenderer::canvasRect(*widget));
+    const auto it = m_childWidgets.constFind(widget);
+    if(it == m_childWidgets.cend())
+        return;
+    for(OTUI::Widget *child : *it)
+        m_spatialIndex.update(child, SceneRenderer::canvasRect(*child));
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left + width / 2 - PIVOT_WIDTH / 2, top + height - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
-    {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::Bottom))
-        {
-            brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::Bottom;
-        }
-        else
-            brush = m_brushHover;
+OTUI::Widget *OpenGLWidget::widgetAt(const QPoint &canvasPos)
+{
+    ensureSpatialIndex();
+    // Same slack as the selection handles so an edge pivot can still be grabbed.
+    return m_spatialIndex.pick(canvasPos, PIVOT_WIDTH / 2);
+}
+
+void OpenGLWidget::drawOutlines(QPainter &painter, int left, int top, int width, int height)
+{
+    painter.setPen(QPen(Qt::white, LINE_WIDTH, Qt::DashLine, Qt::SquareCap));
+    painter.drawLine(left, top, left + width, top);
+    painter.drawLine(left + width, top, left + width, top + height);
+    painter.drawLine(left + width, top + height, left, top + height);
+    painter.drawLine(left, top + height, left, top);
+}
+
+QRect OpenGLWidget::pivotRect(OTUI::Pivot pivot, const QRect &widgetRect) const
+{
+    const int left = widgetRect.x();
+    const int top = widgetRect.y();
+    const int width = widgetRect.width();
+    const int height = widgetRect.height();
+
+    QPoint center;
+    switch(pivot) {
+    case OTUI::TopLeft: center = QPoint(left, top); break;
+    case OTUI::Top: center = QPoint(left + width / 2, top); break;
+    case OTUI::TopRight: center = QPoint(left + width, top); break;
+    case OTUI::Left: center = QPoint(left, top + height / 2); break;
+    case OTUI::Right: center = QPoint(left + width, top + height / 2); break;
+    case OTUI::BottomLeft: center = QPoint(left, top + height); break;
+    case OTUI::Bottom: center = QPoint(left + width / 2, top + height); break;
+    case OTUI::BottomRight: center = QPoint(left + width, top + height); break;
+    default: return QRect();
     }
+    return QRect(center.x() - PIVOT_WIDTH / 2, center.y() - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
+}
 
-    painter.fillRect(rect, brush);
+OTUI::Pivot OpenGLWidget::pivotAt(const QRect &widgetRect, const QPoint &pos) const
+{
+    for(int pivot = OTUI::TopLeft; pivot <= OTUI::BottomRight; ++pivot)
+    {
+        if(pivotRect(static_cast<OTUI::Pivot>(pivot), widgetRect).contains(pos))
+            return static_cast<OTUI::Pivot>(pivot);
+    }
+    return OTUI::NoPivot;
+}
 
-    brush = m_brushNormal;
-    rect.setRect(left + width - PIVOT_WIDTH / 2, top + height - PIVOT_HEIGHT / 2, PIVOT_WIDTH, PIVOT_HEIGHT);
-    if(rect.contains(m_mousePos))
+void OpenGLWidget::drawPivots(QPainter &painter, int left, int top, int width, int height)
+{
+    const QRect widgetRect(left, top, width, height);
+    const OTUI::Pivot hovered = m_mousePressed ? OTUI::NoPivot : pivotAt(widgetRect, m_mousePos);
+    for(int pivot = OTUI::TopLeft; pivot <= OTUI::BottomRight; ++pivot)
     {
-        if(m_mousePressed &&(m_mousePressedPivot == OTUI::NoPivot || m_mousePressedPivot == OTUI::BottomRight))
-        {
+        QBrush brush = m_brushNormal;
+        if(m_mousePressed && m_mousePressedPivot == pivot)
             brush = m_brushSelected;
-            m_mousePressedPivot = OTUI::BottomRight;
-        }
-        else
+        else if(hovered == pivot)
             brush = m_brushHover;
+        painter.fillRect(pivotRect(static_cast<OTUI::Pivot>(pivot), widgetRect), brush);
     }
-
-    painter.fillRect(rect, brush);
-
 }
 
 void OpenGLWidget::drawNineSliceOverlay(QPainter &painter, const OTUI::Widget &widget, int x, int y)
@@ -629,6 +809,8 @@ OTUI::Widget *OpenGLWidget::appendWidgetTree(OTUI::Widget *parent, OTUI::Parser:
         return nullptr;
 
     OTUI::Widget *rootInserted = nullptr;
+    QVector<OTUI::Widget*> inserted;
+    inserted.reserve(static_cast<int>(widgets.size()));
     for(auto &widget : widgets)
     {
         if(!widget)
@@ -644,10 +826,13 @@ OTUI::Widget *OpenGLWidget::appendWidgetTree(OTUI::Widget *parent, OTUI::Parser:
         if(!rootInserted)
             rootInserted = widget.get();
 
+        inserted.append(widget.get());
         m_otuiWidgets.emplace_back(std::move(widget));
     }
 
+    m_spatialIndexDirty = true;
     m_selected = rootInserted;
+    emit widgetsInserted(inserted);
     emit selectionChanged(m_selected);
     update();
     return rootInserted;
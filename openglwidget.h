@@ -7,6 +7,10 @@
 #include "otui/otui.h"
 #include "otui/parser.h"
 #include "corewindow.h"
+#include "mipmapcache.h"
+#include "renderstats.h"
+#include "scenerenderer.h"
+#include "spatialindex.h"
 #include <QPainter>
 #include <QOpenGLWidget>
 #include <QTime>
@@ -25,6 +29,7 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
 
 public:
@@ -43,7 +48,9 @@ public:
 
         widget->setImageBorder(imageBorder);
         m_otuiWidgets.emplace_back(std::move(widget));
+        indexWidget(m_selected);
 
+        emit widgetsInserted({m_selected});
         emit selectionChanged(m_selected);
         update();
 
@@ -84,7 +91,9 @@ public:
         widget->setParent(parent);
         setInBounds(widget.get(), QPoint());
         m_otuiWidgets.emplace_back(std::move(widget));
+        indexWidget(m_selected);
 
+        emit widgetsInserted({m_selected});
         emit selectionChanged(m_selected);
         update();
 
@@ -92,25 +101,30 @@ public:
     }
 
     std::vector<std::unique_ptr<OTUI::Widget>> const &getOTUIWidgets() const { return m_otuiWidgets; }
-    void deleteWidget(QString widgetId) {
-        auto itr = std::find_if(std::begin(m_otuiWidgets),
-                                std::end(m_otuiWidgets),
-                                [widgetId](auto &element) { return element.get()->getId() == widgetId;});
-        m_otuiWidgets.erase(itr);
-        m_selected = nullptr;
-        emit selectionChanged(nullptr);
-        update();
-    }
-    void clearWidgets() {
-        m_selected = nullptr;
-        m_otuiWidgets.clear();
-        emit selectionChanged(nullptr);
-        update();
-    }
+    // Store slots and widgets taken out of it, so they can be put back unchanged.
+    using DetachedWidgets = std::vector<std::pair<std::size_t, std::unique_ptr<OTUI::Widget>>>;
+    // Takes widget and its children out of the store without destroying them.
+    DetachedWidgets detachWidget(OTUI::Widget *widget);
+    void restoreWidgets(DetachedWidgets widgets);
+    void clearWidgets();
 
     void sendEvent(QEvent *event);
-    void setWidgets(std::vector<std::unique_ptr<OTUI::Widget>> widgets);
+    // Replaces the store and returns the previous one, e.g. to park it in an inactive document.
+    std::vector<std::unique_ptr<OTUI::Widget>> setWidgets(std::vector<std::unique_ptr<OTUI::Widget>> widgets);
     OTUI::Widget *appendWidgetTree(OTUI::Widget *parent, OTUI::Parser::WidgetList &&widgets);
+    void notifyWidgetGeometryChanged(OTUI::Widget *widget);
+
+    bool statsOverlayVisible() const { return m_statsOverlayVisible; }
+    void setStatsOverlayVisible(bool visible);
+    const RenderStats &renderStats() const { return m_renderStats; }
+
+    // canvasRect of the scene as the canvas paints it, without background or
+    // overlays and with text antialiasing off; the golden image for OffscreenRenderer.
+    QImage renderScene(const QRect &canvasRect);
+
+    QPointF viewOrigin() const { return m_viewOrigin; }
+    void setViewOrigin(const QPointF &origin);
+    void resetView() { setViewOrigin(QPointF()); }
 
     OTUI::Widget *m_selected = nullptr;
 
@@ -118,7 +132,15 @@ public:
 
 signals:
     void selectionChanged(OTUI::Widget *widget);
+    // Store changes for the widget tree; removals and resets are announced
+    // while the old widgets are still alive.
+    void widgetsAboutToBeReset();
+    void widgetsReset();
+    void widgetsInserted(const QVector<OTUI::Widget*> &widgets);
+    void widgetAboutToBeRemoved(OTUI::Widget *widget);
     void widgetGeometryChanged(OTUI::Widget *widget);
+    // One per finished drag or nudge, for the edit history.
+    void geometryEdited(OTUI::Widget *widget, const QRect &before, const QRect &after);
 
 private:
     template <class T>
@@ -172,11 +194,21 @@ private:
     const uint8_t PIVOT_WIDTH = 8;
     const uint8_t PIVOT_HEIGHT = 8;
 
-    void drawBorderImage(QPainter &painter, OTUI::Widget const &widget);
-    void drawBorderImage(QPainter &painter, OTUI::Widget const &widget, int x, int y);
     void drawOutlines(QPainter &painter, int left, int top, int width, int height);
     void drawPivots(QPainter &painter, int left, int top, int width, int height);
+    QRect pivotRect(OTUI::Pivot pivot, const QRect &widgetRect) const;
+    OTUI::Pivot pivotAt(const QRect &widgetRect, const QPoint &pos) const;
     void drawNineSliceOverlay(QPainter &painter, const OTUI::Widget &widget, int x, int y);
+    void drawStatsOverlay(QPainter &painter);
+
+    QPoint mapToCanvas(const QPointF &localPos) const;
+    QRect visibleCanvasRect() const;
+    void rebuildSpatialIndex();
+    void ensureSpatialIndex() { if(m_spatialIndexDirty) rebuildSpatialIndex(); }
+    void indexWidget(OTUI::Widget *widget);
+    void unindexWidget(OTUI::Widget *widget);
+    void reindexWidget(OTUI::Widget *widget);
+    OTUI::Widget *widgetAt(const QPoint &canvasPos);
 
     std::vector<std::unique_ptr<OTUI::Widget>> m_otuiWidgets;
 
@@ -184,6 +216,8 @@ private:
     QPoint m_mousePressedPos;
     bool m_mousePressed;
     OTUI::Pivot m_mousePressedPivot;
+    OTUI::Widget *m_dragWidget = nullptr;
+    QRect m_dragStartRect;
 
     QBrush m_brushNormal;
     QBrush m_brushHover;
@@ -191,6 +225,22 @@ private:
     QPoint offset;
 
     QPixmap m_background;
+    MipmapCache *m_mipmaps;
+    SceneRenderer m_renderer;
+    RenderStats m_renderStats;
+    bool m_statsOverlayVisible = false;
+
+    // Canvas coordinate shown at the top-left corner of the viewport.
+    QPointF m_viewOrigin;
+    bool m_panning = false;
+    QPointF m_panAnchor;
+
+    SpatialIndex m_spatialIndex;
+    bool m_spatialIndexDirty = true;
+    quint64 m_nextPaintOrder = 0;
+    // Children are drawn relative to their direct parent, so moving a parent moves these too.
+    QHash<OTUI::Widget*, QVector<OTUI::Widget*>> m_childWidgets;
+    OTUI::Widget *m_hovered = nullptr;
 
     QTimer *pTimer;
 
@@ -0,0 +1,405 @@
+#include "bitmapfont.h"
+#include "guithread.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <algorithm>
+
+#include "../thirdparty/otui/otui_parser.h"
+
+namespace {
+// Distinct text colors per font rarely exceed a handful; the cap only guards against churn.
+const int kMaxTintedAtlases = 32;
+const int kMaxLayouts = 2048;
+
+QMutex g_fontRegistryMutex;
+QHash<QString, std::shared_ptr<const OTUI::BitmapFont>> g_fontRegistry;
+
+QSize parseSize(const QString &value, const QSize &fallback)
+{
+    const QStringList parts = value.split(' ', Qt::SkipEmptyParts);
+    if(parts.size() == 1)
+    {
+        bool ok = false;
+        const int both = parts.first().toInt(&ok);
+        return ok ? QSize(both, both) : fallback;
+    }
+    if(parts.size() != 2)
+        return fallback;
+    bool okWidth = false;
+    bool okHeight = false;
+    const int width = parts.at(0).toInt(&okWidth);
+    const int height = parts.at(1).toInt(&okHeight);
+    return okWidth && okHeight ? QSize(width, height) : fallback;
+}
+
+int parseInt(const QString &value, int fallback)
+{
+    bool ok = false;
+    const int result = value.toInt(&ok);
+    return ok ? result : fallback;
+}
+
+qreal alignedOffset(int available, int used, Qt::Alignment alignment, Qt::Alignment trailing, Qt::Alignment center)
+{
+    if(alignment & trailing)
+        return available - used;
+    if(alignment & center)
+        return (available - used) / 2;
+    return 0;
+}
+}
+
+std::shared_ptr<const OTUI::BitmapFont> OTUI::BitmapFont::find(const QString &name, const QString &dataPath)
+{
+    const QString fontName = name.trimmed();
+    if(fontName.isEmpty() || dataPath.trimmed().isEmpty())
+        return nullptr;
+
+    const QString root = QDir::cleanPath(QDir::fromNativeSeparators(dataPath.trimmed()));
+    const QString key = root + QLatin1Char('|') + fontName.toLower();
+    {
+        QMutexLocker locker(&g_fontRegistryMutex);
+        const auto it = g_fontRegistry.constFind(key);
+        if(it != g_fontRegistry.cend())
+            return it.value();
+    }
+
+    std::shared_ptr<const BitmapFont> loaded;
+    const QString path = root + QStringLiteral("/fonts/") + fontName + QStringLiteral(".otfont");
+    if(QFileInfo::exists(path))
+    {
+        std::shared_ptr<BitmapFont> font(new BitmapFont);
+        QString error;
+        if(font->load(path, &error))
+            loaded = font;
+        else
+            qWarning("Failed to load font %s: %s", qPrintable(path), qPrintable(error));
+    }
+
+    QMutexLocker locker(&g_fontRegistryMutex);
+    g_fontRegistry.insert(key, loaded);
+    return loaded;
+}
+
+void OTUI::BitmapFont::clearRegistry()
+{
+    QMutexLocker locker(&g_fontRegistryMutex);
+    g_fontRegistry.clear();
+}
+
+bool OTUI::BitmapFont::load(const QString &path, QString *error)
+{
+    char errBuf[256] = {0};
+    const QByteArray utf8Path = QFile::encodeName(path);
+    OTUINode *root = otui_parse_file(utf8Path.constData(), errBuf, sizeof(errBuf));
+    if(!root)
+    {
+        if(error)
+            *error = QString::fromUtf8(errBuf).trimmed();
+        return false;
+    }
+    std::unique_ptr<OTUINode, decltype(&otui_free)> guard(root, otui_free);
+
+    const OTUINode *fontNode = nullptr;
+    for(size_t i = 0; i < root->nchildren; ++i)
+    {
+        const OTUINode *child = root->children[i];
+        if(child && child->name && QString::fromUtf8(child->name).compare(QStringLiteral("Font"), Qt::CaseInsensitive) == 0)
+        {
+            fontNode = child;
+            break;
+        }
+    }
+    if(!fontNode)
+    {
+        if(error)
+            *error = QObject::tr("Missing Font node.");
+        return false;
+    }
+
+    auto value = [fontNode](const char *key) {
+        const char *raw = otui_prop_get(fontNode, key);
+        return raw ? QString::fromUtf8(raw).trimmed() : QString();
+    };
+
+    const QFileInfo info(path);
+    m_name = value("name");
+    if(m_name.isEmpty())
+        m_name = info.completeBaseName();
+
+    // Texture paths are relative to the .otfont unless rooted at the data folder.
+    QString texture = QDir::fromNativeSeparators(value("texture"));
+    if(texture.isEmpty())
+        texture = m_name;
+    QString texturePath = texture.startsWith('/')
+            ? QDir::cleanPath(info.absoluteDir().absolutePath() + QStringLiteral("/..") + texture)
+            : QDir::cleanPath(info.absoluteDir().absolutePath() + QLatin1Char('/') + texture);
+    if(QFileInfo(texturePath).suffix().isEmpty())
+        texturePath += QStringLiteral(".png");
+
+    QImage atlas;
+    if(!atlas.load(texturePath))
+    {
+        if(error)
+            *error = QObject::tr("Cannot load texture %1.").arg(texturePath);
+        return false;
+    }
+    m_atlas = atlas.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const QSize glyphSize = parseSize(value("glyph-size"), QSize());
+    m_glyphHeight = parseInt(value("height"), glyphSize.height());
+    m_firstGlyph = std::clamp(parseInt(value("first-glyph"), 32), 0, 255);
+    m_yOffset = parseInt(value("y-offset"), 0);
+    m_spacing = parseSize(value("spacing"), QSize(0, 0));
+    const int spaceWidth = parseInt(value("space-width"), glyphSize.width());
+    const int fixedWidth = parseInt(value("fixed-glyph-width"), -1);
+
+    if(glyphSize.width() <= 0 || glyphSize.height() <= 0 || m_glyphHeight <= 0 || m_atlas.width() < glyphSize.width())
+    {
+        if(error)
+            *error = QObject::tr("Invalid glyph metrics.");
+        return false;
+    }
+
+    const int columns = m_atlas.width() / glyphSize.width();
+    m_glyphRects.fill(QRect());
+    for(int glyph = m_firstGlyph; glyph < 256; ++glyph)
+    {
+        const int index = glyph - m_firstGlyph;
+        const QRect cell((index % columns) * glyphSize.width(), (index / columns) * glyphSize.height(),
+                         glyphSize.width(), std::min(m_glyphHeight, glyphSize.height()));
+        if(!m_atlas.rect().contains(cell))
+            break;
+        const int width = fixedWidth >= 0 ? fixedWidth : detectGlyphWidth(cell);
+        m_glyphRects[glyph] = QRect(cell.topLeft(), QSize(width, cell.height()));
+    }
+
+    // 32 and 160 (nbsp) are blank cells in the texture, their advance comes from space-width.
+    for(int space : {32, 160})
+    {
+        if(m_glyphRects[space].isNull())
+            m_glyphRects[space] = QRect(0, 0, spaceWidth, m_glyphHeight);
+        else
+            m_glyphRects[space].setWidth(spaceWidth);
+    }
+
+    m_layouts.setMaxCost(kMaxLayouts);
+    return true;
+}
+
+int OTUI::BitmapFont::detectGlyphWidth(const QRect &cell) const
+{
+    // Rightmost column holding any non transparent pixel, same as the client.
+    int width = cell.width();
+    for(int x = cell.left(); x <= cell.right(); ++x)
+    {
+        for(int y = cell.top(); y <= cell.bottom(); ++y)
+        {
+            if(qAlpha(reinterpret_cast<const QRgb*>(m_atlas.constScanLine(y))[x]) != 0)
+            {
+                width = x - cell.left() + 1;
+                break;
+            }
+        }
+    }
+    return width;
+}
+
+int OTUI::BitmapFont::glyphCode(QChar ch) const
+{
+    const ushort code = ch.unicode();
+    return code < 256 ? code : '?';
+}
+
+OTUI::BitmapFont::Layout OTUI::BitmapFont::layout(const QString &text, int wrapWidth) const
+{
+    const QString key = QString::number(wrapWidth) + QLatin1Char('\x1f') + text;
+    {
+        QMutexLocker locker(&m_mutex);
+        if(const Layout *cached = m_layouts.object(key))
+            return *cached;
+    }
+
+    auto *entry = new Layout(buildLayout(text, wrapWidth));
+    const Layout result = *entry;
+    QMutexLocker locker(&m_mutex);
+    m_layouts.insert(key, entry, 1);
+    return result;
+}
+
+OTUI::BitmapFont::Layout OTUI::BitmapFont::buildLayout(const QString &text, int wrapWidth) const
+{
+    Layout result;
+    auto lineWidth = [this](const QVector<int> &codes) {
+        int width = 0;
+        for(int code : codes)
+            width += advance(code);
+        return codes.isEmpty() ? 0 : width - m_spacing.width();
+    };
+
+    QVector<QVector<int>> lines;
+    for(const QString &paragraph : text.split(QLatin1Char('\n')))
+    {
+        QVector<int> current;
+        if(wrapWidth <= 0)
+        {
+            for(QChar ch : paragraph)
+                current.append(glyphCode(ch));
+            lines.append(current);
+            continue;
+        }
+
+        int currentWidth = 0;
+        for(const QString &word : paragraph.split(QLatin1Char(' ')))
+        {
+            QVector<int> codes;
+            int wordWidth = 0;
+            for(QChar ch : word)
+            {
+                codes.append(glyphCode(ch));
+                wordWidth += advance(codes.last());
+            }
+            const int spaceAdvance = current.isEmpty() ? 0 : advance(' ');
+            if(!current.isEmpty() && currentWidth + spaceAdvance + wordWidth - m_spacing.width() > wrapWidth)
+            {
+                lines.append(current);
+                current.clear();
+                currentWidth = 0;
+            }
+            else if(!current.isEmpty())
+            {
+                current.append(' ');
+                currentWidth += spaceAdvance;
+            }
+            current += codes;
+            currentWidth += wordWidth;
+        }
+        lines.append(current);
+    }
+
+    for(const QVector<int> &codes : lines)
+    {
+        Line line;
+        line.first = result.glyphs.size();
+        line.count = codes.size();
+        line.width = lineWidth(codes);
+        int x = 0;
+        for(int code : codes)
+        {
+            result.glyphs.append({code, x});
+            x += advance(code);
+        }
+        result.lines.append(line);
+        result.size.setWidth(std::max(result.size.width(), line.width));
+    }
+    const int lineCount = result.lines.size();
+    result.size.setHeight(lineCount * m_glyphHeight + std::max(0, lineCount - 1) * m_spacing.height());
+    return result;
+}
+
+QSize OTUI::BitmapFont::measure(const QString &text, int wrapWidth) const
+{
+    return layout(text, wrapWidth).size;
+}
+
+QImage OTUI::BitmapFont::tintedImage(const QColor &color) const
+{
+    const QRgb key = color.rgba();
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_tintedImages.constFind(key);
+    if(it != m_tintedImages.cend())
+        return it.value();
+    if(m_tintedImages.size() >= kMaxTintedAtlases)
+        m_tintedImages.clear();
+
+    // Modulate like the client does (texture * color), the atlas is premultiplied.
+    QImage tinted = m_atlas;
+    const int red = color.red();
+    const int green = color.green();
+    const int blue = color.blue();
+    const int alpha = color.alpha();
+    for(int y = 0; y < tinted.height(); ++y)
+    {
+        QRgb *line = reinterpret_cast<QRgb*>(tinted.scanLine(y));
+        for(int x = 0; x < tinted.width(); ++x)
+        {
+            const QRgb pixel = line[x];
+            if(qAlpha(pixel) == 0)
+                continue;
+            line[x] = qRgba(qRed(pixel) * red * alpha / (255 * 255),
+                            qGreen(pixel) * green * alpha / (255 * 255),
+                            qBlue(pixel) * blue * alpha / (255 * 255),
+                            qAlpha(pixel) * alpha / 255);
+        }
+    }
+    m_tintedImages.insert(key, tinted);
+    return tinted;
+}
+
+QPixmap OTUI::BitmapFont::tintedPixmap(const QColor &color) const
+{
+    const QRgb key = color.rgba();
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_tintedPixmaps.constFind(key);
+        if(it != m_tintedPixmaps.cend())
+            return it.value();
+    }
+
+    const QPixmap pixmap = QPixmap::fromImage(tintedImage(color));
+    QMutexLocker locker(&m_mutex);
+    if(m_tintedPixmaps.size() >= kMaxTintedAtlases)
+        m_tintedPixmaps.clear();
+    m_tintedPixmaps.insert(key, pixmap);
+    return pixmap;
+}
+
+void OTUI::BitmapFont::drawText(QPainter &painter, const QRect &box, const QString &text, const QColor &color,
+                                Qt::Alignment alignment, bool wrap) const
+{
+    if(text.isEmpty())
+        return;
+
+    const Layout textLayout = layout(text, wrap ? box.width() : 0);
+    const qreal top = box.y() + alignedOffset(box.height(), textLayout.size.height(), alignment, Qt::AlignBottom, Qt::AlignVCenter) + m_yOffset;
+
+    // The GUI thread batches every glyph into one drawPixmapFragments call on the
+    // tinted atlas; other threads (offscreen rendering) cannot use QPixmap.
+    const bool batched = isGuiThread();
+    QVector<QPainter::PixmapFragment> fragments;
+    QImage atlasImage;
+    if(batched)
+        fragments.reserve(textLayout.glyphs.size());
+    else
+        atlasImage = tintedImage(color);
+
+    // Glyphs past the box are cut off, as OTClient clips them to the text rect.
+    painter.save();
+    painter.setClipRect(box, Qt::IntersectClip);
+
+    for(int lineIndex = 0; lineIndex < textLayout.lines.size(); ++lineIndex)
+    {
+        const Line &line = textLayout.lines.at(lineIndex);
+        const qreal left = box.x() + alignedOffset(box.width(), line.width, alignment, Qt::AlignRight, Qt::AlignHCenter);
+        const qreal y = top + lineIndex * (m_glyphHeight + m_spacing.height());
+        for(int i = line.first; i < line.first + line.count; ++i)
+        {
+            const Glyph &glyph = textLayout.glyphs.at(i);
+            const QRect &source = m_glyphRects[glyph.code];
+            if(glyph.code == 32 || glyph.code == 160 || source.isEmpty())
+                continue;
+            const QRectF target(left + glyph.x, y, source.width(), source.height());
+            if(batched)
+                fragments.append(QPainter::PixmapFragment::create(target.center(), source));
+            else
+                painter.drawImage(target, atlasImage, source);
+        }
+    }
+
+    if(batched && !fragments.isEmpty())
+        painter.drawPixmapFragments(fragments.constData(), fragments.size(), tintedPixmap(color));
+    painter.restore();
+}
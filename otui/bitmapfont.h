@@ -0,0 +1,81 @@
+#ifndef OTUIBITMAPFONT_H
+#define OTUIBITMAPFONT_H
+
+#include <QCache>
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPainter>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <array>
+#include <memory>
+
+namespace OTUI {
+    // Glyph atlas loaded from an OTClient .otfont definition (data/fonts).
+    // Metrics follow the client: fixed cells of glyph-size in the texture,
+    // widths either fixed or detected from the alpha channel, latin1 mapping.
+    class BitmapFont
+    {
+    public:
+        // Resolves <name>.otfont under <dataPath>/fonts. Fonts are loaded once
+        // and shared; a missing font is remembered so lookups stay cheap.
+        static std::shared_ptr<const BitmapFont> find(const QString &name, const QString &dataPath);
+        static void clearRegistry();
+
+        const QString &name() const { return m_name; }
+        int glyphHeight() const { return m_glyphHeight; }
+
+        // Size of the laid out text; wrapWidth <= 0 only breaks on newlines.
+        QSize measure(const QString &text, int wrapWidth) const;
+        // Clipped to box.
+        void drawText(QPainter &painter, const QRect &box, const QString &text, const QColor &color,
+                      Qt::Alignment alignment, bool wrap) const;
+
+    private:
+        BitmapFont() = default;
+        bool load(const QString &path, QString *error);
+        int detectGlyphWidth(const QRect &cell) const;
+
+        struct Glyph {
+            int code = 0;
+            int x = 0;
+        };
+        struct Line {
+            int width = 0;
+            int first = 0;
+            int count = 0;
+        };
+        struct Layout {
+            QVector<Glyph> glyphs;
+            QVector<Line> lines;
+            QSize size;
+        };
+
+        Layout layout(const QString &text, int wrapWidth) const;
+        Layout buildLayout(const QString &text, int wrapWidth) const;
+        int glyphCode(QChar ch) const;
+        int advance(int code) const { return m_glyphRects[code].width() + m_spacing.width(); }
+        QPixmap tintedPixmap(const QColor &color) const;
+        QImage tintedImage(const QColor &color) const;
+
+        QString m_name;
+        QImage m_atlas;
+        int m_glyphHeight = 0;
+        int m_firstGlyph = 32;
+        int m_yOffset = 0;
+        QSize m_spacing;
+        std::array<QRect, 256> m_glyphRects;
+
+        mutable QMutex m_mutex;
+        mutable QCache<QString, Layout> m_layouts;
+        mutable QHash<QRgb, QImage> m_tintedImages;
+        // QPixmap may only be touched on the GUI thread, see drawText().
+        mutable QHash<QRgb, QPixmap> m_tintedPixmaps;
+    };
+}
+
+#endif // OTUIBITMAPFONT_H
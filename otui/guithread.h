@@ -0,0 +1,17 @@
+#ifndef OTUIGUITHREAD_H
+#define OTUIGUITHREAD_H
+
+#include <QCoreApplication>
+#include <QThread>
+
+namespace OTUI {
+    // QPixmap and the canvas widgets belong to the application thread;
+    // imports and offscreen tiles run elsewhere.
+    inline bool isGuiThread()
+    {
+        const QCoreApplication *app = QCoreApplication::instance();
+        return app && QThread::currentThread() == app->thread();
+    }
+}
+
+#endif // OTUIGUITHREAD_H
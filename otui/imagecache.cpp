@@ -0,0 +1,27 @@
+#include "imagecache.h"
+
+#include <QFileInfo>
+#include <algorithm>
+
+OTUI::ImageCache::ImageCache(qint64 budgetBytes)
+    : m_images(static_cast<qsizetype>(std::max<qint64>(1, budgetBytes / 1024)))
+{
+}
+
+QImage OTUI::ImageCache::image(const QString &path)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if(const QImage *cached = m_images.object(path))
+            return *cached;
+    }
+
+    // Decoded outside the lock; two files asking for the same image at once both read it.
+    QImage image;
+    if(!QFileInfo::exists(path) || !image.load(path))
+        return QImage();
+
+    QMutexLocker locker(&m_mutex);
+    m_images.insert(path, new QImage(image), std::max<qsizetype>(1, image.sizeInBytes() / 1024));
+    return image;
+}
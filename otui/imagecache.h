@@ -0,0 +1,29 @@
+#ifndef OTUIIMAGECACHE_H
+#define OTUIIMAGECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+namespace OTUI {
+    // Images decoded while widgets are built off the GUI thread. An import
+    // owns one and hands it to the parsers of its files, so an image shared
+    // by many widgets is read once and nothing outlives the import.
+    // Safe to use from several threads.
+    class ImageCache
+    {
+    public:
+        explicit ImageCache(qint64 budgetBytes = 32 * 1024 * 1024);
+
+        // Null if the file cannot be read.
+        QImage image(const QString &path);
+
+    private:
+        QMutex m_mutex;
+        // Cost in KiB.
+        QCache<QString, QImage> m_images;
+    };
+}
+
+#endif // OTUIIMAGECACHE_H
@@ -4,21 +4,22 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QHash>
+#include <QMutex>
 #include <QPoint>
 #include <QRect>
 #include <QColor>
 #include <QRegularExpression>
 #include <QStringConverter>
-#include <QTextStream>
 #include <QSet>
 #include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QSaveFile>
 #include <functional>
 #include <QStringList>
+#include <charconv>
 #include <memory>
 #include <vector>
-#include <QFontMetrics>
-#include <limits>
 
 #include "mainwindow.h"
 #include "button.h"
@@ -26,6 +27,10 @@
 #include "image.h"
 #include "item.h"
 #include "creature.h"
+#include "textlayoutcache.h"
+#include "bitmapfont.h"
+#include "sourcedocument.h"
+#include "imagecache.h"
 
 #include "../thirdparty/otui/otui_parser.h"
 
@@ -45,9 +50,13 @@ struct StyleCacheEntry
     QString basePath;
     QHash<QString, const OTUINode*> nodesByName;
     std::vector<std::unique_ptr<OTUINode, OtuiNodeDeleter>> ownedTrees;
+    // Entry whose nodes were copied into nodesByName, kept alive for them.
+    std::shared_ptr<const StyleCacheEntry> base;
 };
 
+// Shared by the GUI thread and background imports; entries are immutable once built.
 static QHash<QString, std::shared_ptr<StyleCacheEntry>> g_styleCache;
+static QMutex g_styleCacheMutex;
 static thread_local const StyleCacheEntry *g_activeStyleCache = nullptr;
 static thread_local QHash<const OTUINode*, const OTUINode*> g_localTemplateBindings;
 static thread_local QSet<const OTUINode*> g_templateDefinitionNodes;
@@ -108,6 +117,8 @@ std::shared_ptr<StyleCacheEntry> ensureStyleCache(const QString &dataPath)
     if(key.isEmpty())
         return {};
 
+    // Held while a missing entry loads so concurrent callers do not parse the styles twice.
+    QMutexLocker locker(&g_styleCacheMutex);
     auto it = g_styleCache.constFind(key);
     if(it != g_styleCache.constEnd())
         return it.value();
@@ -125,10 +136,11 @@ std::shared_ptr<StyleCacheEntry> ensureStyleCache(const QString &dataPath)
 class ScopedStyleContext
 {
 public:
-    explicit ScopedStyleContext(const QString &dataPath)
+    explicit ScopedStyleContext(const QString &dataPath, std::shared_ptr<const StyleCacheEntry> styles = {})
         : m_previous(g_activeStyleCache)
+        , m_cache(std::move(styles))
     {
-        if(!dataPath.isEmpty())
+        if(!m_cache && !dataPath.isEmpty())
             m_cache = ensureStyleCache(dataPath);
         if(m_cache)
             g_activeStyleCache = m_cache.get();
@@ -141,7 +153,24 @@ public:
 
 private:
     const StyleCacheEntry *m_previous = nullptr;
-    std::shared_ptr<StyleCacheEntry> m_cache;
+    std::shared_ptr<const StyleCacheEntry> m_cache;
+};
+
+class ScopedImageCache
+{
+public:
+    explicit ScopedImageCache(ImageCache *cache)
+        : m_previous(setImportImageCache(cache))
+    {
+    }
+
+    ~ScopedImageCache()
+    {
+        setImportImageCache(m_previous);
+    }
+
+private:
+    ImageCache *m_previous = nullptr;
 };
 
 void buildLocalTemplateBindings(const OTUINode *root,
@@ -506,12 +535,10 @@ void applyTextAutoResize(OTUI::Widget *widget)
     if(text.isEmpty())
         return;
 
-    QFontMetrics metrics(widget->getFont());
-    QRect bounds;
-    if(widget->textWrap() && widget->getSize().x() > 0)
-        bounds = metrics.boundingRect(QRect(0, 0, widget->getSize().x(), std::numeric_limits<int>::max()), Qt::TextWordWrap, text);
-    else
-        bounds = metrics.boundingRect(text);
+    const int wrapWidth = widget->textWrap() ? widget->getSize().x() : 0;
+    const OTUI::BitmapFont *bitmapFont = widget->bitmapFont();
+    const QSize bounds = bitmapFont ? bitmapFont->measure(text, wrapWidth)
+                                    : OTUI::TextLayoutCache::instance().measure(text, widget->getFont(), wrapWidth);
 
     QPoint newSize = widget->getSize();
     if(bounds.width() > 0)
@@ -886,11 +913,14 @@ void applyCommonWidgetProps(OTUI::Widget *widget,
     if(!widget || !node)
         return;
 
-    widget->setIdProperty(nodeProperty(node, "id", widget->getId()));
+    widget->setId(nodeProperty(node, "id", widget->getId()));
 
     const QString fontValue = inheritedNodeProperty(node, root, "font");
     if(!fontValue.isEmpty())
+    {
         widget->setFont(parseFontDescriptor(fontValue, widget->getFont()));
+        widget->setFontName(fontValue, dataPath);
+    }
 
     const QString posValue = inheritedNodeProperty(node, root, "position");
     if(!posValue.isEmpty())
@@ -1066,6 +1096,7 @@ void buildWidgetsFromNode(const OTUINode *node,
     const QString imageSource = nodeProperty(node, "image-source");
 
     std::unique_ptr<OTUI::Widget> widget = createWidgetForNode(nodeName, widgetId, dataPath, imageSource);
+    widget->setStyleName(node->base_style ? QString::fromUtf8(node->base_style) : nodeName);
     applyCommonWidgetProps(widget.get(), node, root, dataPath);
     if(parent)
         widget->setParent(parent);
@@ -1081,13 +1112,32 @@ void releaseTree(OTUINode *root)
 {
     otui_free(root);
 }
+
+int countNodes(const OTUINode *node)
+{
+    if(!node)
+        return 0;
+    int count = 1;
+    for(size_t i = 0; i < node->nchildren; ++i)
+        count += countNodes(node->children[i]);
+    return count;
+}
 }
 
+struct StyleSet
+{
+    std::shared_ptr<const StyleCacheEntry> styles;
+};
+
 bool Parser::loadFromFile(const QString& path,
                           WidgetList& outWidgets,
                           QString* error,
-                          const QString& dataPath) const
+                          const QString& dataPath,
+                          SourceDocument* source) const
 {
+    if(source && !source->load(path, error))
+        return false;
+
     QByteArray utf8Path = QFile::encodeName(path);
     char errBuf[256] = {0};
     OTUINode *root = otui_parse_file(utf8Path.constData(), errBuf, sizeof(errBuf));
@@ -1105,11 +1155,17 @@ bool Parser::loadFromFile(const QString& path,
 
     QHash<const OTUINode*, OTUI::Widget*> createdWidgets;
 
+    // Template nodes are counted too, so the total is an upper bound.
+    const int totalNodes = countNodes(root) - 1;
+    int builtNodes = 0;
+    bool cancelled = m_progress && !m_progress(0, totalNodes);
+
     std::function<void(const OTUINode*, OTUI::Widget*)> visitNode;
-    ScopedStyleContext styleContext(dataPath);
+    ScopedStyleContext styleContext(dataPath, m_styles ? m_styles->styles : nullptr);
     ScopedTemplateBindings templateBindings(root);
+    ScopedImageCache imageCache(m_images.get());
     visitNode = [&](const OTUINode *node, OTUI::Widget *parent) {
-        if(!node)
+        if(!node || cancelled)
             return;
         if(node == root)
         {
@@ -1131,22 +1187,36 @@ bool Parser::loadFromFile(const QString& path,
         const QString imageSource = nodeProperty(node, "image-source");
 
         std::unique_ptr<OTUI::Widget> widget = createWidgetForNode(nodeName, widgetId, dataPath, imageSource);
+        widget->setStyleName(node->base_style ? QString::fromUtf8(node->base_style) : nodeName);
 
         applyCommonWidgetProps(widget.get(), node, root, dataPath);
 
         if(parent)
             widget->setParent(parent);
+        if(source)
+            source->bind(widget.get(), node);
 
         OTUI::Widget *rawPtr = widget.get();
         createdWidgets.insert(node, rawPtr);
         outWidgets.emplace_back(std::move(widget));
+        if(m_progress && !m_progress(++builtNodes, totalNodes))
+            cancelled = true;
 
         for(size_t i = 0; i < node->nchildren; ++i)
             visitNode(node->children[i], rawPtr);
     };
 
     visitNode(root, nullptr);
+    if(cancelled)
+    {
+        outWidgets.clear();
+        if(error)
+            *error = QStringLiteral("Import cancelled.");
+        return false;
+    }
     resolveAnchors(outWidgets);
+    if(source)
+        source->captureBaseline();
     return true;
 }
 
@@ -1195,8 +1265,9 @@ bool Parser::instantiateStyle(const QString &path,
     }
 
     outWidgets.clear();
-    ScopedStyleContext styleContext(dataPath);
+    ScopedStyleContext styleContext(dataPath, m_styles ? m_styles->styles : nullptr);
     ScopedTemplateBindings templateBindings(root);
+    ScopedImageCache imageCache(m_images.get());
     buildWidgetsFromNode(targetNode, root, nullptr, dataPath, outWidgets, false);
     if(outWidgets.empty())
     {
@@ -1214,7 +1285,8 @@ QStringList Parser::listStyles(const QString &path, QString *error) const
     QStringList styles;
     QByteArray utf8Path = QFile::encodeName(path);
     char errBuf[256] = {0};
-    OTUINode *root = otui_parse_file(utf8Path.constData(), errBuf, sizeof(errBuf));
+    // Only the top level names are needed, so the node bodies are skipped.
+    OTUINode *root = otui_parse_headers(utf8Path.constData(), errBuf, sizeof(errBuf));
     if(!root)
     {
         if(error)
@@ -1235,56 +1307,168 @@ QStringList Parser::listStyles(const QString &path, QString *error) const
     return styles;
 }
 
+Parser::StyleSetPtr Parser::loadStyleSet(const QStringList &paths, const QString &dataPath, QStringList *errors) const
+{
+    auto entry = std::make_shared<StyleCacheEntry>();
+    entry->basePath = normalizePath(dataPath);
+    if(std::shared_ptr<StyleCacheEntry> base = ensureStyleCache(dataPath))
+    {
+        entry->nodesByName = base->nodesByName;
+        entry->base = std::move(base);
+    }
+
+    // Imported styles shadow data path styles of the same name.
+    QHash<QString, const OTUINode*> imported;
+    for(const QString &path : paths)
+    {
+        QByteArray utf8Path = QFile::encodeName(path);
+        char errBuf[256] = {0};
+        OTUINode *root = otui_parse_file(utf8Path.constData(), errBuf, sizeof(errBuf));
+        if(!root)
+        {
+            if(errors)
+                *errors << QStringLiteral("%1: %2").arg(path, QString::fromUtf8(errBuf).trimmed());
+            continue;
+        }
+        otui_resolve_all_inheritance(root);
+        entry->ownedTrees.emplace_back(root);
+        collectStyleNodes(root, imported);
+    }
+    for(auto it = imported.cbegin(); it != imported.cend(); ++it)
+        entry->nodesByName.insert(it.key(), it.value());
+
+    return std::make_shared<const StyleSet>(StyleSet{std::move(entry)});
+}
+
 Parser::WidgetPtr Parser::createPlaceholderWidget(const QString &fileStem) const
 {
     return createBaseWidget(fileStem, QString(), QString());
 }
 
-static void serializeNode(QTextStream &stream, const OTUI::Widget *widget)
+namespace {
+// Buffered UTF-8 output for saveToFile(). Values are appended straight into
+// one reused buffer that goes to the device in large blocks.
+class OtuiWriter
 {
-    stream << widget->getId() << Qt::endl;
-    stream << "  id: " << widget->getId() << Qt::endl;
-    stream << "  position: " << widget->x() << " " << widget->y() << Qt::endl;
-    stream << "  size: " << widget->width() << " " << widget->height() << Qt::endl;
-    stream << "  opacity: " << widget->opacity() << Qt::endl;
-    stream << "  visible: " << (widget->isVisible() ? "true" : "false") << Qt::endl;
+public:
+    explicit OtuiWriter(QIODevice *device)
+        : m_device(device)
+    {
+        m_buffer.reserve(kFlushSize + 4096);
+    }
+
+    OtuiWriter &operator<<(const char *text)
+    {
+        m_buffer.append(text);
+        return flushIfFull();
+    }
+
+    OtuiWriter &operator<<(char c)
+    {
+        m_buffer.append(c);
+        return flushIfFull();
+    }
+
+    OtuiWriter &operator<<(const QString &text)
+    {
+        // QStringEncoder appends into the buffer without a temporary QByteArray.
+        const qsizetype used = m_buffer.size();
+        m_buffer.resize(used + m_encoder.requiredSpace(text.size()));
+        char *end = m_encoder.appendToBuffer(m_buffer.data() + used, text);
+        m_buffer.resize(end - m_buffer.constData());
+        return flushIfFull();
+    }
+
+    OtuiWriter &operator<<(int value)
+    {
+        char digits[16];
+        const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        m_buffer.append(digits, result.ptr - digits);
+        return flushIfFull();
+    }
+
+    OtuiWriter &operator<<(float value)
+    {
+        // Same digits as QTextStream's default, and like it independent of
+        // the C locale, which Qt sets from the environment on Unix.
+        m_buffer.append(QByteArray::number(static_cast<double>(value), 'g', 6));
+        return flushIfFull();
+    }
+
+    bool flush()
+    {
+        if(m_buffer.isEmpty())
+            return m_ok;
+        m_ok = m_ok && m_device->write(m_buffer) == m_buffer.size();
+        m_written += m_buffer.size();
+        m_buffer.clear();
+        return m_ok;
+    }
+
+    qint64 bytesWritten() const { return m_written + m_buffer.size(); }
+
+private:
+    static constexpr qsizetype kFlushSize = 64 * 1024;
+
+    OtuiWriter &flushIfFull()
+    {
+        if(m_buffer.size() >= kFlushSize)
+            flush();
+        return *this;
+    }
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    QStringEncoder m_encoder{QStringEncoder::Utf8};
+    qint64 m_written = 0;
+    bool m_ok = true;
+};
+
+void serializeNode(OtuiWriter &out, const OTUI::Widget *widget)
+{
+    out << widget->getId() << '\n';
+    out << "  id: " << widget->getId() << '\n';
+    out << "  position: " << widget->x() << ' ' << widget->y() << '\n';
+    out << "  size: " << widget->width() << ' ' << widget->height() << '\n';
+    out << "  opacity: " << widget->opacity() << '\n';
+    out << "  visible: " << (widget->isVisible() ? "true" : "false") << '\n';
     if(widget->supportsTextProperty())
     {
         const QString text = widget->textProperty();
         if(!text.isEmpty())
-            stream << "  text: " << text << Qt::endl;
+            out << "  text: " << text << '\n';
     }
     if(!widget->imageSource().isEmpty())
-        stream << "  image-source: " << widget->imageSource() << Qt::endl;
+        out << "  image-source: " << widget->imageSource() << '\n';
     if(!widget->getImageCrop().isNull())
     {
         const QRect crop = widget->getImageCrop();
-        stream << "  image-clip: "
-               << crop.x() << " " << crop.y() << " "
-               << crop.width() << " " << crop.height() << Qt::endl;
+        out << "  image-clip: "
+            << crop.x() << ' ' << crop.y() << ' '
+            << crop.width() << ' ' << crop.height() << '\n';
     }
     if(!widget->getImageBorder().isNull())
     {
         const QRect border = widget->getImageBorder();
-        stream << "  image-border: "
-               << border.x() << " " << border.y() << " "
-               << border.width() << " " << border.height() << Qt::endl;
+        out << "  image-border: "
+            << border.x() << ' ' << border.y() << ' '
+            << border.width() << ' ' << border.height() << '\n';
     }
 
     if(widget->isPhantom())
-        stream << "  phantom: true" << Qt::endl;
+        out << "  phantom: true\n";
 
     const QString colorValue = widget->colorString();
     if(!colorValue.isEmpty())
-        stream << "  color: " << colorValue << Qt::endl;
+        out << "  color: " << colorValue << '\n';
 
     auto writeEdgeGroup = [&](const char *prefix, const OTUI::EdgeGroup<int> &group) {
         if(group.top == 0 && group.right == 0 && group.bottom == 0 && group.left == 0)
             return;
-        stream << "  " << prefix << "-top: " << group.top << Qt::endl;
-        stream << "  " << prefix << "-right: " << group.right << Qt::endl;
-        stream << "  " << prefix << "-bottom: " << group.bottom << Qt::endl;
-        stream << "  " << prefix << "-left: " << group.left << Qt::endl;
+        out << "  " << prefix << "-top: " << group.top << '\n';
+        out << "  " << prefix << "-right: " << group.right << '\n';
+        out << "  " << prefix << "-bottom: " << group.bottom << '\n';
+        out << "  " << prefix << "-left: " << group.left << '\n';
     };
 
     writeEdgeGroup("margin", widget->margin());
@@ -1292,17 +1476,17 @@ static void serializeNode(QTextStream &stream, const OTUI::Widget *widget)
 
     const QString fillTarget = widget->fillTarget();
     if(!fillTarget.isEmpty())
-        stream << "  anchors.fill: " << fillTarget << Qt::endl;
+        out << "  anchors.fill: " << fillTarget << '\n';
 
     const QString centerTarget = widget->centerInTarget();
     if(!centerTarget.isEmpty())
-        stream << "  anchors.centerIn: " << centerTarget << Qt::endl;
+        out << "  anchors.centerIn: " << centerTarget << '\n';
 
     auto writeAnchor = [&](OTUI::AnchorEdge edge, const char *name) {
         const QString descriptor = widget->anchorDescriptor(edge);
         if(descriptor.isEmpty())
             return;
-        stream << "  anchors." << name << ": " << descriptor << Qt::endl;
+        out << "  anchors." << name << ": " << descriptor << '\n';
     };
 
     if(fillTarget.isEmpty())
@@ -1319,10 +1503,11 @@ static void serializeNode(QTextStream &stream, const OTUI::Widget *widget)
         writeAnchor(OTUI::AnchorEdge::VerticalCenter, "verticalCenter");
     }
 
-    stream << Qt::endl;
+    out << '\n';
+}
 }
 
-bool Parser::saveToFile(const QString& path, const WidgetList& widgets, QString* error) const
+bool Parser::saveToFile(const QString& path, const WidgetList& widgets, QString* error, SaveStats* stats) const
 {
     if(path.isEmpty()) {
         if(error) {
@@ -1331,7 +1516,11 @@ bool Parser::saveToFile(const QString& path, const WidgetList& widgets, QString*
         return false;
     }
 
-    QFile file(path);
+    QElapsedTimer timer;
+    timer.start();
+
+    // The destination is only replaced once everything has been written.
+    QSaveFile file(path);
     if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         if(error) {
             *error = QObject::tr("Unable to save file: %1").arg(file.errorString());
@@ -1339,17 +1528,30 @@ bool Parser::saveToFile(const QString& path, const WidgetList& widgets, QString*
         return false;
     }
 
-    QTextStream stream(&file);
-    stream.setEncoding(QStringConverter::Utf8);
-    stream << "# OTUIEditor export\n";
+    OtuiWriter out(&file);
+    out << "# OTUIEditor export\n";
 
+    int written = 0;
     for(const auto& widget : widgets) {
         if(!widget) {
             continue;
         }
-        serializeNode(stream, widget.get());
+        serializeNode(out, widget.get());
+        ++written;
+    }
+
+    if(!out.flush() || !file.commit()) {
+        if(error) {
+            *error = QObject::tr("Unable to save file: %1").arg(file.errorString());
+        }
+        return false;
     }
 
+    if(stats) {
+        stats->widgets = written;
+        stats->bytes = out.bytesWritten();
+        stats->elapsedMs = timer.elapsed();
+    }
     return true;
 }
 
@@ -1,6 +1,7 @@
 #ifndef OTUIPARSER_H
 #define OTUIPARSER_H
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -10,29 +11,62 @@
 #include "widget.h"
 
 namespace OTUI {
+class ImageCache;
+class SourceDocument;
+struct StyleSet;
+
 class Parser
 {
 public:
     using WidgetPtr = std::unique_ptr<Widget>;
     using WidgetList = std::vector<WidgetPtr>;
+    // Reports widgets built so far out of the nodes in the file; returning
+    // false cancels loadFromFile(). Runs on the loading thread.
+    using ProgressHandler = std::function<bool(int done, int total)>;
+    using StyleSetPtr = std::shared_ptr<const StyleSet>;
+    using ImageCachePtr = std::shared_ptr<ImageCache>;
+
+    struct SaveStats {
+        int widgets = 0;
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+    };
 
     Parser() = default;
     ~Parser() = default;
 
+    // With source, the file bytes and the node of each widget are kept for a lossless save.
     bool loadFromFile(const QString& path,
                       WidgetList& outWidgets,
                       QString* error = nullptr,
-                      const QString& dataPath = QString()) const;
-    bool saveToFile(const QString& path, const WidgetList& widgets, QString* error = nullptr) const;
+                      const QString& dataPath = QString(),
+                      SourceDocument* source = nullptr) const;
+    // Writes to a temporary file that replaces path only once complete.
+    bool saveToFile(const QString& path, const WidgetList& widgets, QString* error = nullptr, SaveStats* stats = nullptr) const;
     bool instantiateStyle(const QString& path,
                           const QString& styleName,
                           WidgetList& outWidgets,
                           QString* error = nullptr,
                           const QString& dataPath = QString()) const;
     QStringList listStyles(const QString& path, QString* error = nullptr) const;
+    // Parses the style files a module imports with g_ui.importStyle once, on
+    // top of the data path styles. The set is read only and can be shared by
+    // parsers on several threads.
+    StyleSetPtr loadStyleSet(const QStringList& paths, const QString& dataPath, QStringList* errors = nullptr) const;
+
+    void setProgressHandler(ProgressHandler handler) { m_progress = std::move(handler); }
+    // Styles used instead of the data path ones by the following loads.
+    void setStyleSet(StyleSetPtr styles) { m_styles = std::move(styles); }
+    // Decoded images shared by the loads of one import; off the GUI thread
+    // without one, every widget reads its image itself.
+    void setImageCache(ImageCachePtr images) { m_images = std::move(images); }
 
 private:
     WidgetPtr createPlaceholderWidget(const QString& fileStem) const;
+
+    ProgressHandler m_progress;
+    StyleSetPtr m_styles;
+    ImageCachePtr m_images;
 };
 }
 
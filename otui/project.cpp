@@ -1,6 +1,7 @@
 #include "project.h"
 
 #include <QDebug>
+#include <QSaveFile>
 
 OTUI::Project::Project() {}
 
@@ -21,6 +22,8 @@ OTUI::Project::Project(QString fileName, QString name, QString path, QString dat
     QDataStream data(m_File);
     data << m_Name;
     data << dataPath;
+    data << static_cast<qint32>(m_TextureBudget);
+    data << static_cast<qint32>(m_HistoryLimit) << static_cast<qint32>(m_MergeInterval);
     m_File->flush();
 }
 
@@ -28,6 +31,25 @@ OTUI::Project::Project(QDataStream &data, QString fileName, QString path)
 {
     data >> m_Name;
     data >> m_Data;
+    // Projects saved before these were settings end early.
+    if(!data.atEnd())
+    {
+        qint32 budget = 0;
+        data >> budget;
+        if(data.status() == QDataStream::Ok && budget > 0)
+            m_TextureBudget = budget;
+    }
+    if(!data.atEnd())
+    {
+        qint32 historyLimit = 0;
+        qint32 mergeInterval = -1;
+        data >> historyLimit >> mergeInterval;
+        if(data.status() == QDataStream::Ok && historyLimit > 0 && mergeInterval >= 0)
+        {
+            m_HistoryLimit = historyLimit;
+            m_MergeInterval = mergeInterval;
+        }
+    }
     m_Path = path;
 
     m_File = new QFile(path + "/" + fileName);
@@ -47,26 +69,24 @@ bool OTUI::Project::save()
     if(!m_File)
         return false;
 
-    // Create backup
-    if(!QFile::copy(m_File->fileName(), m_File->fileName() + ".backup"))
+    // Written next to the project and renamed over it, so a failed save keeps the old file.
+    QSaveFile file(m_File->fileName());
+    if(!file.open(QIODevice::WriteOnly))
         return false;
 
-    // Clear file content
-    m_File->resize(0);
-
-    // Write new data
-    QDataStream data(m_File);
+    QDataStream data(&file);
     data << m_Name;
     data << m_Data;
+    data << static_cast<qint32>(m_TextureBudget);
+    data << static_cast<qint32>(m_HistoryLimit) << static_cast<qint32>(m_MergeInterval);
+
+    // The open handle would block the rename on Windows; reopening also makes
+    // it refer to the file that replaced the old one.
+    m_File->close();
+    const bool committed = file.commit();
+    if(!m_File->open(QIODevice::ReadWrite) || !committed)
+        return false;
 
-    // Save file
-    if(m_File->flush())
-    {
-        // Remove backup
-        QFile::remove(m_File->fileName() + ".backup");
-        setChanged(false);
-        return true;
-    }
-
-    return false;
+    setChanged(false);
+    return true;
 }
@@ -53,6 +53,33 @@ namespace OTUI {
             m_Data = v;
         }
 
+        // Pixmap budget of the shared TextureManager, in MiB.
+        int getTextureBudget() const {
+            return m_TextureBudget;
+        }
+
+        void setTextureBudget(int mib) {
+            m_TextureBudget = mib;
+        }
+
+        // Memory each document's undo history may use, in MiB.
+        int getHistoryLimit() const {
+            return m_HistoryLimit;
+        }
+
+        void setHistoryLimit(int mib) {
+            m_HistoryLimit = mib;
+        }
+
+        // Window in ms within which consecutive edits merge into one undo step.
+        int getMergeInterval() const {
+            return m_MergeInterval;
+        }
+
+        void setMergeInterval(int msecs) {
+            m_MergeInterval = msecs;
+        }
+
         QFile *getProjectFile() {
             return m_File;
         }
@@ -62,6 +89,9 @@ namespace OTUI {
         QString m_Name;
         QString m_Path;
         QString m_Data;
+        int m_TextureBudget = 256;
+        int m_HistoryLimit = 16;
+        int m_MergeInterval = 1000;
         QFile *m_File = nullptr;
 
     };
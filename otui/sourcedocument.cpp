@@ -0,0 +1,541 @@
+#include "sourcedocument.h"
+
+#include <QFile>
+#include <QObject>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+
+#include "../thirdparty/otui/otui_parser.h"
+
+namespace {
+using PropertyList = QVector<QPair<QByteArray, QByteArray>>;
+
+void appendProperty(QByteArray &out, const char *key, const QByteArray &value)
+{
+    out.append(key).append('\0').append(value).append('\0');
+}
+
+void appendProperty(QByteArray &out, const char *key, const QString &value)
+{
+    appendProperty(out, key, value.toUtf8());
+}
+
+QByteArray joinNumbers(std::initializer_list<int> values)
+{
+    QByteArray joined;
+    for(int value : values)
+    {
+        if(!joined.isEmpty())
+            joined.append(' ');
+        joined.append(QByteArray::number(value));
+    }
+    return joined;
+}
+
+// Same keys and formatting as Parser::saveToFile(), as key\0value\0 pairs.
+QByteArray encodeProperties(const OTUI::Widget &widget)
+{
+    QByteArray out;
+    appendProperty(out, "id", widget.getId());
+    appendProperty(out, "position", joinNumbers({widget.x(), widget.y()}));
+    appendProperty(out, "size", joinNumbers({widget.width(), widget.height()}));
+    appendProperty(out, "opacity", QByteArray::number(static_cast<double>(widget.opacity()), 'g', 6));
+    appendProperty(out, "visible", QByteArray(widget.isVisible() ? "true" : "false"));
+    if(widget.supportsTextProperty() && !widget.textProperty().isEmpty())
+        appendProperty(out, "text", widget.textProperty());
+    if(!widget.imageSource().isEmpty())
+        appendProperty(out, "image-source", widget.imageSource());
+    const QRect crop = widget.getImageCrop();
+    if(!crop.isNull())
+        appendProperty(out, "image-clip", joinNumbers({crop.x(), crop.y(), crop.width(), crop.height()}));
+    const QRect border = widget.getImageBorder();
+    if(!border.isNull())
+        appendProperty(out, "image-border", joinNumbers({border.x(), border.y(), border.width(), border.height()}));
+    if(widget.isPhantom())
+        appendProperty(out, "phantom", QByteArray("true"));
+    const QString color = widget.colorString();
+    if(!color.isEmpty())
+        appendProperty(out, "color", color);
+
+    auto appendEdgeGroup = [&](const char *top, const char *right, const char *bottom, const char *left,
+                               const OTUI::EdgeGroup<int> &group) {
+        if(group.top == 0 && group.right == 0 && group.bottom == 0 && group.left == 0)
+            return;
+        appendProperty(out, top, QByteArray::number(group.top));
+        appendProperty(out, right, QByteArray::number(group.right));
+        appendProperty(out, bottom, QByteArray::number(group.bottom));
+        appendProperty(out, left, QByteArray::number(group.left));
+    };
+    appendEdgeGroup("margin-top", "margin-right", "margin-bottom", "margin-left", widget.margin());
+    appendEdgeGroup("padding-top", "padding-right", "padding-bottom", "padding-left", widget.padding());
+
+    const QString fillTarget = widget.fillTarget();
+    if(!fillTarget.isEmpty())
+        appendProperty(out, "anchors.fill", fillTarget);
+    const QString centerTarget = widget.centerInTarget();
+    if(!centerTarget.isEmpty())
+        appendProperty(out, "anchors.centerIn", centerTarget);
+
+    auto appendAnchor = [&](OTUI::AnchorEdge edge, const char *key) {
+        const QString descriptor = widget.anchorDescriptor(edge);
+        if(!descriptor.isEmpty())
+            appendProperty(out, key, descriptor);
+    };
+    if(fillTarget.isEmpty())
+    {
+        appendAnchor(OTUI::AnchorEdge::Left, "anchors.left");
+        appendAnchor(OTUI::AnchorEdge::Right, "anchors.right");
+        appendAnchor(OTUI::AnchorEdge::Top, "anchors.top");
+        appendAnchor(OTUI::AnchorEdge::Bottom, "anchors.bottom");
+    }
+    if(centerTarget.isEmpty())
+    {
+        appendAnchor(OTUI::AnchorEdge::HorizontalCenter, "anchors.horizontalCenter");
+        appendAnchor(OTUI::AnchorEdge::VerticalCenter, "anchors.verticalCenter");
+    }
+    return out;
+}
+
+PropertyList decodeProperties(const QByteArray &encoded)
+{
+    PropertyList properties;
+    qsizetype pos = 0;
+    while(pos < encoded.size())
+    {
+        const qsizetype keyEnd = encoded.indexOf('\0', pos);
+        const qsizetype valueEnd = encoded.indexOf('\0', keyEnd + 1);
+        properties.append({encoded.mid(pos, keyEnd - pos), encoded.mid(keyEnd + 1, valueEnd - keyEnd - 1)});
+        pos = valueEnd + 1;
+    }
+    return properties;
+}
+
+const QByteArray *findProperty(const PropertyList &properties, const QByteArray &key)
+{
+    for(const auto &property : properties)
+    {
+        if(property.first == key)
+            return &property.second;
+    }
+    return nullptr;
+}
+}
+
+struct OTUI::SourceDocument::Edit
+{
+    enum Kind { Properties, Subtree, Delete };
+
+    qint64 begin = 0;
+    qint64 end = 0;
+    Kind kind = Properties;
+    int depth = 0;
+    QByteArray text;
+    // Widgets whose node starts at the given offset into text.
+    QVector<QPair<const OTUI::Widget*, qint64>> created;
+};
+
+bool OTUI::SourceDocument::load(const QString &path, QString *error)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+            *error = QObject::tr("Unable to read %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    m_source = file.readAll();
+    m_nodes.clear();
+    m_index.clear();
+    m_loaded = true;
+    return true;
+}
+
+void OTUI::SourceDocument::bind(const Widget *widget, const OTUINode *node)
+{
+    if(!m_loaded || !widget || !node || node->src_begin < 0)
+        return;
+    appendNode(widget, node, m_index.value(widget->getParent(), -1));
+}
+
+void OTUI::SourceDocument::appendNode(const Widget *widget, const OTUINode *node, int parent)
+{
+    Node entry;
+    entry.widget = widget;
+    entry.parent = parent;
+    entry.indent = node->indent;
+    entry.begin = node->src_begin;
+    entry.propsEnd = node->src_props_end;
+    entry.end = node->src_end;
+    // Properties added by inheritance have no span and are left to the base style.
+    for(size_t i = 0; i < node->nprops; ++i)
+    {
+        const OTUIProp &prop = node->props[i];
+        if(prop.line_begin < 0)
+            continue;
+        entry.properties.insert(QByteArray(prop.key),
+                                PropertySpan{prop.line_begin, prop.line_end, prop.value_begin, prop.value_end});
+    }
+    m_index.insert(widget, static_cast<int>(m_nodes.size()));
+    m_nodes.push_back(std::move(entry));
+}
+
+void OTUI::SourceDocument::captureBaseline()
+{
+    for(Node &node : m_nodes)
+    {
+        if(node.widget)
+            node.baseline = encodeProperties(*node.widget);
+    }
+}
+
+void OTUI::SourceDocument::forget(const Widget *widget)
+{
+    // A parked subtree goes with its root; one inside it is forgotten there.
+    if(m_parked.remove(widget) > 0)
+        return;
+    for(const std::shared_ptr<SourceDocument> &parked : std::as_const(m_parked))
+        parked->forget(widget);
+
+    const int index = m_index.value(widget, -1);
+    if(index < 0)
+        return;
+    // Nodes are in document order, so the subtree directly follows its root.
+    QSet<int> subtree{index};
+    for(int i = index; i < static_cast<int>(m_nodes.size()); ++i)
+    {
+        if(i != index && !subtree.contains(m_nodes[i].parent))
+            break;
+        subtree.insert(i);
+        m_index.remove(m_nodes[i].widget);
+        m_nodes[i].widget = nullptr;
+    }
+}
+
+std::shared_ptr<OTUI::SourceDocument> OTUI::SourceDocument::cutSubtree(int index) const
+{
+    auto cut = std::make_shared<SourceDocument>();
+    const Node &root = m_nodes[index];
+    cut->m_source = m_source.mid(root.begin, root.end - root.begin);
+    cut->m_loaded = true;
+
+    QHash<int, int> cutIndex;
+    for(int i = index; i < static_cast<int>(m_nodes.size()); ++i)
+    {
+        if(i != index && !cutIndex.contains(m_nodes[i].parent))
+            break;
+        Node node = m_nodes[i];
+        node.parent = i == index ? -1 : cutIndex.value(node.parent);
+        node.begin -= root.begin;
+        node.propsEnd -= root.begin;
+        node.end -= root.begin;
+        for(PropertySpan &span : node.properties)
+        {
+            span.lineBegin -= root.begin;
+            span.lineEnd -= root.begin;
+            span.valueBegin -= root.begin;
+            span.valueEnd -= root.begin;
+        }
+        cutIndex.insert(i, static_cast<int>(cut->m_nodes.size()));
+        if(node.widget)
+            cut->m_index.insert(node.widget, static_cast<int>(cut->m_nodes.size()));
+        cut->m_nodes.push_back(std::move(node));
+    }
+    return cut;
+}
+
+void OTUI::SourceDocument::appendNewNode(Edit &edit, const Widget *widget, int indent, const QSet<const Widget*> &live,
+                                         const ChildMap &newChildren, ParkedMap &parked) const
+{
+    // A subtree back on the canvas is written from the bytes it was cut
+    // from, as long as it lands at the same depth.
+    const auto cut = m_parked.constFind(widget);
+    if(cut != m_parked.cend() && (*cut)->m_nodes.front().indent == indent)
+    {
+        QHash<qint64, const Widget*> offsets;
+        const QByteArray text = (*cut)->render(live, newChildren, {}, offsets, parked, nullptr);
+        for(auto it = offsets.cbegin(); it != offsets.cend(); ++it)
+            edit.created.append({it.value(), edit.text.size() + it.key()});
+        edit.text.append(text);
+        if(!edit.text.endsWith('\n'))
+            edit.text.append('\n');
+        return;
+    }
+
+    edit.created.append({widget, edit.text.size()});
+    const QByteArray margin(indent, ' ');
+    edit.text.append(margin).append(OTUI::widgetClassName(widget).toUtf8()).append('\n');
+    for(const auto &property : decodeProperties(encodeProperties(*widget)))
+        edit.text.append(margin).append("  ").append(property.first).append(": ").append(property.second).append('\n');
+    for(const Widget *child : newChildren.value(widget))
+        appendNewNode(edit, child, indent + 2, live, newChildren, parked);
+}
+
+QVector<const OTUI::Widget*> OTUI::SourceDocument::widgetOrder() const
+{
+    QVector<const Widget*> order;
+    order.reserve(static_cast<int>(m_nodes.size()));
+    for(const Node &node : m_nodes)
+        order.append(node.widget);
+    return order;
+}
+
+int OTUI::SourceDocument::childIndent(int index) const
+{
+    const int next = index + 1;
+    if(next < static_cast<int>(m_nodes.size()) && m_nodes[next].parent == index)
+        return m_nodes[next].indent;
+    return m_nodes[index].indent + 2;
+}
+
+bool OTUI::SourceDocument::save(const QString &path, const std::vector<std::unique_ptr<Widget>> &widgets,
+                                QString *error, SaveStats *stats)
+{
+    if(!m_loaded)
+    {
+        if(error)
+            *error = QObject::tr("The document has to be imported again before it can be saved.");
+        return false;
+    }
+
+    QSet<const Widget*> live;
+    live.reserve(static_cast<int>(widgets.size()));
+    for(const auto &widget : widgets)
+        live.insert(widget.get());
+
+    // Widgets inside a parked subtree are written along with its root.
+    QSet<const Widget*> parkedWidgets;
+    for(auto it = m_parked.cbegin(); it != m_parked.cend(); ++it)
+    {
+        for(auto bound = it.value()->m_index.cbegin(); bound != it.value()->m_index.cend(); ++bound)
+        {
+            if(bound.key() != it.key())
+                parkedWidgets.insert(bound.key());
+        }
+    }
+
+    ChildMap newChildren;
+    QVector<const Widget*> newRoots;
+    for(const auto &widget : widgets)
+    {
+        if(m_index.contains(widget.get()) || parkedWidgets.contains(widget.get()))
+            continue;
+        if(widget->getParent())
+            newChildren[widget->getParent()].append(widget.get());
+        else
+            newRoots.append(widget.get());
+    }
+
+    QHash<qint64, const Widget*> widgetsByOffset;
+    ParkedMap parked;
+    const QByteArray output = render(live, newChildren, newRoots, widgetsByOffset, parked, stats);
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(output) != output.size() || !file.commit())
+    {
+        if(error)
+            *error = QObject::tr("Unable to save file: %1").arg(file.errorString());
+        return false;
+    }
+
+    // Subtrees still off the canvas stay parked; those that came back are in the file again.
+    for(auto it = m_parked.cbegin(); it != m_parked.cend(); ++it)
+    {
+        if(!live.contains(it.key()))
+            parked.insert(it.key(), it.value());
+    }
+    m_parked = std::move(parked);
+
+    // Spans are taken again from what was written, so the next save starts
+    // from the new file.
+    const QByteArray encodedPath = QFile::encodeName(path);
+    char errBuf[256] = {0};
+    std::unique_ptr<OTUINode, decltype(&otui_free)> root(otui_parse_file(encodedPath.constData(), errBuf, sizeof(errBuf)), otui_free);
+    m_source = output;
+    m_nodes.clear();
+    m_index.clear();
+    if(root)
+        bindTree(root.get(), -1, widgetsByOffset);
+    captureBaseline();
+    if(m_index.size() != widgetsByOffset.size())
+    {
+        // Widgets that could not be found again would be written twice next time.
+        m_loaded = false;
+        if(error)
+            *error = QObject::tr("Saved, but %1 could not be read back: %2").arg(path, QString::fromUtf8(errBuf).trimmed());
+    }
+    return true;
+}
+
+QByteArray OTUI::SourceDocument::render(const QSet<const Widget*> &live, const ChildMap &newChildren,
+                                        const QVector<const Widget*> &newRoots, QHash<qint64, const Widget*> &widgetsByOffset,
+                                        ParkedMap &parked, SaveStats *stats) const
+{
+    std::vector<Edit> edits;
+    std::vector<bool> removed(m_nodes.size(), false);
+    std::vector<int> depth(m_nodes.size(), 0);
+    QVector<QByteArray> current(static_cast<int>(m_nodes.size()));
+    int editedWidgets = 0;
+
+    for(int i = 0; i < static_cast<int>(m_nodes.size()); ++i)
+    {
+        const Node &node = m_nodes[i];
+        if(node.parent >= 0)
+        {
+            depth[i] = depth[node.parent] + 1;
+            if(removed[node.parent])
+            {
+                removed[i] = true;
+                continue;
+            }
+        }
+        if(!node.widget || !live.contains(node.widget))
+        {
+            // Still bound means still held, e.g. by the undo history.
+            if(node.widget)
+                parked.insert(node.widget, cutSubtree(i));
+            removed[i] = true;
+            edits.push_back({node.begin, node.end, Edit::Delete, depth[i], {}, {}});
+            continue;
+        }
+
+        current[i] = encodeProperties(*node.widget);
+        if(current[i] != node.baseline)
+        {
+            ++editedWidgets;
+            const PropertyList before = decodeProperties(node.baseline);
+            const PropertyList after = decodeProperties(current[i]);
+            QByteArray indent(node.indent + 2, ' ');
+            if(!node.properties.isEmpty())
+            {
+                const qint64 lineBegin = node.properties.cbegin()->lineBegin;
+                qint64 lead = lineBegin;
+                while(lead < m_source.size() && (m_source[lead] == ' ' || m_source[lead] == '\t'))
+                    ++lead;
+                indent = m_source.mid(lineBegin, lead - lineBegin);
+            }
+
+            QByteArray added;
+            for(const auto &property : after)
+            {
+                const QByteArray *old = findProperty(before, property.first);
+                if(old && *old == property.second)
+                    continue;
+                const auto span = node.properties.constFind(property.first);
+                if(span == node.properties.cend())
+                    added.append(indent).append(property.first).append(": ").append(property.second).append('\n');
+                else if(m_source.mid(span->valueBegin, span->valueEnd - span->valueBegin) != property.second)
+                    edits.push_back({span->valueBegin, span->valueEnd, Edit::Properties, depth[i], property.second, {}});
+            }
+            for(const auto &property : before)
+            {
+                if(findProperty(after, property.first))
+                    continue;
+                const auto span = node.properties.constFind(property.first);
+                if(span != node.properties.cend())
+                    edits.push_back({span->lineBegin, span->lineEnd, Edit::Delete, depth[i], {}, {}});
+            }
+            if(!added.isEmpty())
+            {
+                if(node.propsEnd == m_source.size() && !m_source.endsWith('\n'))
+                    added.prepend('\n');
+                edits.push_back({node.propsEnd, node.propsEnd, Edit::Properties, depth[i], added, {}});
+            }
+        }
+
+        const auto children = newChildren.constFind(node.widget);
+        if(children != newChildren.cend())
+        {
+            Edit edit{node.end, node.end, Edit::Subtree, depth[i], {}, {}};
+            if(node.end == m_source.size() && !m_source.endsWith('\n'))
+                edit.text.append('\n');
+            for(const Widget *child : *children)
+                appendNewNode(edit, child, childIndent(i), live, newChildren, parked);
+            edits.push_back(std::move(edit));
+        }
+    }
+
+    if(!newRoots.isEmpty())
+    {
+        Edit edit{m_source.size(), m_source.size(), Edit::Subtree, 0, {}, {}};
+        if(!m_source.isEmpty() && !m_source.endsWith('\n'))
+            edit.text.append('\n');
+        for(const Widget *root : std::as_const(newRoots))
+        {
+            if(!edit.text.isEmpty() && !edit.text.endsWith("\n\n"))
+                edit.text.append('\n');
+            appendNewNode(edit, root, 0, live, newChildren, parked);
+        }
+        edits.push_back(std::move(edit));
+    }
+
+    // Insertions at an offset go before a node deleted from there, and a
+    // parent's new children before those of an enclosing node.
+    std::stable_sort(edits.begin(), edits.end(), [](const Edit &a, const Edit &b) {
+        if(a.begin != b.begin)
+            return a.begin < b.begin;
+        if(a.kind != b.kind)
+            return a.kind < b.kind;
+        return a.depth > b.depth;
+    });
+
+    QByteArray output;
+    qint64 reserve = m_source.size();
+    for(const Edit &edit : edits)
+        reserve += edit.text.size();
+    output.reserve(reserve);
+
+    qint64 cursor = 0;
+    qint64 copied = 0;
+    for(const Edit &edit : edits)
+    {
+        if(edit.begin < cursor)
+            continue;
+        output.append(m_source.constData() + cursor, edit.begin - cursor);
+        copied += edit.begin - cursor;
+        for(const auto &created : edit.created)
+            widgetsByOffset.insert(output.size() + created.second, created.first);
+        output.append(edit.text);
+        cursor = edit.end;
+    }
+    output.append(m_source.constData() + cursor, m_source.size() - cursor);
+    copied += m_source.size() - cursor;
+
+    // Kept nodes move by the size change of every edit that ends before them.
+    qint64 delta = 0;
+    size_t nextEdit = 0;
+    for(int i = 0; i < static_cast<int>(m_nodes.size()); ++i)
+    {
+        if(removed[i])
+            continue;
+        const Node &node = m_nodes[i];
+        for(; nextEdit < edits.size() && edits[nextEdit].end <= node.begin; ++nextEdit)
+            delta += edits[nextEdit].text.size() - (edits[nextEdit].end - edits[nextEdit].begin);
+        widgetsByOffset.insert(node.begin + delta, node.widget);
+    }
+
+    if(stats)
+    {
+        stats->editedWidgets = editedWidgets;
+        stats->edits = static_cast<int>(edits.size());
+        stats->bytesCopied = copied;
+        stats->bytesWritten = output.size();
+    }
+    return output;
+}
+
+void OTUI::SourceDocument::bindTree(const OTUINode *node, int parent, const QHash<qint64, const Widget*> &widgetsByOffset)
+{
+    for(size_t i = 0; i < node->nchildren; ++i)
+    {
+        const OTUINode *child = node->children[i];
+        int index = parent;
+        const Widget *widget = widgetsByOffset.value(child->src_begin);
+        if(widget)
+        {
+            index = static_cast<int>(m_nodes.size());
+            appendNode(widget, child, parent);
+        }
+        bindTree(child, index, widgetsByOffset);
+    }
+}
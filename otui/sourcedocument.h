@@ -0,0 +1,96 @@
+#ifndef OTUISOURCEDOCUMENT_H
+#define OTUISOURCEDOCUMENT_H
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "widget.h"
+
+struct OTUINode;
+
+namespace OTUI {
+// Bytes of a loaded .otui file and the span each widget was read from.
+// save() copies the file verbatim except for the properties edited since it
+// was loaded, the widgets removed from the canvas and the widgets added to
+// it, so comments, ordering, states and events survive a round trip.
+class SourceDocument
+{
+public:
+    struct SaveStats {
+        int editedWidgets = 0;
+        int edits = 0;
+        qint64 bytesCopied = 0;
+        qint64 bytesWritten = 0;
+    };
+
+    bool load(const QString &path, QString *error = nullptr);
+    bool isLoaded() const { return m_loaded; }
+
+    // Called by the parser for each widget built from a node of the loaded file.
+    void bind(const Widget *widget, const OTUINode *node);
+    // Takes the current properties of the bound widgets as their unedited values.
+    void captureBaseline();
+    // The widget and its subtree are about to be destroyed. Widgets that are
+    // only off the canvas, e.g. held by an undoable delete, stay bound: a save
+    // cuts their nodes out of the file and keeps the bytes, and if they come
+    // back they are written from those bytes instead of as new nodes.
+    void forget(const Widget *widget);
+
+    bool save(const QString &path, const std::vector<std::unique_ptr<Widget>> &widgets,
+              QString *error = nullptr, SaveStats *stats = nullptr);
+
+    // Bound widgets in the order their nodes appear in the file, which is the
+    // order loading it again creates them; forgotten nodes hold nullptr.
+    QVector<const Widget*> widgetOrder() const;
+
+private:
+    struct PropertySpan {
+        qint64 lineBegin = 0;
+        qint64 lineEnd = 0;
+        qint64 valueBegin = 0;
+        qint64 valueEnd = 0;
+    };
+
+    struct Node {
+        const Widget *widget = nullptr;
+        int parent = -1;
+        int indent = 0;
+        qint64 begin = 0;
+        qint64 propsEnd = 0;
+        qint64 end = 0;
+        QHash<QByteArray, PropertySpan> properties;
+        QByteArray baseline;
+    };
+
+    using ChildMap = QHash<const Widget*, QVector<const Widget*>>;
+    // Subtrees cut out of the file while their widgets were off the canvas,
+    // by root widget, each a document of its own over the bytes cut.
+    using ParkedMap = QHash<const Widget*, std::shared_ptr<SourceDocument>>;
+    struct Edit;
+
+    void appendNode(const Widget *widget, const OTUINode *node, int parent);
+    void bindTree(const OTUINode *node, int parent, const QHash<qint64, const Widget*> &widgetsByOffset);
+    int childIndent(int index) const;
+    // The source with every edit applied. widgetsByOffset gets where each
+    // written node starts, parked the subtrees cut out on the way.
+    QByteArray render(const QSet<const Widget*> &live, const ChildMap &newChildren, const QVector<const Widget*> &newRoots,
+                      QHash<qint64, const Widget*> &widgetsByOffset, ParkedMap &parked, SaveStats *stats) const;
+    void appendNewNode(Edit &edit, const Widget *widget, int indent, const QSet<const Widget*> &live,
+                       const ChildMap &newChildren, ParkedMap &parked) const;
+    std::shared_ptr<SourceDocument> cutSubtree(int index) const;
+
+    QByteArray m_source;
+    std::vector<Node> m_nodes;
+    QHash<const Widget*, int> m_index;
+    ParkedMap m_parked;
+    bool m_loaded = false;
+};
+}
+
+#endif // OTUISOURCEDOCUMENT_H
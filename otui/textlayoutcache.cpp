@@ -0,0 +1,129 @@
+#include "textlayoutcache.h"
+
+#include <QFontMetrics>
+#include <QTextOption>
+#include <QTransform>
+#include <limits>
+
+namespace {
+// Entry counts; a layout holds the shaped glyph runs, a measurement is just a size.
+const int kMaxLayouts = 4096;
+const int kMaxMeasurements = 8192;
+
+qreal alignedOffset(qreal available, qreal used, Qt::Alignment alignment, Qt::Alignment trailing, Qt::Alignment center)
+{
+    if(alignment & trailing)
+        return available - used;
+    if(alignment & center)
+        return (available - used) / 2.0;
+    return 0.0;
+}
+}
+
+OTUI::TextLayoutCache &OTUI::TextLayoutCache::instance()
+{
+    static TextLayoutCache cache;
+    return cache;
+}
+
+OTUI::TextLayoutCache::TextLayoutCache()
+    : m_layouts(kMaxLayouts),
+      m_measurements(kMaxMeasurements)
+{
+}
+
+OTUI::TextLayoutCache::Layout OTUI::TextLayoutCache::layout(const QString &text, const QFont &font, const QSize &box, Qt::Alignment alignment, bool wrap)
+{
+    Key key;
+    key.text = text;
+    key.font = font.key();
+    key.width = box.width();
+    key.height = box.height();
+    key.alignment = static_cast<int>(alignment);
+    key.wrap = wrap;
+
+    QMutexLocker locker(&m_mutex);
+    if(const Layout *cached = m_layouts.object(key))
+    {
+        ++m_hits;
+        return *cached;
+    }
+    ++m_misses;
+    locker.unlock();
+
+    auto *entry = new Layout;
+    entry->text.setTextFormat(Qt::PlainText);
+    entry->text.setText(text);
+    QTextOption option;
+    option.setAlignment(alignment & Qt::AlignHorizontal_Mask);
+    option.setWrapMode(wrap ? QTextOption::WordWrap : QTextOption::NoWrap);
+    entry->text.setTextOption(option);
+    if(wrap)
+        entry->text.setTextWidth(box.width());
+    entry->text.prepare(QTransform(), font);
+
+    // Wrapped text is already aligned inside textWidth, only the vertical placement is left.
+    const QSizeF used = entry->text.size();
+    const qreal dx = wrap ? 0.0 : alignedOffset(box.width(), used.width(), alignment, Qt::AlignRight, Qt::AlignHCenter);
+    const qreal dy = alignedOffset(box.height(), used.height(), alignment, Qt::AlignBottom, Qt::AlignVCenter);
+    entry->offset = QPointF(dx, dy);
+
+    const Layout result = *entry;
+    locker.relock();
+    m_layouts.insert(key, entry, 1);
+    return result;
+}
+
+QSize OTUI::TextLayoutCache::measure(const QString &text, const QFont &font, int wrapWidth)
+{
+    Key key;
+    key.text = text;
+    key.font = font.key();
+    key.width = wrapWidth > 0 ? wrapWidth : 0;
+    key.wrap = wrapWidth > 0;
+
+    QMutexLocker locker(&m_mutex);
+    if(const QSize *cached = m_measurements.object(key))
+    {
+        ++m_hits;
+        return *cached;
+    }
+    ++m_misses;
+    locker.unlock();
+
+    const QFontMetrics metrics(font);
+    QRect bounds;
+    if(key.wrap)
+        bounds = metrics.boundingRect(QRect(0, 0, wrapWidth, std::numeric_limits<int>::max()), Qt::TextWordWrap, text);
+    else
+        bounds = metrics.boundingRect(text);
+
+    locker.relock();
+    m_measurements.insert(key, new QSize(bounds.size()), 1);
+    return bounds.size();
+}
+
+OTUI::TextLayoutCache::Stats OTUI::TextLayoutCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    Stats result;
+    result.hits = m_hits;
+    result.misses = m_misses;
+    result.layouts = m_layouts.size();
+    result.measurements = m_measurements.size();
+    return result;
+}
+
+void OTUI::TextLayoutCache::resetStats()
+{
+    QMutexLocker locker(&m_mutex);
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void OTUI::TextLayoutCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_layouts.clear();
+    m_measurements.clear();
+}
@@ -0,0 +1,76 @@
+#ifndef OTUITEXTLAYOUTCACHE_H
+#define OTUITEXTLAYOUTCACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QMutex>
+#include <QPointF>
+#include <QSize>
+#include <QStaticText>
+#include <QString>
+
+namespace OTUI {
+    // Shaped text shared by widget painting and text-auto-resize. Entries are
+    // keyed by everything that affects the layout, so editing a text, font,
+    // size, alignment or wrap property simply resolves to a different entry and
+    // the stale one ages out of the LRU.
+    class TextLayoutCache
+    {
+    public:
+        struct Layout {
+            QStaticText text;
+            // Top-left of the laid out block relative to the target box.
+            QPointF offset;
+        };
+
+        struct Stats {
+            quint64 hits = 0;
+            quint64 misses = 0;
+            int layouts = 0;
+            int measurements = 0;
+
+            double hitRate() const {
+                const quint64 total = hits + misses;
+                return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+            }
+        };
+
+        static TextLayoutCache &instance();
+
+        Layout layout(const QString &text, const QFont &font, const QSize &box, Qt::Alignment alignment, bool wrap);
+        // Bounding size of text; wrapWidth <= 0 measures a single unwrapped run.
+        QSize measure(const QString &text, const QFont &font, int wrapWidth);
+
+        Stats stats() const;
+        void resetStats();
+        void clear();
+
+    private:
+        TextLayoutCache();
+
+        struct Key {
+            QString text;
+            QString font;
+            int width = 0;
+            int height = 0;
+            int alignment = 0;
+            bool wrap = false;
+
+            bool operator==(const Key &other) const {
+                return width == other.width && height == other.height && alignment == other.alignment
+                        && wrap == other.wrap && font == other.font && text == other.text;
+            }
+            friend size_t qHash(const Key &key, size_t seed = 0) {
+                return qHashMulti(seed, key.text, key.font, key.width, key.height, key.alignment, key.wrap);
+            }
+        };
+
+        mutable QMutex m_mutex;
+        QCache<Key, Layout> m_layouts;
+        QCache<Key, QSize> m_measurements;
+        quint64 m_hits = 0;
+        quint64 m_misses = 0;
+    };
+}
+
+#endif // OTUITEXTLAYOUTCACHE_H
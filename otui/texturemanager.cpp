@@ -0,0 +1,172 @@
+#include "texturemanager.h"
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+const qint64 kDefaultBudget = 256 * 1024 * 1024;
+
+qint64 pixmapCost(const QImage &image)
+{
+    return std::max<qint64>(1, image.sizeInBytes() / 1024);
+}
+
+QByteArray pixelHash(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const int header[] = {image.width(), image.height(), static_cast<int>(image.format())};
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(header), sizeof(header)));
+    // Row by row; the padding at the end of each line is not part of the image.
+    const qsizetype rowBytes = (static_cast<qsizetype>(image.width()) * image.depth() + 7) / 8;
+    for(int y = 0; y < image.height(); ++y)
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(image.constScanLine(y)), rowBytes));
+    return hash.result();
+}
+}
+
+OTUI::TextureManager &OTUI::TextureManager::instance()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+OTUI::TextureManager::TextureManager()
+    : m_textures(static_cast<qsizetype>(kDefaultBudget / 1024))
+{
+}
+
+QPixmap OTUI::TextureManager::pixmap(const QString &path)
+{
+    const QString canonical = canonicalPath(path);
+    if(canonical.isEmpty())
+        return QPixmap();
+
+    const auto content = m_contents.constFind(canonical);
+    if(content != m_contents.cend())
+    {
+        if(const QPixmap *cached = m_textures.object(content.value()))
+        {
+            ++m_hits;
+            return *cached;
+        }
+    }
+
+    QImage image;
+    if(!image.load(canonical))
+        return QPixmap();
+    return insert(canonical, image);
+}
+
+QPixmap OTUI::TextureManager::adopt(const QString &path, const QImage &image)
+{
+    const QString canonical = canonicalPath(path);
+    if(canonical.isEmpty() || image.isNull())
+        return QPixmap();
+
+    const auto content = m_contents.constFind(canonical);
+    if(content != m_contents.cend())
+    {
+        if(const QPixmap *cached = m_textures.object(content.value()))
+        {
+            ++m_hits;
+            return *cached;
+        }
+    }
+    return insert(canonical, image);
+}
+
+bool OTUI::TextureManager::holds(const QString &path, const QPixmap &pixmap) const
+{
+    const QString canonical = m_canonical.value(path);
+    if(canonical.isEmpty())
+        return false;
+    const QByteArray hash = m_contents.value(canonical);
+    return !hash.isEmpty() && m_textures.contains(hash) && m_cacheKeys.value(hash) == pixmap.cacheKey();
+}
+
+void OTUI::TextureManager::setBudget(qint64 bytes)
+{
+    const int before = m_textures.count();
+    m_textures.setMaxCost(static_cast<qsizetype>(std::max<qint64>(1, bytes / 1024)));
+    evicted(before - m_textures.count());
+}
+
+OTUI::TextureManager::Stats OTUI::TextureManager::stats() const
+{
+    Stats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.shared = m_shared;
+    stats.evictions = m_evictions;
+    stats.textures = m_textures.count();
+    stats.bytes = static_cast<qint64>(m_textures.totalCost()) * 1024;
+    stats.budget = static_cast<qint64>(m_textures.maxCost()) * 1024;
+    return stats;
+}
+
+void OTUI::TextureManager::clear()
+{
+    m_textures.clear();
+    m_canonical.clear();
+    m_contents.clear();
+    m_cacheKeys.clear();
+    m_unpruned = 0;
+}
+
+QString OTUI::TextureManager::canonicalPath(const QString &path)
+{
+    const auto it = m_canonical.constFind(path);
+    if(it != m_canonical.cend())
+        return it.value();
+
+    // Empty for a missing file; not remembered, the file may appear later.
+    const QString canonical = QFileInfo(path).canonicalFilePath();
+    if(!canonical.isEmpty())
+        m_canonical.insert(path, canonical);
+    return canonical;
+}
+
+QPixmap OTUI::TextureManager::insert(const QString &canonical, const QImage &image)
+{
+    ++m_misses;
+    const QByteArray hash = pixelHash(image);
+    m_contents.insert(canonical, hash);
+    if(const QPixmap *cached = m_textures.object(hash))
+    {
+        ++m_shared;
+        return *cached;
+    }
+
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    const int before = m_textures.count();
+    // A pixmap larger than the whole budget is not kept, and evicts nothing.
+    if(!m_textures.insert(hash, new QPixmap(pixmap), static_cast<qsizetype>(pixmapCost(image))))
+    {
+        m_contents.remove(canonical);
+        return pixmap;
+    }
+    m_cacheKeys.insert(hash, pixmap.cacheKey());
+    evicted(before + 1 - m_textures.count());
+    return pixmap;
+}
+
+void OTUI::TextureManager::evicted(int count)
+{
+    if(count <= 0)
+        return;
+    m_evictions += count;
+
+    // Swept in batches; a sweep per eviction would make filling a full cache quadratic.
+    m_unpruned += count;
+    if(m_unpruned < std::max(64, m_textures.count() / 4))
+        return;
+    m_unpruned = 0;
+    for(auto it = m_cacheKeys.begin(); it != m_cacheKeys.end();)
+        it = m_textures.contains(it.key()) ? std::next(it) : m_cacheKeys.erase(it);
+    for(auto it = m_contents.begin(); it != m_contents.end();)
+        it = m_textures.contains(it.value()) ? std::next(it) : m_contents.erase(it);
+    for(auto it = m_canonical.begin(); it != m_canonical.end();)
+        it = m_contents.contains(it.value()) ? std::next(it) : m_canonical.erase(it);
+}
@@ -0,0 +1,71 @@
+#ifndef OTUITEXTUREMANAGER_H
+#define OTUITEXTUREMANAGER_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QString>
+
+namespace OTUI {
+    // Pixmaps of the images widgets draw. Paths are resolved to the file they
+    // name before lookup, and pixmaps are stored under a hash of their pixels,
+    // so the same image reached through a fallback root, a different spelling
+    // or a copy of the file is kept once. Least recently used pixmaps leave
+    // once the budget is exceeded. QPixmap is GUI thread only, so is this.
+    class TextureManager
+    {
+    public:
+        struct Stats {
+            quint64 hits = 0;
+            quint64 misses = 0;
+            // Misses whose pixels were already loaded from another path.
+            quint64 shared = 0;
+            quint64 evictions = 0;
+            int textures = 0;
+            qint64 bytes = 0;
+            qint64 budget = 0;
+        };
+
+        static TextureManager &instance();
+
+        // Null if the file cannot be read.
+        QPixmap pixmap(const QString &path);
+        // Same, for an image already decoded off the GUI thread.
+        QPixmap adopt(const QString &path, const QImage &image);
+
+        // Whether pixmap, loaded from path, is the one the cache keeps; if not,
+        // whoever holds it is its only owner.
+        bool holds(const QString &path, const QPixmap &pixmap) const;
+
+        void setBudget(qint64 bytes);
+        Stats stats() const;
+        void clear();
+
+    private:
+        TextureManager();
+
+        QString canonicalPath(const QString &path);
+        QPixmap insert(const QString &canonical, const QImage &image);
+        // Counts evicted textures and drops the lookups that led to them.
+        void evicted(int count);
+
+        // Cost in KiB.
+        QCache<QByteArray, QPixmap> m_textures;
+        // Path as asked for -> canonical file path.
+        QHash<QString, QString> m_canonical;
+        // Canonical file path -> pixel hash.
+        QHash<QString, QByteArray> m_contents;
+        // Pixel hash -> QPixmap::cacheKey() of the pixmap stored for it.
+        QHash<QByteArray, qint64> m_cacheKeys;
+        quint64 m_hits = 0;
+        quint64 m_misses = 0;
+        quint64 m_shared = 0;
+        quint64 m_evictions = 0;
+        // Evictions whose lookups are still in the hashes above.
+        int m_unpruned = 0;
+    };
+}
+
+#endif // OTUITEXTUREMANAGER_H
@@ -1,11 +1,22 @@
 #include "widget.h"
+#include "textlayoutcache.h"
+#include "bitmapfont.h"
+#include "mainwindow.h"
+#include "button.h"
+#include "label.h"
+#include "image.h"
+#include "item.h"
+#include "creature.h"
 #include "corewindow.h"
+#include "texturemanager.h"
+#include "imagecache.h"
+#include "guithread.h"
 
-#include <QPixmapCache>
 #include <QDir>
 #include <QFileInfo>
 #include <algorithm>
 #include <functional>
+#include <utility>
 #include <QStringList>
 
 namespace {
@@ -18,8 +29,11 @@ QString normalizeRootPath(const QString &path)
     return normalized;
 }
 
-QString g_modulesRootPath;
-QString g_moduleAssetsRoot;
+// Per thread so a background import can resolve its own module.
+thread_local QString g_modulesRootPath;
+thread_local QString g_moduleAssetsRoot;
+// Cache of the import building widgets on this thread, if any.
+thread_local OTUI::ImageCache *g_importImages = nullptr;
 
 }
 
@@ -35,6 +49,28 @@ void setModuleAssetsRoot(const QString &path)
     g_moduleAssetsRoot = normalizeRootPath(path);
 }
 
+ImageCache *setImportImageCache(ImageCache *cache)
+{
+    return std::exchange(g_importImages, cache);
+}
+
+QString widgetClassName(const Widget *widget)
+{
+    if(dynamic_cast<const MainWindow*>(widget))
+        return QStringLiteral("MainWindow");
+    if(dynamic_cast<const Button*>(widget))
+        return QStringLiteral("Button");
+    if(dynamic_cast<const Label*>(widget))
+        return QStringLiteral("Label");
+    if(dynamic_cast<const Image*>(widget))
+        return QStringLiteral("Image");
+    if(dynamic_cast<const Item*>(widget))
+        return QStringLiteral("Item");
+    if(dynamic_cast<const Creature*>(widget))
+        return QStringLiteral("Creature");
+    return QStringLiteral("Widget");
+}
+
 }
 
 OTUI::Widget::Widget() : m_id("widgetid")
@@ -80,15 +116,11 @@ OTUI::Widget::Widget(QString widgetId, QString dataPath, QString imagePath)
     m_imageSource = imagePath;
     QString fullImagePath(dataPath + "/" + imagePath);
     if(!fullImagePath.isEmpty())
-    {
-        if (!QPixmapCache::find(fullImagePath, &m_image)) {
-            m_image.load(fullImagePath);
-            QPixmapCache::insert(fullImagePath, m_image);
-        }
-    }
-    m_imageSize = QPoint(m_image.width(), m_image.height());
-    m_rect = QRect(0, 0, m_image.width(), m_image.height());
-    m_imageCrop.setRect(0, 0, m_image.width(), m_image.height());
+        loadImage(fullImagePath);
+    const QSize imageSize = loadedImageSize();
+    m_imageSize = QPoint(imageSize.width(), imageSize.height());
+    m_rect = QRect(0, 0, imageSize.width(), imageSize.height());
+    m_imageCrop.setRect(0, 0, imageSize.width(), imageSize.height());
     m_font = QFont("Verdana", 11);
     m_color = QColor(223, 223, 223);
     m_opacity = 1.0f;
@@ -100,6 +132,8 @@ void OTUI::Widget::event(QEvent *event)
     {
         SettingsSavedEvent *settings = reinterpret_cast<SettingsSavedEvent*>(event);
         setImageSource(m_imageSource, settings->dataPath);
+        if(!m_fontName.isEmpty())
+            setFontName(m_fontName, settings->dataPath);
     }
 }
 
@@ -111,6 +145,7 @@ void OTUI::Widget::setIdProperty(const QString &id) {
     if(m_id == nullptr || id.size() == 0) return;
 
     SetIdEvent *event = new SetIdEvent();
+    event->widget = this;
     event->oldId = m_id;
     event->newId = id;
     m_id = id;
@@ -515,6 +550,9 @@ void OTUI::Widget::setImageSource(const QString &source, const QString &dataPath
     {
         m_imageSource.clear();
         m_image = QPixmap();
+        m_imagePath.clear();
+        m_pendingImage = QImage();
+        m_pendingImagePath.clear();
         return;
     }
 
@@ -569,19 +607,13 @@ void OTUI::Widget::setImageSource(const QString &source, const QString &dataPath
     }
 
     const auto tryLoad = [&](const QString &path) {
-        if(path.isEmpty())
-            return false;
-        if(QPixmapCache::find(path, &m_image))
-            return !m_image.isNull();
-        if(QFileInfo::exists(path) && m_image.load(path))
-        {
-            QPixmapCache::insert(path, m_image);
-            return true;
-        }
-        return false;
+        return !path.isEmpty() && loadImage(path);
     };
 
     m_image = QPixmap();
+    m_imagePath.clear();
+    m_pendingImage = QImage();
+    m_pendingImagePath.clear();
     bool loaded = false;
     for(const QString &root : searchRoots)
     {
@@ -605,10 +637,96 @@ void OTUI::Widget::setImageSource(const QString &source, const QString &dataPath
             break;
     }
 
-    m_imageSize = QPoint(m_image.width(), m_image.height());
+    const QSize imageSize = loadedImageSize();
+    m_imageSize = QPoint(imageSize.width(), imageSize.height());
     if(m_imageSize.x() <= 0 || m_imageSize.y() <= 0)
         return;
 
     if(m_imageCrop.isNull() || m_imageCrop.width() <= 0 || m_imageCrop.height() <= 0)
         m_imageCrop.setRect(0, 0, m_imageSize.x(), m_imageSize.y());
 }
+
+void OTUI::Widget::finalizeImage()
+{
+    if(m_pendingImage.isNull())
+        return;
+    m_image = TextureManager::instance().adopt(m_pendingImagePath, m_pendingImage);
+    m_imagePath = m_pendingImagePath;
+    m_pendingImage = QImage();
+    m_pendingImagePath.clear();
+}
+
+void OTUI::Widget::releaseImage()
+{
+    if(!m_imagePath.isEmpty())
+        m_image = QPixmap();
+}
+
+void OTUI::Widget::restoreImage()
+{
+    if(m_image.isNull() && !m_imagePath.isEmpty())
+        loadImage(m_imagePath);
+}
+
+bool OTUI::Widget::loadImage(const QString &path)
+{
+    if(isGuiThread())
+    {
+        m_image = TextureManager::instance().pixmap(path);
+        if(m_image.isNull())
+            return false;
+        m_imagePath = path;
+        return true;
+    }
+
+    // QPixmap is GUI thread only; keep the decoded image for finalizeImage().
+    QImage image;
+    if(g_importImages)
+        image = g_importImages->image(path);
+    else if(QFileInfo::exists(path))
+        image.load(path);
+    if(image.isNull())
+        return false;
+    m_pendingImage = image;
+    m_pendingImagePath = path;
+    return true;
+}
+
+void OTUI::Widget::setFontName(const QString &name, const QString &dataPath)
+{
+    m_fontName = name.trimmed();
+    m_bitmapFont = BitmapFont::find(m_fontName, dataPath);
+}
+
+void OTUI::Widget::drawTextProperty(QPainter &painter, const QColor &color) const
+{
+    const QString text = textProperty();
+    if(text.isEmpty())
+        return;
+
+    const QPoint parentOrigin = m_parent ? m_parent->getPos() : QPoint();
+    const int originX = x() + parentOrigin.x() + textOffset().x();
+    const int originY = y() + parentOrigin.y() + textOffset().y();
+    const int drawWidth = std::max(1, width() - textOffset().x());
+    const int drawHeight = std::max(1, height() - textOffset().y());
+    if(m_bitmapFont)
+    {
+        m_bitmapFont->drawText(painter, QRect(originX, originY, drawWidth, drawHeight), text, color, textAlignment(), textWrap());
+        return;
+    }
+
+    const TextLayoutCache::Layout layout = TextLayoutCache::instance().layout(text, getFont(), QSize(drawWidth, drawHeight), textAlignment(), textWrap());
+
+    painter.save();
+    // drawStaticText does not clip; drawText clipped to the box unless told otherwise.
+    painter.setClipRect(QRect(originX, originY, drawWidth, drawHeight), Qt::IntersectClip);
+    painter.setPen(color);
+    painter.setFont(getFont());
+    // drawStaticText re-lays out the shared data when the transform changes, so
+    // other threads (offscreen tiles) draw from a detached copy.
+    QStaticText staticText = layout.text;
+    if(!isGuiThread())
+        staticText.setTextWidth(staticText.textWidth());
+    painter.drawStaticText(QPointF(originX, originY) + layout.offset, staticText);
+    painter.restore();
+}
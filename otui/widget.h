@@ -12,6 +12,8 @@
 #include "const.h"
 
 namespace OTUI {
+    class BitmapFont;
+
     enum class AnchorEdge : uint8_t {
         None,
         Left,
@@ -75,8 +77,17 @@ namespace OTUI {
         void setOpacity(float opacity);
 
         QPixmap image() const { return m_image; }
+        // File the pixmap was loaded from, as asked for.
+        const QString &imagePath() const { return m_imagePath; }
         const QString &imageSource() const { return m_imageSource; }
         void setImageSource(const QString &source, const QString &dataPath = QString());
+        // Widgets built off the GUI thread hold a decoded QImage until this
+        // converts it to the pixmap; call on the GUI thread before showing them.
+        void finalizeImage();
+        // Drops the pixmap while the widget is parked in an inactive document;
+        // restoreImage() loads it again from the file it came from.
+        void releaseImage();
+        void restoreImage();
 
         int x() const { return m_rect.x(); }
         int y() const { return m_rect.y(); }
@@ -122,8 +133,16 @@ namespace OTUI {
             m_parent = parent;
         }
 
+        // Style the widget was built from in its .otui file.
+        const QString &styleName() const { return m_styleName; }
+        void setStyleName(const QString &name) { m_styleName = name; }
+
         const QFont &getFont() const { return m_font; }
         void setFont(const QFont &font) { m_font = font; }
+        // OTClient font name; resolved against <dataPath>/fonts when a bitmap font exists.
+        const QString &fontName() const { return m_fontName; }
+        void setFontName(const QString &name, const QString &dataPath);
+        const BitmapFont *bitmapFont() const { return m_bitmapFont.get(); }
         QColor getColor() const { return m_color; }
 
         virtual bool supportsTextProperty() const;
@@ -172,6 +191,11 @@ namespace OTUI {
         void applyAnchors(const std::function<Widget*(const QString&)> &resolver);
 
     protected:
+        // Paints textProperty() inside the widget box using the shared layout cache.
+        void drawTextProperty(QPainter &painter, const QColor &color) const;
+        bool loadImage(const QString &path);
+        QSize loadedImageSize() const { return m_pendingImage.isNull() ? m_image.size() : m_pendingImage.size(); }
+
         OTUI::Widget *m_parent;
 
         QString m_id;
@@ -186,13 +210,20 @@ namespace OTUI {
         bool m_destroyed = false;
         bool m_clipping = false;
 
+        QString m_styleName;
         QString m_imageSource;
         QPixmap m_image;
+        QImage m_pendingImage;
+        QString m_pendingImagePath;
+        // File m_image was loaded from.
+        QString m_imagePath;
         QPoint m_imageSize;
         QRect m_imageCrop;
         QRect m_imageBorder;
 
         QFont m_font;
+        QString m_fontName;
+        std::shared_ptr<const BitmapFont> m_bitmapFont;
         QColor m_color;
         QColor m_backgroundColor;
 
@@ -223,6 +254,11 @@ namespace OTUI {
 
 void setModulesRootPath(const QString &path);
 void setModuleAssetsRoot(const QString &path);
+class ImageCache;
+// Widgets built on this thread read images through cache; returns the previous one.
+ImageCache *setImportImageCache(ImageCache *cache);
+// Node name the widget is written under in .otui files.
+QString widgetClassName(const Widget *widget);
 }
 
 #endif // OTUIWIDGET_H
@@ -56,6 +56,8 @@ ProjectSettings::ProjectSettings(QWidget *parent) : QFrame(parent)
     // Content
     addProjectName(contentLayout);
     addDataPath(contentLayout);
+    addTextureBudget(contentLayout);
+    addHistoryLimits(contentLayout);
     addSaveButton(contentLayout);
 
     layout->addWidget(contentPanel);
@@ -115,6 +117,64 @@ void ProjectSettings::addDataPath(QVBoxLayout *contentLayout)
     contentLayout->addWidget(setting);
 }
 
+void ProjectSettings::addTextureBudget(QVBoxLayout *contentLayout)
+{
+    QWidget *setting = new QWidget(contentPanel);
+    QHBoxLayout *settingLayout = new QHBoxLayout(setting);
+    settingLayout->setSpacing(5);
+    settingLayout->setContentsMargins(0, 0, 0, 0);
+
+    QLabel *label = new QLabel("Texture Budget", setting);
+    label->setFixedWidth(100);
+    label->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Preferred);
+
+    textureBudgetInput = new QSpinBox(setting);
+    textureBudgetInput->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    textureBudgetInput->setRange(16, 8192);
+    textureBudgetInput->setSingleStep(64);
+    textureBudgetInput->setSuffix(" MiB");
+    textureBudgetInput->setValue(256);
+    textureBudgetInput->setToolTip("Memory kept for widget images; the least recently used leave beyond it. Documents in other tabs keep up to half of it.");
+
+    settingLayout->addWidget(label);
+    settingLayout->addWidget(textureBudgetInput);
+
+    contentLayout->addWidget(setting);
+}
+
+void ProjectSettings::addHistoryLimits(QVBoxLayout *contentLayout)
+{
+    QWidget *setting = new QWidget(contentPanel);
+    QHBoxLayout *settingLayout = new QHBoxLayout(setting);
+    settingLayout->setSpacing(5);
+    settingLayout->setContentsMargins(0, 0, 0, 0);
+
+    QLabel *label = new QLabel("Undo History", setting);
+    label->setFixedWidth(100);
+    label->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Preferred);
+
+    historyLimitInput = new QSpinBox(setting);
+    historyLimitInput->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    historyLimitInput->setRange(1, 1024);
+    historyLimitInput->setSuffix(" MiB");
+    historyLimitInput->setValue(16);
+    historyLimitInput->setToolTip("Memory each document's undo history may use; the oldest steps are dropped beyond it.");
+
+    mergeIntervalInput = new QSpinBox(setting);
+    mergeIntervalInput->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    mergeIntervalInput->setRange(0, 10000);
+    mergeIntervalInput->setSingleStep(100);
+    mergeIntervalInput->setSuffix(" ms");
+    mergeIntervalInput->setValue(1000);
+    mergeIntervalInput->setToolTip("Consecutive edits of the same widget within this window undo as one step.");
+
+    settingLayout->addWidget(label);
+    settingLayout->addWidget(historyLimitInput);
+    settingLayout->addWidget(mergeIntervalInput);
+
+    contentLayout->addWidget(setting);
+}
+
 void ProjectSettings::addSaveButton(QVBoxLayout *contentLayout)
 {
     QPushButton *button = new QPushButton("Save", this);
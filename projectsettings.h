@@ -6,6 +6,7 @@
 #include <QPushButton>
 #include <QBoxLayout>
 #include <QLineEdit>
+#include <QSpinBox>
 
 #include "events/settingssavedevent.h"
 
@@ -38,9 +39,38 @@ public:
         return dataPathInput->text();
     }
 
+    // In MiB.
+    void setTextureBudget(int mib) {
+        textureBudgetInput->setValue(mib);
+    }
+
+    int getTextureBudget() const {
+        return textureBudgetInput->value();
+    }
+
+    // In MiB, per document.
+    void setHistoryLimit(int mib) {
+        historyLimitInput->setValue(mib);
+    }
+
+    int getHistoryLimit() const {
+        return historyLimitInput->value();
+    }
+
+    // In ms.
+    void setMergeInterval(int msecs) {
+        mergeIntervalInput->setValue(msecs);
+    }
+
+    int getMergeInterval() const {
+        return mergeIntervalInput->value();
+    }
+
 private:
     void addProjectName(QVBoxLayout *contentLayout);
     void addDataPath(QVBoxLayout *contentLayout);
+    void addTextureBudget(QVBoxLayout *contentLayout);
+    void addHistoryLimits(QVBoxLayout *contentLayout);
     void addSaveButton(QVBoxLayout *contentLayout);
 
 private:
@@ -50,6 +80,9 @@ private:
     QWidget *contentPanel;
     QLineEdit *projectNameInput;
     QLineEdit *dataPathInput;
+    QSpinBox *textureBudgetInput;
+    QSpinBox *historyLimitInput;
+    QSpinBox *mergeIntervalInput;
 
 };
 
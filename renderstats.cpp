@@ -0,0 +1,203 @@
+#include "renderstats.h"
+#include "mipmapcache.h"
+#include "otui/textlayoutcache.h"
+#include "otui/texturemanager.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// About two hours at 60 fps; later frames are dropped from the session, the HUD keeps updating.
+const int kMaxSessionFrames = 432000;
+
+double percentileOf(QVector<double> values, double p)
+{
+    if(values.isEmpty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    const double rank = std::clamp(p, 0.0, 100.0) / 100.0 * (values.size() - 1);
+    return values.at(static_cast<int>(std::lround(rank)));
+}
+
+bool writeFile(const QString &filePath, const QByteArray &data, QString *error)
+{
+    QSaveFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    file.write(data);
+    if(!file.commit())
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+}
+
+RenderStats::RenderStats(int window)
+    : m_window(std::max(1, window))
+{
+    reset();
+}
+
+void RenderStats::reset()
+{
+    m_frameTimes.clear();
+    m_nextSlot = 0;
+    m_session.clear();
+    m_current = RenderFrameStats();
+    m_last = RenderFrameStats();
+    m_frameCounter = 0;
+    resetHitCounters();
+    m_sessionTimer.start();
+}
+
+void RenderStats::setMipmapCache(const MipmapCache *cache)
+{
+    m_mipmaps = cache;
+    resetHitCounters();
+}
+
+double RenderStats::HitCounter::advance(quint64 totalHits, quint64 totalMisses)
+{
+    const quint64 frameHits = totalHits - hits;
+    const quint64 frameMisses = totalMisses - misses;
+    hits = totalHits;
+    misses = totalMisses;
+    if(frameHits + frameMisses == 0)
+        return -1.0;
+    return static_cast<double>(frameHits) / static_cast<double>(frameHits + frameMisses);
+}
+
+void RenderStats::resetHitCounters()
+{
+    const OTUI::TextLayoutCache::Stats textStats = OTUI::TextLayoutCache::instance().stats();
+    m_textCounter.advance(textStats.hits, textStats.misses);
+    const OTUI::TextureManager::Stats textureStats = OTUI::TextureManager::instance().stats();
+    m_textureCounter.advance(textureStats.hits, textureStats.misses);
+    if(m_mipmaps)
+    {
+        const MipmapCache::Stats mipmapStats = m_mipmaps->stats();
+        m_mipmapCounter.advance(mipmapStats.hits, mipmapStats.misses);
+    }
+}
+
+void RenderStats::beginFrame()
+{
+    m_current = RenderFrameStats();
+    m_current.frame = m_frameCounter++;
+    m_current.timestamp = m_sessionTimer.elapsed();
+    m_lastTexture = 0;
+    m_frameTimer.start();
+}
+
+void RenderStats::countTextureBind(qint64 textureKey)
+{
+    // Consecutive draws from the same texture share a bind.
+    if(textureKey == m_lastTexture)
+        return;
+    m_lastTexture = textureKey;
+    ++m_current.textureBinds;
+}
+
+void RenderStats::endFrame(int widgetsDrawn, int widgetsCulled)
+{
+    m_current.frameMs = m_frameTimer.nsecsElapsed() / 1000000.0;
+    m_current.widgetsDrawn = widgetsDrawn;
+    m_current.widgetsCulled = widgetsCulled;
+
+    const OTUI::TextLayoutCache::Stats textStats = OTUI::TextLayoutCache::instance().stats();
+    m_current.textCacheHitRate = m_textCounter.advance(textStats.hits, textStats.misses);
+    const OTUI::TextureManager::Stats textureStats = OTUI::TextureManager::instance().stats();
+    m_current.textureHitRate = m_textureCounter.advance(textureStats.hits, textureStats.misses);
+    if(m_mipmaps)
+    {
+        const MipmapCache::Stats mipmapStats = m_mipmaps->stats();
+        m_current.mipmapHitRate = m_mipmapCounter.advance(mipmapStats.hits, mipmapStats.misses);
+    }
+
+    if(m_frameTimes.size() < m_window)
+        m_frameTimes.append(m_current.frameMs);
+    else
+        m_frameTimes[m_nextSlot] = m_current.frameMs;
+    m_nextSlot = (m_nextSlot + 1) % m_window;
+
+    if(m_session.size() < kMaxSessionFrames)
+        m_session.append(m_current);
+    m_last = m_current;
+}
+
+double RenderStats::frameTimePercentile(double p) const
+{
+    return percentileOf(m_frameTimes, p);
+}
+
+bool RenderStats::exportCsv(const QString &filePath, QString *error) const
+{
+    QByteArray data;
+    QTextStream out(&data);
+    out << "frame,timestamp_ms,frame_ms,widgets_drawn,widgets_culled,draw_calls,texture_binds,"
+           "text_cache_hit_rate,mipmap_hit_rate,texture_hit_rate\n";
+    const auto rate = [&out](double value) {
+        if(value >= 0.0)
+            out << QString::number(value, 'f', 4);
+    };
+    for(const RenderFrameStats &frame : m_session)
+    {
+        out << frame.frame << ',' << frame.timestamp << ',' << QString::number(frame.frameMs, 'f', 3) << ','
+            << frame.widgetsDrawn << ',' << frame.widgetsCulled << ',' << frame.drawCalls << ','
+            << frame.textureBinds << ',';
+        rate(frame.textCacheHitRate);
+        out << ',';
+        rate(frame.mipmapHitRate);
+        out << ',';
+        rate(frame.textureHitRate);
+        out << '\n';
+    }
+    out.flush();
+    return writeFile(filePath, data, error);
+}
+
+bool RenderStats::exportJson(const QString &filePath, QString *error) const
+{
+    QJsonArray frames;
+    QVector<double> frameTimes;
+    frameTimes.reserve(m_session.size());
+    for(const RenderFrameStats &frame : m_session)
+    {
+        frameTimes.append(frame.frameMs);
+        QJsonObject object;
+        object.insert(QStringLiteral("frame"), static_cast<qint64>(frame.frame));
+        object.insert(QStringLiteral("timestampMs"), frame.timestamp);
+        object.insert(QStringLiteral("frameMs"), frame.frameMs);
+        object.insert(QStringLiteral("widgetsDrawn"), frame.widgetsDrawn);
+        object.insert(QStringLiteral("widgetsCulled"), frame.widgetsCulled);
+        object.insert(QStringLiteral("drawCalls"), frame.drawCalls);
+        object.insert(QStringLiteral("textureBinds"), frame.textureBinds);
+        if(frame.textCacheHitRate >= 0.0)
+            object.insert(QStringLiteral("textCacheHitRate"), frame.textCacheHitRate);
+        if(frame.mipmapHitRate >= 0.0)
+            object.insert(QStringLiteral("mipmapHitRate"), frame.mipmapHitRate);
+        if(frame.textureHitRate >= 0.0)
+            object.insert(QStringLiteral("textureHitRate"), frame.textureHitRate);
+        frames.append(object);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("frameCount"), frames.size());
+    root.insert(QStringLiteral("p50FrameMs"), percentileOf(frameTimes, 50.0));
+    root.insert(QStringLiteral("p95FrameMs"), percentileOf(frameTimes, 95.0));
+    root.insert(QStringLiteral("p99FrameMs"), percentileOf(frameTimes, 99.0));
+    root.insert(QStringLiteral("frames"), frames);
+    return writeFile(filePath, QJsonDocument(root).toJson(QJsonDocument::Indented), error);
+}
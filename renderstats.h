@@ -0,0 +1,76 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+class MipmapCache;
+
+struct RenderFrameStats
+{
+    quint64 frame = 0;
+    // Milliseconds since the session started.
+    qint64 timestamp = 0;
+    double frameMs = 0.0;
+    int widgetsDrawn = 0;
+    int widgetsCulled = 0;
+    int drawCalls = 0;
+    int textureBinds = 0;
+    // Hit rates are -1 when the cache saw no lookups during the frame.
+    double textCacheHitRate = -1.0;
+    double mipmapHitRate = -1.0;
+    double textureHitRate = -1.0;
+};
+
+// Per-frame counters for the canvas. Keeps a rolling window for the HUD
+// percentiles and the whole session for export.
+class RenderStats
+{
+public:
+    explicit RenderStats(int window = 240);
+
+    void beginFrame();
+    void endFrame(int widgetsDrawn, int widgetsCulled);
+    void reset();
+
+    void countDrawCall() { ++m_current.drawCalls; }
+    void countTextureBind(qint64 textureKey);
+    // The canvas's mipmap cache, whose hit rate is recorded per frame.
+    void setMipmapCache(const MipmapCache *cache);
+
+    const RenderFrameStats &lastFrame() const { return m_last; }
+    // p in [0, 100] over the rolling window.
+    double frameTimePercentile(double p) const;
+    int sessionFrames() const { return m_session.size(); }
+
+    bool exportCsv(const QString &filePath, QString *error = nullptr) const;
+    bool exportJson(const QString &filePath, QString *error = nullptr) const;
+
+private:
+    struct HitCounter {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        // Rate of the lookups since the last call, -1 when there were none.
+        double advance(quint64 totalHits, quint64 totalMisses);
+    };
+
+    void resetHitCounters();
+
+    int m_window;
+    QVector<double> m_frameTimes;
+    int m_nextSlot = 0;
+    QVector<RenderFrameStats> m_session;
+    RenderFrameStats m_current;
+    RenderFrameStats m_last;
+    quint64 m_frameCounter = 0;
+    qint64 m_lastTexture = 0;
+    const MipmapCache *m_mipmaps = nullptr;
+    HitCounter m_textCounter;
+    HitCounter m_mipmapCounter;
+    HitCounter m_textureCounter;
+    QElapsedTimer m_sessionTimer;
+    QElapsedTimer m_frameTimer;
+};
+
+#endif // RENDERSTATS_H
@@ -0,0 +1,135 @@
+#include "scenerenderer.h"
+#include "mipmapcache.h"
+#include "renderstats.h"
+
+void SceneRenderer::drawWidget(QPainter &painter, OTUI::Widget &widget) const
+{
+    OTUI::Widget *parent = widget.getParent();
+    if(hasImage(widget))
+    {
+        if(widget.getImageBorder().isNull())
+        {
+            // Children keep the clip size, top level widgets stretch it over their rect.
+            if(parent)
+                paintImage(painter, QRectF(widget.getPos() + parent->getPos(), QSizeF(-1, -1)), widget, widget.getImageCrop());
+            else
+                paintImage(painter, canvasRect(widget), widget, widget.getImageCrop());
+        }
+        else
+        {
+            const QPoint origin = canvasRect(widget).topLeft();
+            drawBorderImage(painter, widget, origin.x(), origin.y());
+        }
+    }
+
+    if(m_stats && widget.supportsTextProperty())
+        m_stats->countDrawCall();
+    widget.draw(painter);
+}
+
+QRect SceneRenderer::canvasRect(const OTUI::Widget &widget)
+{
+    QPoint origin = widget.getPos();
+    if(OTUI::Widget *parent = widget.getParent())
+        origin += parent->getPos();
+    return QRect(origin, QSize(widget.width(), widget.height()));
+}
+
+bool SceneRenderer::hasImage(const OTUI::Widget &widget) const
+{
+    return !widget.image().isNull();
+}
+
+void SceneRenderer::paintImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const
+{
+    if(m_stats)
+    {
+        m_stats->countDrawCall();
+        m_stats->countTextureBind(widget.image().cacheKey());
+    }
+    drawImage(painter, target, widget, source);
+}
+
+void SceneRenderer::drawImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const
+{
+    const QPixmap &pixmap = widget.image();
+    const QPixmap level = m_mipmaps ? m_mipmaps->level(pixmap, painter.transform().m11()) : QPixmap();
+    if(level.isNull())
+    {
+        painter.drawPixmap(target, pixmap, source);
+        return;
+    }
+
+    // Resolve drawPixmap's defaults against the full size before mapping into the level.
+    QRectF from = source;
+    if(from.width() <= 0)
+        from.setWidth(pixmap.width() - from.x());
+    if(from.height() <= 0)
+        from.setHeight(pixmap.height() - from.y());
+    QRectF to = target;
+    if(to.width() < 0)
+        to.setWidth(from.width());
+    if(to.height() < 0)
+        to.setHeight(from.height());
+
+    const qreal sx = static_cast<qreal>(level.width()) / pixmap.width();
+    const qreal sy = static_cast<qreal>(level.height()) / pixmap.height();
+    painter.drawPixmap(to, level, QRectF(from.x() * sx, from.y() * sy, from.width() * sx, from.height() * sy));
+}
+
+void SceneRenderer::drawBorderImage(QPainter &painter, const OTUI::Widget &widget, int x, int y) const
+{
+    int top = widget.getImageBorder().y();
+    int bottom = widget.getImageBorder().height();
+    int left =  widget.getImageBorder().x();
+    int right  = widget.getImageBorder().width();
+
+    // calculates border coords
+    const QRect clip = widget.getImageCrop();
+    QRect leftBorder(clip.left(), clip.top() + top, left, clip.height() - top - bottom);
+    QRect rightBorder(clip.right() - right + 1, clip.top() + top, right, clip.height() - top - bottom);
+    QRect topBorder(clip.left() + left, clip.top(), clip.width() - right - left, top);
+    QRect bottomBorder(clip.left() + left, clip.bottom() - bottom + 1, clip.width() - right - left, bottom);
+    QRect topLeftCorner(clip.left(), clip.top(), left, top);
+    QRect topRightCorner(clip.right() - right + 1, clip.top(), right, top);
+    QRect bottomLeftCorner(clip.left(), clip.bottom() - bottom + 1, left, bottom);
+    QRect bottomRightCorner(clip.right() - right + 1, clip.bottom() - bottom + 1, right, bottom);
+    QRect center(clip.left() + left, clip.top() + top, clip.width() - right - left, clip.height() - top - bottom);
+    QPoint bordersSize(leftBorder.width() + rightBorder.width(), topBorder.height() + bottomBorder.height());
+    QPoint centerSize = widget.getSize() - bordersSize;
+    QRect rectCoords;
+    QRect drawRect(x, y, widget.width(), widget.height());
+
+    // first the center
+    if((centerSize.x()*centerSize.y()) > 0) {
+        rectCoords = QRect(drawRect.left() + leftBorder.width(),
+                           drawRect.top() + topBorder.height(),
+                           centerSize.x(),
+                           centerSize.y());
+        paintImage(painter, rectCoords, widget, center);
+    }
+    // top left corner
+    rectCoords = QRect(drawRect.topLeft(), topLeftCorner.size());
+    paintImage(painter, rectCoords, widget, topLeftCorner);
+    // top
+    rectCoords = QRect(drawRect.left() + topLeftCorner.width(), drawRect.topLeft().y(), centerSize.x(), topBorder.height());
+    paintImage(painter, rectCoords, widget, topBorder);
+    // top right corner
+    rectCoords = QRect(QPoint(drawRect.left() + topLeftCorner.width() + centerSize.x(), drawRect.top()), topRightCorner.size());
+    paintImage(painter, rectCoords, widget, topRightCorner);
+    // left
+    rectCoords = QRect(drawRect.left(), drawRect.top() + topLeftCorner.height(), leftBorder.width(), centerSize.y());
+    paintImage(painter, rectCoords, widget, leftBorder);
+    // right
+    rectCoords = QRect(drawRect.left() + leftBorder.width() + centerSize.x(), drawRect.top() + topRightCorner.height(), rightBorder.width(), centerSize.y());
+    paintImage(painter, rectCoords, widget, rightBorder);
+    // bottom left corner
+    rectCoords = QRect(QPoint(drawRect.left(), drawRect.top() + topLeftCorner.height() + centerSize.y()), bottomLeftCorner.size());
+    paintImage(painter, rectCoords, widget, bottomLeftCorner);
+    // bottom
+    rectCoords = QRect(drawRect.left() + bottomLeftCorner.width(), drawRect.top() + topBorder.height() + centerSize.y(), centerSize.x(), bottomBorder.height());
+    paintImage(painter, rectCoords, widget, bottomBorder);
+    // bottom right corner
+    rectCoords = QRect(QPoint(drawRect.left() + bottomLeftCorner.width() + centerSize.x(), drawRect.top() + topRightCorner.height() + centerSize.y()), bottomRightCorner.size());
+    paintImage(painter, rectCoords, widget, bottomRightCorner);
+}
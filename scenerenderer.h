@@ -0,0 +1,43 @@
+#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include <QPainter>
+#include <QRect>
+#include "otui/otui.h"
+
+class MipmapCache;
+class RenderStats;
+
+// Draws OTUI widgets in canvas coordinates. Shared by the editor canvas and
+// the offscreen renderer so both produce the same output; subclasses only
+// decide where widget images come from.
+class SceneRenderer
+{
+public:
+    virtual ~SceneRenderer() = default;
+
+    // Image (plain or nine-slice) followed by the widget's own content.
+    void drawWidget(QPainter &painter, OTUI::Widget &widget) const;
+
+    // Children are offset by their direct parent only, matching the editor canvas.
+    static QRect canvasRect(const OTUI::Widget &widget);
+
+    // Counts draw calls and texture binds into stats; GUI thread only.
+    void setStats(RenderStats *stats) { m_stats = stats; }
+    // Zoomed out draws sample a pre-reduced level when one is ready; GUI thread only.
+    void setMipmapCache(MipmapCache *cache) { m_mipmaps = cache; }
+
+protected:
+    virtual bool hasImage(const OTUI::Widget &widget) const;
+    // Same semantics as QPainter::drawPixmap(QRectF, QPixmap, QRectF), negative sizes included.
+    virtual void drawImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const;
+
+private:
+    void paintImage(QPainter &painter, const QRectF &target, const OTUI::Widget &widget, const QRectF &source) const;
+    void drawBorderImage(QPainter &painter, const OTUI::Widget &widget, int x, int y) const;
+
+    RenderStats *m_stats = nullptr;
+    MipmapCache *m_mipmaps = nullptr;
+};
+
+#endif // SCENERENDERER_H
@@ -0,0 +1,186 @@
+#include "spatialindex.h"
+
+#include <algorithm>
+
+namespace {
+int floorDiv(int value, int divisor)
+{
+    int quotient = value / divisor;
+    if((value % divisor != 0) && ((value < 0) != (divisor < 0)))
+        --quotient;
+    return quotient;
+}
+
+QRect normalizedBounds(const QRect &bounds)
+{
+    // Zero sized widgets still paint text and selection handles, keep them pickable.
+    QRect result = bounds.normalized();
+    if(result.width() < 1)
+        result.setWidth(1);
+    if(result.height() < 1)
+        result.setHeight(1);
+    return result;
+}
+}
+
+SpatialIndex::SpatialIndex(int cellSize)
+    : m_cellSize(std::max(16, cellSize))
+{
+}
+
+void SpatialIndex::clear()
+{
+    m_entries.clear();
+    m_cells.clear();
+    m_cellExtent = QRect();
+}
+
+QRect SpatialIndex::cellRange(const QRect &bounds) const
+{
+    const int left = floorDiv(bounds.left(), m_cellSize);
+    const int top = floorDiv(bounds.top(), m_cellSize);
+    const int right = floorDiv(bounds.right(), m_cellSize);
+    const int bottom = floorDiv(bounds.bottom(), m_cellSize);
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+void SpatialIndex::insert(OTUI::Widget *widget, const QRect &bounds, quint64 order)
+{
+    if(!widget || m_entries.contains(widget))
+        return;
+
+    Entry entry;
+    entry.bounds = normalizedBounds(bounds);
+    entry.order = order;
+    m_entries.insert(widget, entry);
+    addToCells(widget, cellRange(entry.bounds));
+}
+
+void SpatialIndex::update(OTUI::Widget *widget, const QRect &bounds)
+{
+    auto it = m_entries.find(widget);
+    if(it == m_entries.end())
+        return;
+
+    const QRect newBounds = normalizedBounds(bounds);
+    const QRect oldCells = cellRange(it->bounds);
+    const QRect newCells = cellRange(newBounds);
+    it->bounds = newBounds;
+
+    // Small drags usually stay inside the same cells, only the stored rect changes.
+    if(oldCells == newCells)
+        return;
+    removeFromCells(widget, oldCells);
+    addToCells(widget, newCells);
+}
+
+void SpatialIndex::remove(OTUI::Widget *widget)
+{
+    auto it = m_entries.find(widget);
+    if(it == m_entries.end())
+        return;
+    removeFromCells(widget, cellRange(it->bounds));
+    m_entries.erase(it);
+}
+
+void SpatialIndex::addToCells(OTUI::Widget *widget, const QRect &cells)
+{
+    m_cellExtent = m_cellExtent.isNull() ? cells : m_cellExtent.united(cells);
+    for(int cy = cells.top(); cy <= cells.bottom(); ++cy)
+    {
+        for(int cx = cells.left(); cx <= cells.right(); ++cx)
+            m_cells[cellKey(cx, cy)].append(widget);
+    }
+}
+
+void SpatialIndex::removeFromCells(OTUI::Widget *widget, const QRect &cells)
+{
+    for(int cy = cells.top(); cy <= cells.bottom(); ++cy)
+    {
+        for(int cx = cells.left(); cx <= cells.right(); ++cx)
+        {
+            auto cellIt = m_cells.find(cellKey(cx, cy));
+            if(cellIt == m_cells.end())
+                continue;
+            cellIt->removeOne(widget);
+            if(cellIt->isEmpty())
+                m_cells.erase(cellIt);
+        }
+    }
+}
+
+QVector<OTUI::Widget*> SpatialIndex::query(const QRect &area) const
+{
+    QVector<OTUI::Widget*> result;
+    if(m_entries.isEmpty() || !area.isValid())
+        return result;
+
+    if(++m_queryStamp == 0)
+    {
+        for(const Entry &entry : m_entries)
+            entry.stamp = 0;
+        m_queryStamp = 1;
+    }
+
+    // Only walk cells that can hold something, zoomed out views cover a lot of empty space.
+    const QRect cells = cellRange(area).intersected(m_cellExtent);
+    for(int cy = cells.top(); cy <= cells.bottom(); ++cy)
+    {
+        for(int cx = cells.left(); cx <= cells.right(); ++cx)
+        {
+            const auto cellIt = m_cells.constFind(cellKey(cx, cy));
+            if(cellIt == m_cells.cend())
+                continue;
+            for(OTUI::Widget *widget : *cellIt)
+            {
+                const auto entryIt = m_entries.constFind(widget);
+                if(entryIt == m_entries.cend() || entryIt->stamp == m_queryStamp)
+                    continue;
+                entryIt->stamp = m_queryStamp;
+                if(entryIt->bounds.intersects(area))
+                    result.append(widget);
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [this](OTUI::Widget *a, OTUI::Widget *b) {
+        return m_entries.constFind(a)->order < m_entries.constFind(b)->order;
+    });
+    return result;
+}
+
+OTUI::Widget *SpatialIndex::pick(const QPoint &point, int margin) const
+{
+    if(m_entries.isEmpty())
+        return nullptr;
+
+    // A point only touches one cell, the margin can spill into the neighbours.
+    const QRect probe(point - QPoint(margin, margin), point + QPoint(margin, margin));
+    const QRect cells = cellRange(probe).intersected(m_cellExtent);
+
+    OTUI::Widget *best = nullptr;
+    quint64 bestOrder = 0;
+    for(int cy = cells.top(); cy <= cells.bottom(); ++cy)
+    {
+        for(int cx = cells.left(); cx <= cells.right(); ++cx)
+        {
+            const auto cellIt = m_cells.constFind(cellKey(cx, cy));
+            if(cellIt == m_cells.cend())
+                continue;
+            for(OTUI::Widget *widget : *cellIt)
+            {
+                const auto entryIt = m_entries.constFind(widget);
+                if(entryIt == m_entries.cend())
+                    continue;
+                if(best && entryIt->order <= bestOrder)
+                    continue;
+                if(entryIt->bounds.adjusted(-margin, -margin, margin, margin).contains(point))
+                {
+                    best = widget;
+                    bestOrder = entryIt->order;
+                }
+            }
+        }
+    }
+    return best;
+}
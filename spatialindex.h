@@ -0,0 +1,54 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QHash>
+#include <QRect>
+#include <QVector>
+
+namespace OTUI {
+class Widget;
+}
+
+// Uniform grid over canvas-space widget rects. Each widget is registered in
+// every cell its bounds touch, so a query only visits the cells covering the
+// requested area instead of the whole widget list. Entries can be moved or
+// removed in place; order is the paint order used to resolve overlaps.
+class SpatialIndex
+{
+public:
+    explicit SpatialIndex(int cellSize = 256);
+
+    void clear();
+    void insert(OTUI::Widget *widget, const QRect &bounds, quint64 order);
+    void update(OTUI::Widget *widget, const QRect &bounds);
+    void remove(OTUI::Widget *widget);
+    bool contains(OTUI::Widget *widget) const { return m_entries.contains(widget); }
+
+    // Widgets whose bounds intersect area, sorted back-to-front (paint order).
+    QVector<OTUI::Widget*> query(const QRect &area) const;
+    // Topmost widget whose bounds, grown by margin on every side, contain point.
+    OTUI::Widget *pick(const QPoint &point, int margin = 0) const;
+
+    int size() const { return m_entries.size(); }
+    int cellSize() const { return m_cellSize; }
+
+private:
+    struct Entry {
+        QRect bounds;
+        quint64 order = 0;
+        mutable quint32 stamp = 0;
+    };
+
+    static qint64 cellKey(int cx, int cy) { return (static_cast<qint64>(cx) << 32) | static_cast<quint32>(cy); }
+    QRect cellRange(const QRect &bounds) const;
+    void addToCells(OTUI::Widget *widget, const QRect &cells);
+    void removeFromCells(OTUI::Widget *widget, const QRect &cells);
+
+    int m_cellSize;
+    QHash<OTUI::Widget*, Entry> m_entries;
+    QHash<qint64, QVector<OTUI::Widget*>> m_cells;
+    QRect m_cellExtent;
+    mutable quint32 m_queryStamp = 0;
+};
+
+#endif // SPATIALINDEX_H
@@ -5,6 +5,7 @@
 #include <QWidget>
 #include <QFileDialog>
 #include <QDateTime>
+#include <QPointer>
 #include <vector>
 #include <algorithm>
 #include "corewindow.h"
@@ -45,7 +46,8 @@ private slots:
 
 private:
     Ui::StartupWindow *ui;
-    CoreWindow *coreWindow = nullptr;
+    // Deletes itself when its project is closed.
+    QPointer<CoreWindow> coreWindow;
 
     std::vector<std::unique_ptr<RecentProject>> m_recentProjects;
 };
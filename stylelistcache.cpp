@@ -0,0 +1,110 @@
+#include "stylelistcache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+constexpr quint32 kCacheMagic = 0x4F545343; // "OTSC"
+constexpr quint16 kCacheVersion = 1;
+}
+
+bool StyleListCache::load(const QString &cachePath)
+{
+    m_entries.clear();
+    m_modified = false;
+
+    QFile file(cachePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if(magic != kCacheMagic || version != kCacheVersion)
+        return false;
+
+    stream >> count;
+    QHash<QString, Entry> entries;
+    entries.reserve(static_cast<int>(qMin<quint32>(count, 65536)));
+    for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Entry entry;
+        stream >> path >> entry.modified >> entry.size >> entry.styles;
+        entries.insert(path, std::move(entry));
+    }
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    m_entries = std::move(entries);
+    return true;
+}
+
+bool StyleListCache::save(const QString &cachePath, QString *error)
+{
+    QSaveFile file(cachePath);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << kCacheMagic << kCacheVersion << static_cast<quint32>(m_entries.size());
+    for(auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        stream << it.key() << it->modified << it->size << it->styles;
+
+    if(stream.status() != QDataStream::Ok || !file.commit())
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    m_modified = false;
+    return true;
+}
+
+QStringList StyleListCache::styles(const QString &filePath, const OTUI::Parser &parser, QString *error)
+{
+    const QFileInfo info(filePath);
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const qint64 size = info.size();
+
+    Entry &entry = m_entries[filePath];
+    entry.used = true;
+    if(entry.modified == modified && entry.size == size)
+        return entry.styles;
+
+    QString listError;
+    entry.styles = parser.listStyles(filePath, &listError);
+    // A file that failed to parse is retried next time instead of cached as empty.
+    entry.modified = listError.isEmpty() ? modified : -1;
+    entry.size = size;
+    m_modified = true;
+    if(error)
+        *error = listError;
+    return entry.styles;
+}
+
+void StyleListCache::prune()
+{
+    for(auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if(!it->used)
+        {
+            it = m_entries.erase(it);
+            m_modified = true;
+            continue;
+        }
+        it->used = false;
+        ++it;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef STYLELISTCACHE_H
+#define STYLELISTCACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "otui/parser.h"
+
+// Top level style names of .otui files, remembered with each file's mtime
+// and size, so rebuilding the styles browser only rescans the files that
+// changed since the cache was written.
+class StyleListCache
+{
+public:
+    // Reads a cache written by save(); false leaves the cache empty.
+    bool load(const QString &cachePath);
+    bool save(const QString &cachePath, QString *error = nullptr);
+
+    // The cached names while the file is unchanged, otherwise lists them with parser.
+    QStringList styles(const QString &filePath, const OTUI::Parser &parser, QString *error = nullptr);
+    // Drops the files not looked up since the last prune, e.g. deleted ones.
+    void prune();
+    bool isModified() const { return m_modified; }
+
+private:
+    struct Entry {
+        qint64 modified = -1;
+        qint64 size = -1;
+        QStringList styles;
+        bool used = false;
+    };
+
+    QHash<QString, Entry> m_entries;
+    bool m_modified = false;
+};
+
+#endif // STYLELISTCACHE_H
@@ -5,6 +5,9 @@
 #include <QHeaderView>
 #include <QLabel>
 #include <QFileInfo>
+#include <QPair>
+#include <QtConcurrent>
+#include <utility>
 
 namespace {
 QString cleanedPath(const QString &path)
@@ -18,7 +21,11 @@ constexpr int RoleStyleName = Qt::UserRole + 2;
 }
 
 StyleSourceBrowser::StyleSourceBrowser(QWidget *parent)
-    : QFrame(parent), m_tree(new QTreeWidget(this))
+    : QFrame(parent),
+      m_tree(new QTreeWidget(this)),
+      m_indexingLabel(new QLabel(this)),
+      m_searchEdit(new QLineEdit(this)),
+      m_searchResults(new QTreeWidget(this))
 {
     setObjectName("styleSourceBrowser");
     setFixedSize(500, 420);
@@ -34,12 +41,34 @@ StyleSourceBrowser::StyleSourceBrowser(QWidget *parent)
     title->setObjectName("styleSourceTitle");
     layout->addWidget(title);
 
+    m_searchEdit->setObjectName("styleSourceSearch");
+    m_searchEdit->setPlaceholderText("Search styles...");
+    m_searchEdit->setClearButtonEnabled(true);
+    layout->addWidget(m_searchEdit);
+
     m_tree->setHeaderHidden(true);
     m_tree->setSelectionMode(QAbstractItemView::SingleSelection);
     m_tree->header()->setSectionResizeMode(QHeaderView::Stretch);
     layout->addWidget(m_tree, 1);
 
+    m_searchResults->setHeaderHidden(true);
+    m_searchResults->setRootIsDecorated(false);
+    m_searchResults->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_searchResults->hide();
+    layout->addWidget(m_searchResults, 1);
+
+    m_indexingLabel->setObjectName("styleSourceIndexing");
+    m_indexingLabel->hide();
+    layout->addWidget(m_indexingLabel);
+
     connect(m_tree, &QTreeWidget::itemDoubleClicked, this, &StyleSourceBrowser::handleItemDoubleClicked);
+    connect(m_searchResults, &QTreeWidget::itemDoubleClicked, this, &StyleSourceBrowser::handleItemDoubleClicked);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &StyleSourceBrowser::updateSearchResults);
+}
+
+StyleSourceBrowser::~StyleSourceBrowser()
+{
+    stopIndexing();
 }
 
 void StyleSourceBrowser::setDataPath(const QString &path)
@@ -51,6 +80,16 @@ void StyleSourceBrowser::setDataPath(const QString &path)
     refresh();
 }
 
+void StyleSourceBrowser::setCachePath(const QString &path)
+{
+    if(m_cachePath == path)
+        return;
+
+    stopIndexing();
+    m_cachePath = path;
+    m_styleCache.load(path);
+}
+
 void StyleSourceBrowser::initialize()
 {
     refresh();
@@ -84,43 +123,138 @@ void StyleSourceBrowser::handleItemDoubleClicked(QTreeWidgetItem *item, int)
 
 void StyleSourceBrowser::rebuildTree()
 {
+    stopIndexing();
     m_tree->clear();
+    m_rootItems.clear();
     m_styleEntries.clear();
+    m_searchIndex.clear();
+    m_indexedFiles = 0;
+    updateSearchResults();
 
     if(m_dataPath.isEmpty())
         return;
 
     const QDir dataDir(m_dataPath);
-    if(dataDir.exists())
-    {
-        addRootListing("styles", dataDir.filePath("styles"));
+    if(!dataDir.exists())
+        return;
+
+    QDir repoDir(dataDir);
+    repoDir.cdUp();
+    const QList<QPair<QString, QString>> roots = {
+        {QStringLiteral("styles"), dataDir.filePath("styles")},
+        {QStringLiteral("modules"), repoDir.filePath("modules")}
+    };
+
+    m_indexingLabel->setText("Indexing styles...");
+    m_indexingLabel->show();
+
+    m_indexWatcher = new QFutureWatcher<IndexedFile>(this);
+    connect(m_indexWatcher, &QFutureWatcherBase::resultsReadyAt, this, &StyleSourceBrowser::addIndexedFiles);
+    connect(m_indexWatcher, &QFutureWatcherBase::finished, this, &StyleSourceBrowser::finishIndexing);
+    // Files unchanged since the cache was written are not read again.
+    m_indexWatcher->setFuture(QtConcurrent::run([roots, cache = &m_styleCache, parser = &m_parser](QPromise<IndexedFile> &promise) {
+        for(const auto &root : roots)
+        {
+            const QDir rootDir(root.second);
+            if(!rootDir.exists())
+                continue;
+
+            const QString rootPath = rootDir.absolutePath();
+            const QStringList files = collectOtuiFiles(rootPath);
+            for(const QString &file : files)
+            {
+                if(promise.isCanceled())
+                    return;
+                IndexedFile indexed;
+                indexed.rootTitle = root.first;
+                indexed.rootPath = rootPath;
+                indexed.filePath = file;
+                indexed.styles = cache->styles(file, *parser);
+                promise.addResult(std::move(indexed));
+            }
+        }
+    }));
+}
+
+void StyleSourceBrowser::stopIndexing()
+{
+    QFutureWatcher<IndexedFile> *watcher = std::exchange(m_indexWatcher, nullptr);
+    if(!watcher)
+        return;
 
-        QDir repoDir(dataDir);
-        repoDir.cdUp();
-        const QString modulesPath = repoDir.filePath("modules");
-        addRootListing("modules", modulesPath);
+    // Results still queued for the old tree are dropped with the watcher.
+    watcher->disconnect(this);
+    watcher->cancel();
+    watcher->waitForFinished();
+    watcher->deleteLater();
+    m_indexingLabel->hide();
+}
+
+void StyleSourceBrowser::addIndexedFiles(int begin, int end)
+{
+    if(!m_indexWatcher)
+        return;
+
+    for(int i = begin; i < end; ++i)
+    {
+        const IndexedFile indexed = m_indexWatcher->resultAt(i);
+        addFileEntry(rootItem(indexed.rootTitle, indexed.rootPath), indexed.rootPath, indexed.filePath, indexed.styles);
     }
+    m_indexedFiles += end - begin;
+    m_indexingLabel->setText(QStringLiteral("Indexing styles... %1 files").arg(m_indexedFiles));
+    if(!m_searchEdit->text().trimmed().isEmpty())
+        updateSearchResults();
 }
 
-void StyleSourceBrowser::addRootListing(const QString &title, const QString &rootPath)
+void StyleSourceBrowser::finishIndexing()
 {
-    QDir rootDir(rootPath);
-    if(!rootDir.exists())
+    QFutureWatcher<IndexedFile> *watcher = std::exchange(m_indexWatcher, nullptr);
+    if(!watcher)
         return;
+    watcher->deleteLater();
+    m_indexingLabel->hide();
+
+    m_styleCache.prune();
+    if(!m_cachePath.isEmpty() && m_styleCache.isModified())
+        m_styleCache.save(m_cachePath);
+}
 
-    const QStringList files = collectOtuiFiles(rootDir.absolutePath());
-    if(files.isEmpty())
+QTreeWidgetItem *StyleSourceBrowser::rootItem(const QString &title, const QString &rootPath)
+{
+    QTreeWidgetItem *&item = m_rootItems[title];
+    if(!item)
+    {
+        item = new QTreeWidgetItem(QStringList() << QStringLiteral("%1 (%2)").arg(title, cleanedPath(rootPath)));
+        item->setDisabled(true);
+        m_tree->addTopLevelItem(item);
+        item->setExpanded(true);
+    }
+    return item;
+}
+
+void StyleSourceBrowser::updateSearchResults()
+{
+    m_searchResults->clear();
+    const QString query = m_searchEdit->text();
+    const bool searching = !query.trimmed().isEmpty();
+    m_tree->setVisible(!searching);
+    m_searchResults->setVisible(searching);
+    if(!searching)
         return;
 
-    auto *rootItem = new QTreeWidgetItem(QStringList() << QStringLiteral("%1 (%2)").arg(title, cleanedPath(rootDir.absolutePath())));
-    rootItem->setDisabled(true);
-    m_tree->addTopLevelItem(rootItem);
-    for(const QString &file : files)
-        addFileEntry(rootItem, rootDir.absolutePath(), file);
-    rootItem->setExpanded(true);
+    for(const FuzzyIndex::Match &match : m_searchIndex.search(query, 200))
+    {
+        const StyleTemplateEntry &entry = m_styleEntries.at(match.id);
+        auto *item = new QTreeWidgetItem(QStringList() << m_searchIndex.text(match.id));
+        item->setData(0, RolePath, entry.filePath);
+        item->setData(0, RoleType, static_cast<int>(EntryType::Style));
+        item->setData(0, RoleStyleName, entry.styleName);
+        item->setToolTip(0, entry.filePath);
+        m_searchResults->addTopLevelItem(item);
+    }
 }
 
-QStringList StyleSourceBrowser::collectOtuiFiles(const QString &rootPath) const
+QStringList StyleSourceBrowser::collectOtuiFiles(const QString &rootPath)
 {
     QStringList files;
     QDirIterator it(rootPath,
@@ -134,15 +268,7 @@ QStringList StyleSourceBrowser::collectOtuiFiles(const QString &rootPath) const
     return files;
 }
 
-QStringList StyleSourceBrowser::collectStyleEntries(const QString &filePath) const
-{
-    QString error;
-    QStringList styles = m_parser.listStyles(filePath, &error);
-    Q_UNUSED(error);
-    return styles;
-}
-
-void StyleSourceBrowser::addFileEntry(QTreeWidgetItem *parentItem, const QString &rootPath, const QString &filePath)
+void StyleSourceBrowser::addFileEntry(QTreeWidgetItem *parentItem, const QString &rootPath, const QString &filePath, const QStringList &styleEntries)
 {
     if(!parentItem)
         return;
@@ -154,7 +280,6 @@ void StyleSourceBrowser::addFileEntry(QTreeWidgetItem *parentItem, const QString
     fileItem->setData(0, RoleType, static_cast<int>(EntryType::File));
     parentItem->addChild(fileItem);
 
-    const QStringList styleEntries = collectStyleEntries(filePath);
     const QString fileLabel = QFileInfo(filePath).fileName();
     for(const QString &styleName : styleEntries)
     {
@@ -170,6 +295,7 @@ void StyleSourceBrowser::addFileEntry(QTreeWidgetItem *parentItem, const QString
         entry.styleName = styleName;
         entry.displayName = display;
         m_styleEntries.push_back(entry);
+        m_searchIndex.add(styleName + QStringLiteral("  ") + cleanedPath(relative));
     }
 
     if(!styleEntries.isEmpty())
@@ -2,22 +2,33 @@
 #define STYLESOURCEBROWSER_H
 
 #include <QFrame>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
 #include <QTreeWidget>
 #include <QVBoxLayout>
 #include <QStringList>
 #include <QVector>
+#include <QHash>
 
 #include "otui/parser.h"
+#include "stylelistcache.h"
+#include "fuzzyindex.h"
 
 class StyleSourceBrowser : public QFrame
 {
     Q_OBJECT
 public:
     explicit StyleSourceBrowser(QWidget *parent = nullptr);
+    ~StyleSourceBrowser() override;
 
     void setDataPath(const QString &path);
+    // File the style names of the listed files are remembered in between sessions.
+    void setCachePath(const QString &path);
     void initialize();
+    // Lists the files on a worker; the tree fills in as each one is read.
     void refresh();
+    bool isIndexing() const { return m_indexWatcher != nullptr; }
 
     struct StyleTemplateEntry {
         QString filePath;
@@ -34,11 +45,22 @@ private slots:
     void handleItemDoubleClicked(QTreeWidgetItem *item, int column);
 
 private:
+    struct IndexedFile {
+        QString rootTitle;
+        QString rootPath;
+        QString filePath;
+        QStringList styles;
+    };
+
     void rebuildTree();
-    void addRootListing(const QString &title, const QString &rootPath);
-    QStringList collectOtuiFiles(const QString &rootPath) const;
-    QStringList collectStyleEntries(const QString &filePath) const;
-    void addFileEntry(QTreeWidgetItem *parentItem, const QString &rootPath, const QString &filePath);
+    void stopIndexing();
+    void addIndexedFiles(int begin, int end);
+    void finishIndexing();
+    QTreeWidgetItem *rootItem(const QString &title, const QString &rootPath);
+    // Lists the styles matching the search box instead of the tree.
+    void updateSearchResults();
+    static QStringList collectOtuiFiles(const QString &rootPath);
+    void addFileEntry(QTreeWidgetItem *parentItem, const QString &rootPath, const QString &filePath, const QStringList &styleEntries);
 
     enum class EntryType {
         File,
@@ -48,8 +70,19 @@ private:
 private:
     QString m_dataPath;
     QTreeWidget *m_tree;
+    QLabel *m_indexingLabel;
+    QLineEdit *m_searchEdit;
+    QTreeWidget *m_searchResults;
     OTUI::Parser m_parser;
     QVector<StyleTemplateEntry> m_styleEntries;
+    // Ids are indexes into m_styleEntries.
+    FuzzyIndex m_searchIndex;
+    QString m_cachePath;
+    // Only the running worker uses the cache and the parser until it finishes.
+    StyleListCache m_styleCache;
+    QFutureWatcher<IndexedFile> *m_indexWatcher = nullptr;
+    QHash<QString, QTreeWidgetItem*> m_rootItems;
+    int m_indexedFiles = 0;
 };
 
 #endif // STYLESOURCEBROWSER_H
@@ -24,9 +24,24 @@ static OTUINode* node_new(const char* name, int indent) {
     n->events = NULL;
     n->nevents = 0;
     n->cevents = 0;
+    n->src_begin = -1;
+    n->src_props_end = -1;
+    n->src_end = -1;
     return n;
 }
 
+static void prop_clear_span(OTUIProp* prop) {
+    prop->line_begin = prop->line_end = -1;
+    prop->value_begin = prop->value_end = -1;
+}
+
+// Extends the source span of every open node up to end.
+static void mark_end(OTUINode** stack, int stack_top, long end) {
+    for(int i=1;i<stack_top;i++) {
+        if(stack[i]->src_end < end) stack[i]->src_end = end;
+    }
+}
+
 static void node_add_child(OTUINode* parent, OTUINode* child) {
     if(!parent || !child) return;
     if(parent->nchildren == parent->cchildren) {
@@ -49,6 +64,7 @@ static void node_add_prop(OTUINode* node, const char* key, const char* value) {
     node->props[node->nprops].key = str_dup(key);
     node->props[node->nprops].value = str_dup(value);
     node->props[node->nprops].comment = NULL;
+    prop_clear_span(&node->props[node->nprops]);
     node->nprops++;
 }
 
@@ -63,6 +79,7 @@ static void state_add_prop(OTUIState* state, const char* key, const char* value)
     state->props[state->nprops].key = str_dup(key);
     state->props[state->nprops].value = str_dup(value);
     state->props[state->nprops].comment = NULL;
+    prop_clear_span(&state->props[state->nprops]);
     state->nprops++;
 }
 
@@ -219,12 +236,18 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
     OTUIState* current_state = NULL;
     bool line_ready = false;
     char* pending_comment = NULL;
+    // Byte offsets for source spans; lead is the whitespace trim() takes off the line start.
+    long read_pos = 0, line_begin = 0, line_end = 0, pending_begin = -1;
+    size_t lead = 0;
 
     char line[4096]; size_t lineno=0;
     while(line_ready || fgets(line, sizeof(line), f)) {
         int indent = 0;
         char* comment_text = NULL;
         if(!line_ready) {
+            line_begin = read_pos;
+            read_pos = ftell(f);
+            line_end = read_pos;
             lineno++;
             size_t ln = strlen(line);
             while(ln>0 && (line[ln-1]=='\n' || line[ln-1]=='\r')) line[--ln]='\0';
@@ -270,11 +293,13 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                 trim(comment_text);
             }
             
+            lead = strspn(line, " \t");
             trim(line);
             
             // If line is empty after removing comment, save comment for next node
             if(line[0]=='\0') {
                 if(comment_text) {
+                    if(!pending_comment) pending_begin = line_begin;
                     if(pending_comment) {
                         size_t len1 = strlen(pending_comment);
                         size_t len2 = strlen(comment_text);
@@ -294,6 +319,7 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
         } else {
             // For line_ready, calculate indent from the line we saved
             indent = count_indent(line);
+            lead = 0;
         }
         line_ready = false;
         
@@ -336,10 +362,13 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                     }
                     
                     char next_line[4096];
+                    long code_end = line_end;
                     int event_base_indent = widget_node->indent;  // Event code must be indented more than the widget
                     // fprintf(stderr, "DEBUG: Starting multiline event, widget=%s, widget_indent=%d\n", widget_node->name, event_base_indent);
                     // Read multiline event code
                     while(fgets(next_line, sizeof(next_line), f)) {
+                        long next_begin = read_pos;
+                        read_pos = ftell(f);
                         lineno++;
                         size_t ln = strlen(next_line);
                         while(ln>0 && (next_line[ln-1]=='\n' || next_line[ln-1]=='\r')) next_line[--ln]='\0';
@@ -361,6 +390,8 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                             // fprintf(stderr, "    -> Copying next_line='%s' to line buffer\n", next_line);
                             strcpy(line, next_line);
                             // fprintf(stderr, "    -> line buffer now='%s', indent should be %d\n", line, line_indent);
+                            line_begin = next_begin;
+                            line_end = read_pos;
                             line_ready = true;
                             break;
                         }
@@ -385,6 +416,7 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                         }
                         strcpy(full_code + code_len, next_line);
                         code_len += strlen(next_line);
+                        code_end = read_pos;
                     }
                     
                     // Add event to current node
@@ -397,6 +429,7 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                     
                     node_add_event(cur, event_name_buf, full_code, multiline);
                     free(full_code);
+                    mark_end(stack, stack_top, code_end);
                     
                     // If we have a line ready, it will be processed in next iteration
                     // We must continue here to avoid processing with stale content pointer
@@ -412,6 +445,7 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                     }
                     
                     node_add_event(cur, event_name_buf, event_code, multiline);
+                    mark_end(stack, stack_top, line_end);
                 }
                 
                 continue;
@@ -448,6 +482,7 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
                 
                 // Create state and keep it as current
                 current_state = node_add_state(cur, cond, negated);
+                mark_end(stack, stack_top, line_end);
                 continue;
             }
         }
@@ -496,9 +531,13 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
             if(base_style) {
                 node->base_style = str_dup(base_style);
             }
+            node->src_begin = pending_comment ? pending_begin : line_begin;
+            node->src_props_end = line_end;
+            node->src_end = line_end;
             if(pending_comment) {
                 node->comment_before = pending_comment;
                 pending_comment = NULL;
+                pending_begin = -1;
             }
             if(comment_text) {
                 node->comment_inline = comment_text;
@@ -506,10 +545,14 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
             }
             node_add_child(parent, node);
             stack[stack_top++] = node;
+            mark_end(stack, stack_top, line_end);
         } else {
             *colon='\0';
             char* key = content; trim(key);
-            char* val = colon+1; trim(val);
+            char* val = colon+1;
+            long value_begin = line_begin + (long)lead + (long)(val - line) + (long)strspn(val, " \t");
+            trim(val);
+            long value_end = value_begin + (long)strlen(val);
             // property attaches to current state or node
             OTUINode* cur = stack_top>0 ? stack[stack_top-1] : NULL;
             if(!cur || cur==root) {
@@ -518,20 +561,92 @@ OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz) {
             }
             
             // Add to state if we're in one, otherwise to node
+            size_t before = current_state ? current_state->nprops : cur->nprops;
+            OTUIProp* added = NULL;
             if(current_state) {
                 state_add_prop(current_state, key, val);
-                if(comment_text && current_state->nprops > 0) {
-                    current_state->props[current_state->nprops-1].comment = comment_text;
-                    comment_text = NULL;
-                }
+                if(current_state->nprops > before) added = &current_state->props[current_state->nprops-1];
             } else {
                 node_add_prop(cur, key, val);
-                if(comment_text && cur->nprops > 0) {
-                    cur->props[cur->nprops-1].comment = comment_text;
+                if(cur->nprops > before) {
+                    added = &cur->props[cur->nprops-1];
+                    cur->src_props_end = line_end;
+                }
+            }
+            if(added) {
+                added->line_begin = line_begin;
+                added->line_end = line_end;
+                added->value_begin = value_begin;
+                added->value_end = value_end;
+                if(comment_text) {
+                    added->comment = comment_text;
                     comment_text = NULL;
                 }
             }
+            mark_end(stack, stack_top, line_end);
+        }
+    }
+
+    fclose(f);
+    return root;
+}
+
+// Lê apenas as linhas de cabeçalho do nível superior; o resto do arquivo é
+// pulado sem alocar propriedades, estados, eventos ou filhos.
+OTUINode* otui_parse_headers(const char* filepath, char* errbuf, size_t errsz) {
+    FILE* f = NULL;
+#ifdef _WIN32
+    fopen_s(&f, filepath, "rb");
+#else
+    f = fopen(filepath, "rb");
+#endif
+    if(!f) {
+        if(errbuf && errsz) snprintf(errbuf, errsz, "cannot open file");
+        return NULL;
+    }
+
+    OTUINode* root = node_new("__root__", -1);
+    // Indentação do último nó de nível superior; linhas mais fundas pertencem a ele.
+    int top_indent = -1;
+    long read_pos = 0;
+    bool continuation = false;
+    char line[4096];
+    while(fgets(line, sizeof(line), f)) {
+        long line_begin = read_pos;
+        size_t ln = strlen(line);
+        read_pos += (long)ln;
+        // Restante de uma linha maior que o buffer
+        bool skip = continuation;
+        continuation = ln > 0 && line[ln-1] != '\n';
+        if(skip) continue;
+
+        while(ln>0 && (line[ln-1]=='\n' || line[ln-1]=='\r')) line[--ln]='\0';
+        int indent = count_indent(line);
+        char* content = line + strspn(line, " \t");
+        if(*content=='\0' || *content=='#' || *content=='@' || *content=='$') continue;
+        if(top_indent >= 0 && indent > top_indent) continue;
+        if(strchr(content, ':')) continue;
+
+        for(size_t i = strlen(content); i > 0; i--) {
+            if(content[i-1] == '#' && (i == 1 || content[i-2] == ' ' || content[i-2] == '\t')) {
+                content[i-1] = '\0';
+                break;
+            }
         }
+        char* base_style = strchr(content, '<');
+        if(base_style) {
+            *base_style++ = '\0';
+            trim(base_style);
+        }
+        trim(content);
+        if(content[0]=='\0') continue;
+
+        top_indent = indent;
+        OTUINode* node = node_new(content, indent);
+        if(base_style) node->base_style = str_dup(base_style);
+        node->src_begin = line_begin;
+        node->src_props_end = read_pos;
+        node_add_child(root, node);
     }
 
     fclose(f);
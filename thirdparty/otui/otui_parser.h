@@ -13,6 +13,10 @@ typedef struct OTUIProp {
     char* key;
     char* value;
     char* comment;           // Inline comment after property
+    long line_begin;         // Byte span of the property line in the source,
+    long line_end;           // including its newline; -1 if not read from a file
+    long value_begin;        // Byte span of the trimmed value
+    long value_end;
 } OTUIProp;
 
 typedef struct OTUIState {
@@ -47,10 +51,16 @@ typedef struct OTUINode {
     struct OTUINode** children;
     size_t nchildren;
     size_t cchildren;
+    long src_begin;          // First byte of the node, its leading comments included
+    long src_props_end;      // End of the header line or of the last node level property line
+    long src_end;            // End of the last line of the node and its children
 } OTUINode;
 
 // Parse OTUI/OTML-like file into a node tree. Returns NULL on error.
 OTUINode* otui_parse_file(const char* filepath, char* errbuf, size_t errsz);
+// Lê só os nós de nível superior: name, base_style, indent e src_begin, sem
+// propriedades nem filhos. Para listar estilos sem o parse completo.
+OTUINode* otui_parse_headers(const char* filepath, char* errbuf, size_t errsz);
 void otui_free(OTUINode* node);
 
 // Helpers
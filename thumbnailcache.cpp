@@ -0,0 +1,241 @@
+#include "thumbnailcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr int kMemoryBudgetKiB = 64 * 1024;
+constexpr qint64 kDiskBudget = 256 * 1024 * 1024;
+// Entries of files not seen this session are dropped past this many.
+constexpr int kIndexLimit = 65536;
+constexpr quint32 kIndexMagic = 0x4F545448; // "OTTH"
+constexpr quint16 kIndexVersion = 1;
+
+QString memoryKey(const QString &path, qint64 modified)
+{
+    // An image edited on disk gets a new thumbnail.
+    return path + QLatin1Char(':') + QString::number(modified);
+}
+
+// Reading a cached thumbnail marks it as used for pruning.
+bool loadCached(const QString &path, QImage &image)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadWrite) && !file.open(QIODevice::ReadOnly))
+        return false;
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    return image.load(&file, "PNG");
+}
+}
+
+ThumbnailCache::ThumbnailCache(int size, QObject *parent)
+    : QObject(parent), m_directory(defaultDirectory()), m_size(size), m_images(kMemoryBudgetKiB)
+{
+    // Leaves a core to the GUI thread while a large folder is decoded.
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    QDir().mkpath(m_directory);
+    loadIndex();
+
+    // Not on m_pool, so cancelPending() cannot drop it.
+    const QString directory = m_directory;
+    QThreadPool::globalInstance()->start([directory]() {
+        prune(directory, kDiskBudget);
+    });
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+    saveIndex();
+}
+
+QImage ThumbnailCache::thumbnail(const QString &path)
+{
+    const QFileInfo info(path);
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const QString key = memoryKey(path, modified);
+    if(const QImage *image = m_images.object(key))
+        return *image;
+    if(m_pending.contains(key))
+        return QImage();
+
+    QByteArray knownHash;
+    const qint64 fileSize = info.size();
+    const auto entry = m_index.constFind(path);
+    if(entry != m_index.cend() && entry->size == fileSize && entry->modified == modified)
+        knownHash = entry->hash;
+    m_indexUsed.insert(path);
+
+    m_pending.insert(key);
+    const int size = m_size;
+    const QString directory = m_directory;
+    m_pool.start([this, path, key, size, directory, knownHash, fileSize, modified]() {
+        const Rendered rendered = render(path, size, directory, knownHash);
+        // The destructor waits for the pool, so this outlives the task.
+        QMetaObject::invokeMethod(this, [this, path, key, rendered, knownHash, fileSize, modified]() {
+            m_pending.remove(key);
+            // Failures are kept too, so a broken file is not rendered again on every repaint.
+            m_images.insert(key, new QImage(rendered.image), qMax<qsizetype>(1, rendered.image.sizeInBytes() / 1024));
+            if(!rendered.hash.isEmpty() && rendered.hash != knownHash)
+            {
+                m_index.insert(path, IndexEntry{fileSize, modified, rendered.hash});
+                m_indexChanged = true;
+            }
+            emit thumbnailReady(path, rendered.image);
+        }, Qt::QueuedConnection);
+    });
+    return QImage();
+}
+
+void ThumbnailCache::cancelPending()
+{
+    m_pool.clear();
+    m_pending.clear();
+}
+
+QString ThumbnailCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/thumbnails");
+}
+
+ThumbnailCache::Rendered ThumbnailCache::render(const QString &path, int size, const QString &directory, const QByteArray &knownHash)
+{
+    Rendered rendered;
+    // The file is unchanged since it was hashed; its thumbnail needs no read of it.
+    if(!knownHash.isEmpty() && loadCached(cachedPath(directory, knownHash, size), rendered.image))
+    {
+        rendered.hash = knownHash;
+        return rendered;
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return rendered;
+    const QByteArray bytes = file.readAll();
+    file.close();
+
+    rendered.hash = QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex();
+    const QString cached = cachedPath(directory, rendered.hash, size);
+    if(loadCached(cached, rendered.image))
+        return rendered;
+
+    QImage image;
+    if(!image.loadFromData(bytes))
+    {
+        rendered.hash.clear();
+        return rendered;
+    }
+    // Smaller images are shown at their own size.
+    if(image.width() > size || image.height() > size)
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    QDir().mkpath(QFileInfo(cached).absolutePath());
+    QSaveFile out(cached);
+    if(out.open(QIODevice::WriteOnly) && image.save(&out, "PNG"))
+        out.commit();
+    rendered.image = image;
+    return rendered;
+}
+
+QString ThumbnailCache::cachedPath(const QString &directory, const QByteArray &hash, int size)
+{
+    const QString name = QString::fromLatin1(hash);
+    return QStringLiteral("%1/%2/%3-%4.png").arg(directory, name.left(2), name).arg(size);
+}
+
+void ThumbnailCache::prune(const QString &directory, qint64 budget)
+{
+    struct File {
+        QString path;
+        qint64 size = 0;
+        qint64 used = 0;
+    };
+    QVector<File> files;
+    qint64 total = 0;
+    QDirIterator it(directory, QStringList() << QStringLiteral("*.png"), QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        files.append({info.filePath(), info.size(), info.lastModified().toMSecsSinceEpoch()});
+        total += info.size();
+    }
+    if(total <= budget)
+        return;
+
+    // Down to three quarters, so the next session does not prune again right away.
+    std::sort(files.begin(), files.end(), [](const File &a, const File &b) {
+        return a.used < b.used;
+    });
+    const qint64 target = budget / 4 * 3;
+    for(const File &file : std::as_const(files))
+    {
+        if(total <= target)
+            break;
+        if(QFile::remove(file.path))
+            total -= file.size;
+    }
+}
+
+void ThumbnailCache::loadIndex()
+{
+    QFile file(m_directory + QStringLiteral("/index"));
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if(magic != kIndexMagic || version != kIndexVersion)
+        return;
+
+    stream >> count;
+    QHash<QString, IndexEntry> index;
+    index.reserve(static_cast<int>(qMin<quint32>(count, kIndexLimit)));
+    for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        IndexEntry entry;
+        stream >> path >> entry.size >> entry.modified >> entry.hash;
+        index.insert(path, std::move(entry));
+    }
+    if(stream.status() == QDataStream::Ok)
+        m_index = std::move(index);
+}
+
+void ThumbnailCache::saveIndex()
+{
+    if(!m_indexChanged)
+        return;
+    if(m_index.size() > kIndexLimit)
+    {
+        for(auto it = m_index.begin(); it != m_index.end();)
+            it = m_indexUsed.contains(it.key()) ? std::next(it) : m_index.erase(it);
+    }
+
+    QSaveFile file(m_directory + QStringLiteral("/index"));
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << kIndexMagic << kIndexVersion << static_cast<quint32>(m_index.size());
+    for(auto it = m_index.cbegin(); it != m_index.cend(); ++it)
+        stream << it.key() << it->size << it->modified << it->hash;
+    if(stream.status() == QDataStream::Ok && file.commit())
+        m_indexChanged = false;
+}
@@ -0,0 +1,67 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+// Thumbnails of image files, decoded and scaled on a thread pool. Each one
+// is also written to a directory under the hash of the file's contents, so
+// the same image is only decoded once across folders and sessions. An index
+// of each file's size, mtime and hash lets a disk hit skip reading the file;
+// the least recently used thumbnails leave the directory over its budget.
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailCache(int size, QObject *parent = nullptr);
+    ~ThumbnailCache() override;
+
+    int size() const { return m_size; }
+    // The thumbnail when it is in memory; otherwise a null image, and
+    // thumbnailReady follows once it has been read or rendered. Files that
+    // cannot be decoded stay null without being tried again until they change.
+    QImage thumbnail(const QString &path);
+    // Forgets the requests that have not started, e.g. for a folder no longer shown.
+    void cancelPending();
+
+    static QString defaultDirectory();
+
+signals:
+    void thumbnailReady(const QString &path, const QImage &image);
+
+private:
+    struct Rendered {
+        QImage image;
+        QByteArray hash;
+    };
+    // Content hash of a file as it was last read.
+    struct IndexEntry {
+        qint64 size = 0;
+        qint64 modified = 0;
+        QByteArray hash;
+    };
+
+    static Rendered render(const QString &path, int size, const QString &directory, const QByteArray &knownHash);
+    static QString cachedPath(const QString &directory, const QByteArray &hash, int size);
+    static void prune(const QString &directory, qint64 budget);
+    void loadIndex();
+    void saveIndex();
+
+    QThreadPool m_pool;
+    QString m_directory;
+    int m_size;
+    // Cost in KiB; a null image marks a file that failed to decode.
+    QCache<QString, QImage> m_images;
+    QSet<QString> m_pending;
+    QHash<QString, IndexEntry> m_index;
+    QSet<QString> m_indexUsed;
+    bool m_indexChanged = false;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,283 @@
+#include "widgetcommands.h"
+
+#include <QColor>
+#include <QMargins>
+
+namespace {
+OTUI::AnchorEdge anchorEdgeFor(WidgetProperty property)
+{
+    switch(property)
+    {
+    case WidgetProperty::AnchorLeft:
+        return OTUI::AnchorEdge::Left;
+    case WidgetProperty::AnchorRight:
+        return OTUI::AnchorEdge::Right;
+    case WidgetProperty::AnchorTop:
+        return OTUI::AnchorEdge::Top;
+    case WidgetProperty::AnchorBottom:
+        return OTUI::AnchorEdge::Bottom;
+    case WidgetProperty::AnchorHorizontalCenter:
+        return OTUI::AnchorEdge::HorizontalCenter;
+    case WidgetProperty::AnchorVerticalCenter:
+        return OTUI::AnchorEdge::VerticalCenter;
+    default:
+        return OTUI::AnchorEdge::None;
+    }
+}
+
+QString propertyLabel(WidgetProperty property)
+{
+    switch(property)
+    {
+    case WidgetProperty::Id:
+        return QStringLiteral("Rename");
+    case WidgetProperty::Text:
+        return QStringLiteral("Change Text");
+    case WidgetProperty::Geometry:
+        return QStringLiteral("Move/Resize");
+    case WidgetProperty::Opacity:
+        return QStringLiteral("Change Opacity");
+    case WidgetProperty::Visible:
+        return QStringLiteral("Change Visibility");
+    case WidgetProperty::Phantom:
+        return QStringLiteral("Change Phantom");
+    case WidgetProperty::Color:
+        return QStringLiteral("Change Color");
+    case WidgetProperty::ImageSource:
+        return QStringLiteral("Change Image");
+    case WidgetProperty::ImageBorder:
+        return QStringLiteral("Change Image Border");
+    case WidgetProperty::Margin:
+        return QStringLiteral("Change Margin");
+    case WidgetProperty::Padding:
+        return QStringLiteral("Change Padding");
+    default:
+        return QStringLiteral("Change Anchors");
+    }
+}
+
+QMargins toMargins(const OTUI::EdgeGroup<int> &edges)
+{
+    return QMargins(edges.left, edges.top, edges.right, edges.bottom);
+}
+
+qsizetype variantBytes(const QVariant &value)
+{
+    // Only strings carry heap data worth counting; the rest fit in the variant.
+    if(value.typeId() == QMetaType::QString)
+        return value.toString().capacity() * static_cast<qsizetype>(sizeof(QChar));
+    return 0;
+}
+}
+
+PropertyEditCommand::PropertyEditCommand(OpenGLWidget *canvas, OTUI::Widget *widget, QVector<Change> changes, const QString &dataPath)
+    : m_canvas(canvas),
+      m_widget(widget),
+      m_changes(std::move(changes)),
+      m_dataPath(dataPath)
+{
+    m_changes.squeeze();
+}
+
+QVariant PropertyEditCommand::read(const OTUI::Widget &widget, WidgetProperty property)
+{
+    switch(property)
+    {
+    case WidgetProperty::Id:
+        return widget.getId();
+    case WidgetProperty::Text:
+        return widget.textProperty();
+    case WidgetProperty::Geometry:
+        return QRect(widget.getPos(), QSize(widget.getSize().x(), widget.getSize().y()));
+    case WidgetProperty::Opacity:
+        return static_cast<double>(widget.opacity());
+    case WidgetProperty::Visible:
+        return widget.isVisible();
+    case WidgetProperty::Phantom:
+        return widget.isPhantom();
+    case WidgetProperty::Color:
+        return widget.getColor();
+    case WidgetProperty::ImageSource:
+        return widget.imageSource();
+    case WidgetProperty::ImageBorder:
+        return widget.getImageBorder();
+    case WidgetProperty::Margin:
+        return toMargins(widget.margin());
+    case WidgetProperty::Padding:
+        return toMargins(widget.padding());
+    case WidgetProperty::AnchorCenterIn:
+        return widget.centerInTarget();
+    case WidgetProperty::AnchorFill:
+        return widget.fillTarget();
+    default:
+        return widget.anchorDescriptor(anchorEdgeFor(property));
+    }
+}
+
+void PropertyEditCommand::write(OTUI::Widget &widget, WidgetProperty property, const QVariant &value, const QString &dataPath)
+{
+    switch(property)
+    {
+    case WidgetProperty::Id:
+        widget.setId(value.toString());
+        break;
+    case WidgetProperty::Text:
+        widget.setTextProperty(value.toString());
+        break;
+    case WidgetProperty::Geometry:
+        widget.setRect(value.toRect());
+        break;
+    case WidgetProperty::Opacity:
+        widget.setOpacity(static_cast<float>(value.toDouble()));
+        break;
+    case WidgetProperty::Visible:
+        widget.setVisibleProperty(value.toBool());
+        break;
+    case WidgetProperty::Phantom:
+        widget.setPhantom(value.toBool());
+        break;
+    case WidgetProperty::Color:
+        widget.setColor(value.value<QColor>());
+        break;
+    case WidgetProperty::ImageSource:
+        widget.setImageSource(value.toString(), dataPath);
+        break;
+    case WidgetProperty::ImageBorder:
+        widget.setImageBorder(value.toRect());
+        break;
+    case WidgetProperty::Margin:
+    {
+        const QMargins margins = value.value<QMargins>();
+        widget.setMarginLeft(margins.left());
+        widget.setMarginTop(margins.top());
+        widget.setMarginRight(margins.right());
+        widget.setMarginBottom(margins.bottom());
+        break;
+    }
+    case WidgetProperty::Padding:
+    {
+        const QMargins padding = value.value<QMargins>();
+        widget.setPaddingLeft(padding.left());
+        widget.setPaddingTop(padding.top());
+        widget.setPaddingRight(padding.right());
+        widget.setPaddingBottom(padding.bottom());
+        break;
+    }
+    case WidgetProperty::AnchorCenterIn:
+        widget.setCenterInTarget(value.toString());
+        break;
+    case WidgetProperty::AnchorFill:
+        widget.setFillTarget(value.toString());
+        break;
+    default:
+        widget.setAnchorFromDescriptor(anchorEdgeFor(property), value.toString());
+        break;
+    }
+}
+
+void PropertyEditCommand::undo()
+{
+    apply(false);
+}
+
+void PropertyEditCommand::redo()
+{
+    apply(true);
+}
+
+void PropertyEditCommand::apply(bool forward)
+{
+    if(!m_widget)
+        return;
+    for(const Change &change : std::as_const(m_changes))
+        write(*m_widget, change.property, forward ? change.after : change.before, m_dataPath);
+    if(m_canvas)
+        m_canvas->notifyWidgetGeometryChanged(m_widget);
+}
+
+bool PropertyEditCommand::mergeWith(const EditCommand &other)
+{
+    const auto *edit = dynamic_cast<const PropertyEditCommand*>(&other);
+    if(!edit || edit->m_widget != m_widget || edit->m_changes.size() != m_changes.size())
+        return false;
+    for(int i = 0; i < m_changes.size(); ++i)
+    {
+        if(m_changes.at(i).property != edit->m_changes.at(i).property)
+            return false;
+    }
+    for(int i = 0; i < m_changes.size(); ++i)
+        m_changes[i].after = edit->m_changes.at(i).after;
+    return true;
+}
+
+qsizetype PropertyEditCommand::byteSize() const
+{
+    qsizetype bytes = sizeof(*this) + m_changes.capacity() * static_cast<qsizetype>(sizeof(Change));
+    for(const Change &change : m_changes)
+        bytes += variantBytes(change.before) + variantBytes(change.after);
+    return bytes + m_dataPath.capacity() * static_cast<qsizetype>(sizeof(QChar));
+}
+
+QString PropertyEditCommand::text() const
+{
+    return m_changes.isEmpty() ? QString() : propertyLabel(m_changes.first().property);
+}
+
+StructureEditCommand::StructureEditCommand(OpenGLWidget *canvas, Kind kind, OTUI::Widget *root, OpenGLWidget::DetachedWidgets widgets,
+                                           const std::shared_ptr<OTUI::SourceDocument> &source)
+    : m_canvas(canvas),
+      m_kind(kind),
+      m_root(root),
+      m_detached(std::move(widgets)),
+      m_source(source)
+{
+}
+
+StructureEditCommand::~StructureEditCommand()
+{
+    // The detached widgets die with the command; their nodes must not stay bound to freed pointers.
+    if(m_detached.empty())
+        return;
+    if(const std::shared_ptr<OTUI::SourceDocument> source = m_source.lock())
+        source->forget(m_root);
+}
+
+void StructureEditCommand::undo()
+{
+    if(m_kind == Kind::Insert)
+        detach();
+    else
+        attach();
+}
+
+void StructureEditCommand::redo()
+{
+    if(m_kind == Kind::Insert)
+        attach();
+    else
+        detach();
+}
+
+void StructureEditCommand::attach()
+{
+    m_canvas->restoreWidgets(std::move(m_detached));
+    m_detached.clear();
+}
+
+void StructureEditCommand::detach()
+{
+    m_detached = m_canvas->detachWidget(m_root);
+}
+
+qsizetype StructureEditCommand::byteSize() const
+{
+    // Detached widgets are owned here; their pixmaps stay shared with the TextureManager.
+    return sizeof(*this) + static_cast<qsizetype>(m_detached.size()) *
+            static_cast<qsizetype>(sizeof(OpenGLWidget::DetachedWidgets::value_type) + sizeof(OTUI::Widget));
+}
+
+QString StructureEditCommand::text() const
+{
+    const QString id = m_root ? m_root->getId() : QString();
+    return m_kind == Kind::Insert ? QStringLiteral("Add %1").arg(id) : QStringLiteral("Delete %1").arg(id);
+}
@@ -0,0 +1,95 @@
+#ifndef WIDGETCOMMANDS_H
+#define WIDGETCOMMANDS_H
+
+#include <QVariant>
+#include <QVector>
+#include <memory>
+#include "edithistory.h"
+#include "openglwidget.h"
+#include "otui/sourcedocument.h"
+
+enum class WidgetProperty : quint8 {
+    Id,
+    Text,
+    Geometry,
+    Opacity,
+    Visible,
+    Phantom,
+    Color,
+    ImageSource,
+    ImageBorder,
+    Margin,
+    Padding,
+    AnchorLeft,
+    AnchorRight,
+    AnchorTop,
+    AnchorBottom,
+    AnchorHorizontalCenter,
+    AnchorVerticalCenter,
+    AnchorCenterIn,
+    AnchorFill
+};
+
+// Before/after values of a few properties on one widget.
+class PropertyEditCommand : public EditCommand
+{
+public:
+    struct Change {
+        WidgetProperty property;
+        QVariant before;
+        QVariant after;
+    };
+
+    PropertyEditCommand(OpenGLWidget *canvas, OTUI::Widget *widget, QVector<Change> changes, const QString &dataPath = QString());
+
+    static QVariant read(const OTUI::Widget &widget, WidgetProperty property);
+    static void write(OTUI::Widget &widget, WidgetProperty property, const QVariant &value, const QString &dataPath);
+
+    void undo() override;
+    void redo() override;
+    // Later edits of the same widget and properties keep the oldest before value.
+    bool mergeWith(const EditCommand &other) override;
+    qsizetype byteSize() const override;
+    QString text() const override;
+    OTUI::Widget *widget() const override { return m_widget; }
+
+private:
+    void apply(bool forward);
+
+    OpenGLWidget *m_canvas;
+    OTUI::Widget *m_widget;
+    QVector<Change> m_changes;
+    QString m_dataPath;
+};
+
+// Widget subtree added to or removed from the canvas. The removed side keeps
+// ownership of the detached widgets instead of copying them.
+class StructureEditCommand : public EditCommand
+{
+public:
+    enum class Kind { Insert, Remove };
+
+    // For Insert the subtree is already in the store; for Remove it was detached into widgets.
+    // source keeps the nodes of detached widgets bound until the command destroys them.
+    StructureEditCommand(OpenGLWidget *canvas, Kind kind, OTUI::Widget *root, OpenGLWidget::DetachedWidgets widgets = {},
+                         const std::shared_ptr<OTUI::SourceDocument> &source = nullptr);
+    ~StructureEditCommand() override;
+
+    void undo() override;
+    void redo() override;
+    qsizetype byteSize() const override;
+    QString text() const override;
+    OTUI::Widget *widget() const override { return m_root; }
+
+private:
+    void attach();
+    void detach();
+
+    OpenGLWidget *m_canvas;
+    Kind m_kind;
+    OTUI::Widget *m_root;
+    OpenGLWidget::DetachedWidgets m_detached;
+    std::weak_ptr<OTUI::SourceDocument> m_source;
+};
+
+#endif // WIDGETCOMMANDS_H
@@ -0,0 +1,218 @@
+#include "widgettreemodel.h"
+
+#include <QSet>
+#include <algorithm>
+#include <limits>
+
+namespace {
+const QVector<OTUI::Widget*> kNoChildren;
+}
+
+WidgetTreeModel::WidgetTreeModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+}
+
+QModelIndex WidgetTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if(column != 0 || row < 0)
+        return QModelIndex();
+    const QVector<OTUI::Widget*> &children = childrenOf(widgetAt(parent));
+    if(row >= children.size())
+        return QModelIndex();
+    return createIndex(row, 0, children.at(row));
+}
+
+QModelIndex WidgetTreeModel::parent(const QModelIndex &child) const
+{
+    OTUI::Widget *widget = widgetAt(child);
+    if(!widget)
+        return QModelIndex();
+    const auto it = m_nodes.constFind(widget);
+    if(it == m_nodes.cend() || !it->parent)
+        return QModelIndex();
+    return indexOf(it->parent);
+}
+
+int WidgetTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.column() > 0)
+        return 0;
+    return childrenOf(widgetAt(parent)).size();
+}
+
+int WidgetTreeModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+QVariant WidgetTreeModel::data(const QModelIndex &index, int role) const
+{
+    OTUI::Widget *widget = widgetAt(index);
+    if(!widget || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return QVariant();
+    return widget->getId();
+}
+
+QVariant WidgetTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(section == 0 && orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return QStringLiteral("Widgets List");
+    return QVariant();
+}
+
+QModelIndex WidgetTreeModel::indexOf(OTUI::Widget *widget) const
+{
+    const auto it = m_nodes.constFind(widget);
+    if(it == m_nodes.cend())
+        return QModelIndex();
+    return createIndex(it->row, 0, widget);
+}
+
+OTUI::Widget *WidgetTreeModel::widgetAt(const QModelIndex &index)
+{
+    return index.isValid() ? static_cast<OTUI::Widget*>(index.internalPointer()) : nullptr;
+}
+
+void WidgetTreeModel::beginReset()
+{
+    beginResetModel();
+}
+
+void WidgetTreeModel::endReset(const std::vector<std::unique_ptr<OTUI::Widget>> &widgets)
+{
+    m_roots.clear();
+    m_children.clear();
+    m_nodes.clear();
+    m_nodes.reserve(static_cast<int>(widgets.size()));
+
+    // Register everything first so a parent listed after its child still counts.
+    for(const auto &widget : widgets)
+    {
+        if(widget)
+            m_nodes.insert(widget.get(), Node());
+    }
+    for(const auto &widget : widgets)
+    {
+        if(!widget)
+            continue;
+        OTUI::Widget *parent = modelParent(widget.get());
+        QVector<OTUI::Widget*> &siblings = siblingsOf(parent);
+        m_nodes[widget.get()] = Node{parent, static_cast<int>(siblings.size())};
+        siblings.append(widget.get());
+    }
+    endResetModel();
+}
+
+void WidgetTreeModel::insertWidgets(const QVector<OTUI::Widget*> &widgets, const std::vector<std::unique_ptr<OTUI::Widget>> &store)
+{
+    // Rows follow the store, which is also the order the document is saved in,
+    // so a widget put back by an undo returns to its old row.
+    QHash<const OTUI::Widget*, int> positions;
+    positions.reserve(static_cast<int>(store.size()));
+    for(std::size_t i = 0; i < store.size(); ++i)
+        positions.insert(store[i].get(), static_cast<int>(i));
+    const auto positionOf = [&positions](const OTUI::Widget *widget) {
+        return positions.value(widget, std::numeric_limits<int>::max());
+    };
+    const auto rowFor = [&positionOf](const QVector<OTUI::Widget*> &siblings, const OTUI::Widget *widget) {
+        const auto after = std::upper_bound(siblings.cbegin(), siblings.cend(), positionOf(widget),
+                                            [&positionOf](int position, const OTUI::Widget *sibling) {
+            return position < positionOf(sibling);
+        });
+        return static_cast<int>(after - siblings.cbegin());
+    };
+    const auto place = [this](QVector<OTUI::Widget*> &siblings, int row, OTUI::Widget *widget, OTUI::Widget *parent) {
+        siblings.insert(row, widget);
+        m_nodes.insert(widget, Node{parent, row});
+        for(int i = row + 1; i < siblings.size(); ++i)
+            m_nodes[siblings.at(i)].row = i;
+    };
+
+    QSet<OTUI::Widget*> incoming;
+    for(OTUI::Widget *widget : widgets)
+    {
+        if(widget && !m_nodes.contains(widget))
+            incoming.insert(widget);
+    }
+
+    // Descendants of new rows are not visible yet and need no signals.
+    QVector<OTUI::Widget*> tops;
+    for(OTUI::Widget *widget : widgets)
+    {
+        if(!incoming.contains(widget) || m_nodes.contains(widget))
+            continue;
+        OTUI::Widget *parent = widget->getParent();
+        if(parent && incoming.contains(parent))
+        {
+            QVector<OTUI::Widget*> &siblings = m_children[parent];
+            place(siblings, rowFor(siblings, widget), widget, parent);
+        }
+        else
+            tops.append(widget);
+    }
+
+    for(OTUI::Widget *widget : std::as_const(tops))
+    {
+        OTUI::Widget *parent = modelParent(widget);
+        const QModelIndex parentIndex = indexOf(parent);
+        QVector<OTUI::Widget*> &siblings = siblingsOf(parent);
+        const int row = rowFor(siblings, widget);
+        beginInsertRows(parentIndex, row, row);
+        place(siblings, row, widget, parent);
+        endInsertRows();
+    }
+}
+
+void WidgetTreeModel::removeWidget(OTUI::Widget *widget)
+{
+    const auto it = m_nodes.constFind(widget);
+    if(it == m_nodes.cend())
+        return;
+
+    OTUI::Widget *parent = it->parent;
+    const int row = it->row;
+    beginRemoveRows(indexOf(parent), row, row);
+    QVector<OTUI::Widget*> &siblings = siblingsOf(parent);
+    siblings.removeAt(row);
+    for(int i = row; i < siblings.size(); ++i)
+        m_nodes[siblings.at(i)].row = i;
+    forgetSubtree(widget);
+    if(parent && siblings.isEmpty())
+        m_children.remove(parent);
+    endRemoveRows();
+}
+
+void WidgetTreeModel::widgetChanged(OTUI::Widget *widget)
+{
+    const QModelIndex index = indexOf(widget);
+    if(index.isValid())
+        emit dataChanged(index, index, {Qt::DisplayRole});
+}
+
+const QVector<OTUI::Widget*> &WidgetTreeModel::childrenOf(OTUI::Widget *parent) const
+{
+    if(!parent)
+        return m_roots;
+    const auto it = m_children.constFind(parent);
+    return it == m_children.cend() ? kNoChildren : it.value();
+}
+
+QVector<OTUI::Widget*> &WidgetTreeModel::siblingsOf(OTUI::Widget *parent)
+{
+    return parent ? m_children[parent] : m_roots;
+}
+
+OTUI::Widget *WidgetTreeModel::modelParent(const OTUI::Widget *widget) const
+{
+    OTUI::Widget *parent = widget->getParent();
+    return parent && m_nodes.contains(parent) ? parent : nullptr;
+}
+
+void WidgetTreeModel::forgetSubtree(OTUI::Widget *widget)
+{
+    const QVector<OTUI::Widget*> children = m_children.take(widget);
+    for(OTUI::Widget *child : children)
+        forgetSubtree(child);
+    m_nodes.remove(widget);
+}
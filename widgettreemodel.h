@@ -0,0 +1,57 @@
+#ifndef WIDGETTREEMODEL_H
+#define WIDGETTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+#include <memory>
+#include <vector>
+#include "otui/otui.h"
+
+// Widget hierarchy of the canvas for the tree view. Rows point straight at
+// the widgets owned by OpenGLWidget; the canvas reports inserts and removals
+// so the view only updates the rows that changed.
+class WidgetTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    explicit WidgetTreeModel(QObject *parent = nullptr);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    QModelIndex indexOf(OTUI::Widget *widget) const;
+    static OTUI::Widget *widgetAt(const QModelIndex &index);
+
+    // The store is about to be replaced; endReset() rebuilds from the new one.
+    void beginReset();
+    void endReset(const std::vector<std::unique_ptr<OTUI::Widget>> &widgets);
+    // Widgets already added to store, parents before children; each row is
+    // placed by the widget's position in store.
+    void insertWidgets(const QVector<OTUI::Widget*> &widgets, const std::vector<std::unique_ptr<OTUI::Widget>> &store);
+    // Drops widget and its subtree; call while they are still alive.
+    void removeWidget(OTUI::Widget *widget);
+    void widgetChanged(OTUI::Widget *widget);
+
+private:
+    struct Node {
+        OTUI::Widget *parent = nullptr;
+        int row = 0;
+    };
+
+    const QVector<OTUI::Widget*> &childrenOf(OTUI::Widget *parent) const;
+    QVector<OTUI::Widget*> &siblingsOf(OTUI::Widget *parent);
+    OTUI::Widget *modelParent(const OTUI::Widget *widget) const;
+    void forgetSubtree(OTUI::Widget *widget);
+
+    QVector<OTUI::Widget*> m_roots;
+    QHash<OTUI::Widget*, QVector<OTUI::Widget*>> m_children;
+    // Parent and row of every widget, so parent() does not scan siblings.
+    QHash<OTUI::Widget*, Node> m_nodes;
+};
+
+#endif // WIDGETTREEMODEL_H
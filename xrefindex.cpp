@@ -0,0 +1,409 @@
+#include "xrefindex.h"
+#include "moduleindex.h"
+#include "thirdparty/otui/otui_parser.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QSet>
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+
+namespace {
+QString normalizedPath(const QString &path)
+{
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+qint64 modifiedTime(const QString &path)
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QString styleKey(const QString &styleName)
+{
+    return QStringLiteral("s:") + styleName.trimmed();
+}
+
+// image-source is resolved with or without the extension and the leading slash.
+QString imageKey(const QString &imageSource)
+{
+    QString source = QDir::fromNativeSeparators(imageSource.trimmed());
+    if(source.endsWith(QStringLiteral(".png"), Qt::CaseInsensitive))
+        source.chop(4);
+    if(!source.startsWith(QLatin1Char('/')))
+        source.prepend(QLatin1Char('/'));
+    return QStringLiteral("i:") + QDir::cleanPath(source);
+}
+
+QString fileKey(const QString &filePath)
+{
+    return QStringLiteral("f:") + normalizedPath(filePath);
+}
+
+class LineTable
+{
+public:
+    explicit LineTable(const QByteArray &source) : m_source(source)
+    {
+        m_starts.append(0);
+        for(qint64 i = 0; i < source.size(); ++i)
+        {
+            if(source.at(i) == '\n')
+                m_starts.append(i + 1);
+        }
+    }
+
+    int lineAt(qint64 offset) const
+    {
+        return static_cast<int>(std::upper_bound(m_starts.cbegin(), m_starts.cend(), offset) - m_starts.cbegin());
+    }
+
+    // A node's span starts at its leading comments; the header is the first other line.
+    int headerLine(const OTUINode *node) const
+    {
+        qint64 offset = node->src_begin;
+        while(offset >= 0 && offset < node->src_end && offset < m_source.size())
+        {
+            qint64 lineEnd = m_source.indexOf('\n', offset);
+            if(lineEnd < 0)
+                lineEnd = m_source.size();
+            const QByteArray line = m_source.mid(offset, lineEnd - offset).trimmed();
+            if(!line.isEmpty() && !line.startsWith('#'))
+                break;
+            offset = lineEnd + 1;
+        }
+        return lineAt(qMax<qint64>(offset, 0));
+    }
+
+private:
+    const QByteArray &m_source;
+    QVector<qint64> m_starts;
+};
+}
+
+XRefIndex::XRefIndex(QObject *parent) : QObject(parent)
+{
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &XRefIndex::handleDirectoryChanged);
+}
+
+XRefIndex::~XRefIndex() = default;
+
+void XRefIndex::setRoots(const QStringList &roots)
+{
+    m_roots = roots;
+    const int generation = ++m_generation;
+    m_building = true;
+
+    auto *watcher = new QFutureWatcher<Build>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if(generation != m_generation || watcher->future().resultCount() == 0)
+            return;
+
+        Build build = watcher->result();
+        const QStringList watched = m_watcher.directories();
+        if(!watched.isEmpty())
+            m_watcher.removePaths(watched);
+
+        m_files = std::move(build.files);
+        m_modified = std::move(build.modified);
+        m_requests.clear();
+        m_postings.clear();
+        for(auto it = m_files.cbegin(); it != m_files.cend(); ++it)
+            addSymbols(it.value());
+        addSymbols(m_moduleSymbols);
+
+        if(!build.directories.isEmpty())
+            m_watcher.addPaths(build.directories);
+        m_building = false;
+
+        // Files that changed while the build was reading them.
+        const QSet<QString> stale = std::exchange(m_staleFiles, {});
+        for(const QString &path : stale)
+            reindexFile(path);
+        emit updated();
+    });
+
+    watcher->setFuture(QtConcurrent::run([roots]() {
+        QStringList files;
+        QSet<QString> seen;
+        QSet<QString> directories;
+        for(const QString &root : roots)
+        {
+            if(root.isEmpty() || !QFileInfo(root).isDir())
+                continue;
+            directories.insert(normalizedPath(root));
+            // Every directory is watched, so files added where there were none are seen too.
+            QDirIterator it(root, QStringList() << QStringLiteral("*.otui"), QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot,
+                            QDirIterator::Subdirectories);
+            while(it.hasNext())
+            {
+                const QString path = normalizedPath(it.next());
+                if(it.fileInfo().isDir())
+                {
+                    directories.insert(path);
+                    continue;
+                }
+                if(seen.contains(path))
+                    continue;
+                seen.insert(path);
+                files << path;
+            }
+        }
+
+        Build build;
+        // Taken before parsing; a write during the build shows up as a newer mtime.
+        for(const QString &path : std::as_const(files))
+            build.modified.insert(path, modifiedTime(path));
+        const QVector<QVector<Symbol>> parsed = QtConcurrent::blockingMapped<QVector<QVector<Symbol>>>(files, &XRefIndex::indexFile);
+        for(int i = 0; i < files.size(); ++i)
+            build.files.insert(files.at(i), parsed.at(i));
+        build.directories = directories.values();
+        return build;
+    }));
+}
+
+void XRefIndex::setModules(const std::shared_ptr<const ModuleIndex> &modules)
+{
+    removeSymbols(m_moduleSymbols);
+    m_moduleSymbols.clear();
+    if(modules)
+    {
+        for(const ModuleIndex::Module &module : modules->modules())
+        {
+            for(const ModuleScanner::Entry &entry : module.result.entries)
+            {
+                Symbol symbol;
+                symbol.key = fileKey(entry.absolutePath);
+                symbol.location.kind = Kind::UiReference;
+                symbol.location.filePath = module.otmodPath;
+                symbol.location.context = module.result.moduleName + QStringLiteral(": ") + entry.label;
+                m_moduleSymbols.append(std::move(symbol));
+            }
+        }
+    }
+    addSymbols(m_moduleSymbols);
+    emit updated();
+}
+
+QVector<XRefIndex::Location> XRefIndex::definitions(const QString &styleName) const
+{
+    return lookup(styleKey(styleName), Kind::StyleDefinition);
+}
+
+QVector<XRefIndex::Location> XRefIndex::styleUsages(const QString &styleName) const
+{
+    return lookup(styleKey(styleName), Kind::StyleReference);
+}
+
+QVector<XRefIndex::Location> XRefIndex::imageUsages(const QString &imageSource) const
+{
+    return lookup(imageKey(imageSource), Kind::ImageReference);
+}
+
+QVector<XRefIndex::Location> XRefIndex::fileUsages(const QString &otuiPath) const
+{
+    return lookup(fileKey(otuiPath), Kind::UiReference);
+}
+
+QVector<XRefIndex::Symbol> XRefIndex::indexFile(const QString &filePath)
+{
+    QVector<Symbol> symbols;
+    QFile file(filePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return symbols;
+    const QByteArray source = file.readAll();
+    file.close();
+
+    char errbuf[256] = {0};
+    OTUINode *root = otui_parse_file(QFile::encodeName(filePath).constData(), errbuf, sizeof(errbuf));
+    if(!root)
+        return symbols;
+
+    const LineTable lines(source);
+    const auto add = [&](const QString &key, Kind kind, int line, const QString &context) {
+        Symbol symbol;
+        symbol.key = key;
+        symbol.location.kind = kind;
+        symbol.location.filePath = filePath;
+        symbol.location.line = line;
+        symbol.location.context = context;
+        symbols.append(std::move(symbol));
+    };
+
+    const std::function<void(const OTUINode*, bool)> visit = [&](const OTUINode *node, bool topLevel) {
+        const QString name = QString::fromUtf8(node->name);
+        const QString baseStyle = node->base_style ? QString::fromUtf8(node->base_style) : QString();
+        QString header = baseStyle.isEmpty() ? name : name + QStringLiteral(" < ") + baseStyle;
+        const char *id = otui_prop_get(node, "id");
+        if(id && *id)
+            header += QStringLiteral(" (") + QString::fromUtf8(id) + QLatin1Char(')');
+
+        const int line = lines.headerLine(node);
+        if(!name.isEmpty())
+            add(styleKey(name), topLevel ? Kind::StyleDefinition : Kind::StyleReference, line, header);
+        if(!baseStyle.isEmpty())
+            add(styleKey(baseStyle), Kind::StyleReference, line, header);
+
+        for(size_t i = 0; i < node->nprops; ++i)
+        {
+            const OTUIProp &prop = node->props[i];
+            if(!prop.key || !prop.value || qstrcmp(prop.key, "image-source") != 0)
+                continue;
+            const int propLine = prop.line_begin >= 0 ? lines.lineAt(prop.line_begin) : line;
+            add(imageKey(QString::fromUtf8(prop.value)), Kind::ImageReference, propLine, header);
+        }
+        for(size_t i = 0; i < node->nstates; ++i)
+        {
+            const OTUIState &state = node->states[i];
+            for(size_t j = 0; j < state.nprops; ++j)
+            {
+                const OTUIProp &prop = state.props[j];
+                if(prop.key && prop.value && qstrcmp(prop.key, "image-source") == 0)
+                    add(imageKey(QString::fromUtf8(prop.value)), Kind::ImageReference, line, header);
+            }
+        }
+
+        for(size_t i = 0; i < node->nchildren; ++i)
+            visit(node->children[i], false);
+    };
+    for(size_t i = 0; i < root->nchildren; ++i)
+        visit(root->children[i], true);
+
+    otui_free(root);
+    return symbols;
+}
+
+void XRefIndex::addSymbols(const QVector<Symbol> &symbols)
+{
+    for(const Symbol &symbol : symbols)
+        m_postings[symbol.key].append(symbol.location);
+}
+
+void XRefIndex::removeSymbols(const QVector<Symbol> &symbols)
+{
+    for(const Symbol &symbol : symbols)
+    {
+        auto it = m_postings.find(symbol.key);
+        if(it == m_postings.end())
+            continue;
+        const QString &filePath = symbol.location.filePath;
+        it->removeIf([&filePath](const Location &location) {
+            return location.filePath == filePath;
+        });
+        if(it->isEmpty())
+            m_postings.erase(it);
+    }
+}
+
+void XRefIndex::applyFile(const QString &filePath, const QVector<Symbol> &symbols, qint64 modified)
+{
+    const auto it = m_files.constFind(filePath);
+    if(it != m_files.cend())
+        removeSymbols(it.value());
+    if(modified < 0)
+    {
+        m_files.remove(filePath);
+        m_modified.remove(filePath);
+        return;
+    }
+    m_files.insert(filePath, symbols);
+    m_modified.insert(filePath, modified);
+    addSymbols(symbols);
+}
+
+void XRefIndex::reindexFile(const QString &filePath)
+{
+    const int generation = m_generation;
+    const quint64 request = ++m_nextRequest;
+    m_requests.insert(filePath, request);
+    // Recorded before reading, so a write during the parse triggers another one.
+    const qint64 modified = modifiedTime(filePath);
+    auto *watcher = new QFutureWatcher<QVector<Symbol>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation, request, modified, filePath]() {
+        watcher->deleteLater();
+        if(generation != m_generation || watcher->future().resultCount() == 0)
+            return;
+        if(m_requests.value(filePath) != request)
+            return;
+        m_requests.remove(filePath);
+        if(m_building)
+        {
+            m_staleFiles.insert(filePath);
+            return;
+        }
+        applyFile(filePath, watcher->result(), modified);
+        emit updated();
+    });
+    watcher->setFuture(QtConcurrent::run(&XRefIndex::indexFile, filePath));
+}
+
+void XRefIndex::handleDirectoryChanged(const QString &dirPath)
+{
+    // Saves through QSaveFile replace the file, which changes the directory;
+    // the mtime tells which files actually differ from what was indexed.
+    const QDir dir(dirPath);
+    if(!dir.exists())
+        m_watcher.removePath(dirPath);
+
+    const QStringList watched = m_watcher.directories();
+    QStringList changed;
+    QSet<QString> present;
+    const QFileInfoList entries = dir.entryInfoList(QStringList() << QStringLiteral("*.otui"), QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot);
+    for(const QFileInfo &entry : entries)
+    {
+        const QString path = normalizedPath(entry.absoluteFilePath());
+        if(entry.isDir())
+        {
+            // A new directory may already hold files by the time it is seen.
+            if(!watched.contains(path) && m_watcher.addPath(path))
+                handleDirectoryChanged(path);
+            continue;
+        }
+        present.insert(path);
+        const auto known = m_modified.constFind(path);
+        if(known == m_modified.cend() || known.value() != entry.lastModified().toMSecsSinceEpoch())
+            changed << path;
+    }
+
+    // Removed files of this directory, including those of a removed subdirectory tree.
+    const QString prefix = normalizedPath(dirPath) + QLatin1Char('/');
+    for(auto it = m_modified.cbegin(); it != m_modified.cend(); ++it)
+    {
+        if(it.key().startsWith(prefix) && !present.contains(it.key()) && !QFileInfo::exists(it.key()))
+            changed << it.key();
+    }
+
+    for(const QString &path : std::as_const(changed))
+    {
+        if(m_building)
+            m_staleFiles.insert(path);
+        else
+            reindexFile(path);
+    }
+}
+
+QVector<XRefIndex::Location> XRefIndex::lookup(const QString &key, Kind kind) const
+{
+    QVector<Location> locations;
+    const auto it = m_postings.constFind(key);
+    if(it == m_postings.cend())
+        return locations;
+    for(const Location &location : it.value())
+    {
+        if(location.kind == kind)
+            locations.append(location);
+    }
+    std::sort(locations.begin(), locations.end(), [](const Location &a, const Location &b) {
+        if(a.filePath != b.filePath)
+            return a.filePath < b.filePath;
+        return a.line < b.line;
+    });
+    return locations;
+}
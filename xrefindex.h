@@ -0,0 +1,94 @@
+#ifndef XREFINDEX_H
+#define XREFINDEX_H
+
+#include <memory>
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class ModuleIndex;
+
+// Inverted index of the .otui files under the project: where each style is
+// defined, which nodes build on or instantiate it, which nodes use each image
+// and which modules load each .otui file. Built on a worker thread, then kept
+// current by reparsing single files as they change on disk. Only directories
+// are watched, a file is reparsed when its mtime differs from the indexed one;
+// watching each file would take a descriptor per file on macOS and could
+// exhaust the inotify limit on Linux.
+class XRefIndex : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Kind : quint8 {
+        StyleDefinition,  // Top level "Name < Base" node
+        StyleReference,   // base_style of a node, or a child node of that style
+        ImageReference,   // image-source value
+        UiReference       // setUI, loadUI, displayUI or importStyle of a module
+    };
+
+    struct Location {
+        Kind kind = Kind::StyleReference;
+        QString filePath;
+        int line = 0;      // 1-based; 0 when the file is the location
+        QString context;
+    };
+
+    explicit XRefIndex(QObject *parent = nullptr);
+    ~XRefIndex() override;
+
+    // Reindexes every .otui file under roots.
+    void setRoots(const QStringList &roots);
+    void setModules(const std::shared_ptr<const ModuleIndex> &modules);
+    bool isBuilding() const { return m_building; }
+
+    QVector<Location> definitions(const QString &styleName) const;
+    QVector<Location> styleUsages(const QString &styleName) const;
+    // imageSource as written in image-source, e.g. /images/ui/button.
+    QVector<Location> imageUsages(const QString &imageSource) const;
+    QVector<Location> fileUsages(const QString &otuiPath) const;
+
+signals:
+    void updated();
+
+private:
+    struct Symbol {
+        QString key;
+        Location location;
+    };
+    using FileSymbols = QHash<QString, QVector<Symbol>>;
+    struct Build {
+        FileSymbols files;
+        QHash<QString, qint64> modified;
+        QStringList directories;
+    };
+
+    static QVector<Symbol> indexFile(const QString &filePath);
+    void addSymbols(const QVector<Symbol> &symbols);
+    void removeSymbols(const QVector<Symbol> &symbols);
+    void applyFile(const QString &filePath, const QVector<Symbol> &symbols, qint64 modified);
+    void reindexFile(const QString &filePath);
+    void handleDirectoryChanged(const QString &dirPath);
+    QVector<Location> lookup(const QString &key, Kind kind) const;
+
+    QFileSystemWatcher m_watcher;
+    QStringList m_roots;
+    FileSymbols m_files;
+    // mtime in ms of each file as it was indexed.
+    QHash<QString, qint64> m_modified;
+    // Latest reindex per file; older ones still running are dropped when they finish.
+    QHash<QString, quint64> m_requests;
+    quint64 m_nextRequest = 0;
+    QVector<Symbol> m_moduleSymbols;
+    QHash<QString, QVector<Location>> m_postings;
+    QSet<QString> m_staleFiles;
+    // Results of a build started before the last setRoots() are dropped.
+    int m_generation = 0;
+    bool m_building = false;
+};
+
+#endif // XREFINDEX_H